@@ -17,6 +17,7 @@
  */
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include "muxml.h"
 
@@ -133,104 +134,141 @@ void MuXML::print(std::ostream& out,const int& level,const XMLNode* node) const
    }
 }
 
-bool MuXML::read(std::istream& in,XMLNode* parent,const int& level,const char& currentChar) {
-   in >> noskipws;
+/** Test if the given character is whitespace.
+ * @param c Character.
+ * @return If true, the character is whitespace.*/
+static inline bool isSpace(const char& c) {
+   return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/** Skip whitespace.
+ * @param pos Current position, on exit points to the first non-whitespace character or to end.
+ * @param end End of buffer.*/
+static inline void skipSpace(const char*& pos,const char* end) {
+   while (pos != end && isSpace(*pos) == true) ++pos;
+}
+
+/** Parse XML tags from the given buffer and add them to the tree. Node names, 
+ * attributes, and values are copied directly from the buffer, and closing 
+ * quotes and tag ends are searched with memchr.
+ * @param buffer Pointer to the XML text.
+ * @param bytes Byte size of the XML text.
+ * @param parent Node under which parsed tags are added, if NULL root node is used.
+ * @return If true, the text was parsed successfully. Truncated text, in which 
+ * some tags are not closed, is not parsed successfully.*/
+bool MuXML::parse(const char* buffer,const size_t& bytes,XMLNode* parent) {
    if (parent == NULL) parent = root;
-   
-   int index = 0;
-   bool success = true;
-   char c = currentChar;
-   char buffer[1024];
-   do {
-      // Skip empty chars:
-      while ((c == ' ' || c == '\t' || c == '\n') && in.good() == true) in >> c;
-      
-      // Start to read tag name and its attributes:
-      if (c == '<') {
-	 in >> c;
-	 while ((c == ' ' || c == '\t' || c == '\n') && in.good() == true) in >> c;
-	 
-	 // Read end tag and return:
-	 if (c == '/') {
-	    while (in.eof() == false && c != '>') in >> c;
-	    in >> c;
-	    if (in.good() == false) success = false;
-	    return success;
-	 }
-	 
-	 index = 0;
-	 while (c != ' ' && c != '>') {
-	    buffer[index] = c;
-	    ++index;
-	    in >> c;
-	    if (in.good() == false) {success = false; break;}
-	 }
-	 buffer[index] = '\0';
-	 XMLNode* node = addNode(parent,buffer,"");
-	 
-	 // Remove empty spaces
-	 while ((c == ' ' || c == '\t' || c == '\n') && in.good() == true) in >> c;
-	 if (in.eof() == true) {success = false; break;}
-	 
-	 // If next char is '>' the tag ends. Otherwise read attribute values:
-	 if (c != '>') {
-	    while (c != '>') {
-	       while ((c == ' ' || c == '\t' || c == '\n') && in.good() == true) in >> c;
-	       
-	       index = 0;
-	       while (c != '=' && in.good() == true) {
-		  buffer[index] = c;
-		  ++index;
-		  in >> c;
-	       }
-	       buffer[index] = '\0';
-	       string attribName = buffer;
-	       in >> c; // Forward from '='
-	       in >> c; // Forward from '"'
-	       index = 0;
-	       while (c != '"' && in.good() == true) {
-		  buffer[index] = c;
-		  ++index;
-		  in >> c;
-	       }
-	       in >> c;
-	       if (in.good() == false) {success = false; break;}
-	       buffer[index] = '\0';
-	       string attribValue = buffer;
-	       addAttribute(node,attribName,attribValue);
-	    }
-	    in >> c;
-	 } else {
-	    in >> c;
-	 }
-	 while ((c == ' ' || c == '\t' || c == '\n') && in.good() == true) in >> c;
-	 
-	 // Read tag's value:
-	 index = 0;
-	 while ((c != ' ' && c != '\t' && c != '\n' && c != '<') && in.good() == true) {
-	    buffer[index] = c;
-	    ++index;
-	    in >> c;
-	 }
-	 if (in.good() == false) {success = false; break;}
-	 while ((c == ' ' || c == '\t' || c == '\n') && in.good() == true) in >> c;
-	 
-	 buffer[index] = '\0';
-	 changeValue(node,buffer);
-
-	 if (c == '<') {
-	    read(in,node,level+1,c);
-	    in >> c;
-	 }
-	 while ((c == ' ' || c == '\t' || c == '\n') && in.good() == true) in >> c;
+   XMLNode* const top = parent;
+   const char* pos = buffer;
+   const char* const end = buffer + bytes;
+
+   while (true) {
+      // Input must not end while tags opened in it are still open:
+      skipSpace(pos,end);
+      if (pos == end) return parent == top;
+      if (*pos != '<') return false;
+      ++pos;
+      skipSpace(pos,end);
+      if (pos == end) return false;
+
+      // End tag closes the current parent node:
+      if (*pos == '/') {
+         const char* tagEnd = reinterpret_cast<const char*>(memchr(pos,'>',end-pos));
+         if (tagEnd == NULL) return false;
+         pos = tagEnd+1;
+         if (parent == top) return true;
+         parent = parent->parent;
+         continue;
       }
-      
-      if (in.good() == false && in.eof() == false) return false;
-      if (in.eof() == true) {
-         return true;
+
+      // Skip XML declarations and comments:
+      if (*pos == '?' || *pos == '!') {
+         const char* tagEnd = reinterpret_cast<const char*>(memchr(pos,'>',end-pos));
+         if (tagEnd == NULL) return false;
+         pos = tagEnd+1;
+         continue;
       }
-   } while (success == true);
-   return true;
+
+      // Read tag name:
+      const char* nameBegin = pos;
+      while (pos != end && isSpace(*pos) == false && *pos != '>' && *pos != '/') ++pos;
+      if (pos == end) return false;
+      XMLNode* node = new XMLNode(parent);
+      parent->children.insert(make_pair(string(nameBegin,pos),node));
+
+      // Read attributes:
+      bool selfClosing = false;
+      while (true) {
+         skipSpace(pos,end);
+         if (pos == end) return false;
+         if (*pos == '>') {++pos; break;}
+         if (*pos == '/') {
+            ++pos;
+            if (pos == end || *pos != '>') return false;
+            ++pos;
+            selfClosing = true;
+            break;
+         }
+
+         const char* attribBegin = pos;
+         while (pos != end && *pos != '=' && isSpace(*pos) == false) ++pos;
+         const char* attribEnd = pos;
+         skipSpace(pos,end);
+         if (pos == end || *pos != '=') return false;
+         ++pos;
+         skipSpace(pos,end);
+         if (pos == end || (*pos != '"' && *pos != '\'')) return false;
+         const char quote = *pos;
+         ++pos;
+         const char* valueEnd = reinterpret_cast<const char*>(memchr(pos,quote,end-pos));
+         if (valueEnd == NULL) return false;
+         node->attributes[string(attribBegin,attribEnd)].assign(pos,valueEnd);
+         pos = valueEnd+1;
+      }
+      if (selfClosing == true) continue;
+
+      // Read tag's value. Tags following the value are children of this node:
+      skipSpace(pos,end);
+      const char* valueBegin = pos;
+      while (pos != end && *pos != '<' && isSpace(*pos) == false) ++pos;
+      node->value.assign(valueBegin,pos);
+      parent = node;
+   }
+}
+
+/** Read XML tags from the given input stream. The rest of the stream is read 
+ * into memory with a single read, and then parsed with MuXML::parse.
+ * @param in Input stream.
+ * @param parent Node under which parsed tags are added, if NULL root node is used.
+ * @param level Not used.
+ * @param currentChar Character that has already been extracted from the stream.
+ * @return If true, XML tags were read successfully.*/
+bool MuXML::read(std::istream& in,XMLNode* parent,const int& level,const char& currentChar) {
+   string buffer;
+   if (isSpace(currentChar) == false) buffer.push_back(currentChar);
+
+   // Use the stream size to read everything at once if possible:
+   const streampos start = in.tellg();
+   if (start != streampos(-1)) {
+      in.seekg(0,ios_base::end);
+      const streampos streamEnd = in.tellg();
+      in.seekg(start);
+      if (streamEnd != streampos(-1) && streamEnd >= start) {
+         const size_t offset = buffer.size();
+         buffer.resize(offset + static_cast<size_t>(streamEnd-start));
+         if (buffer.size() > offset) in.read(&(buffer[offset]),buffer.size()-offset);
+         buffer.resize(offset + static_cast<size_t>(in.gcount()));
+      }
+   }
+
+   // Read anything that remains in blocks:
+   char block[65536];
+   while (in.good() == true) {
+      in.read(block,sizeof(block));
+      buffer.append(block,static_cast<size_t>(in.gcount()));
+   }
+   if (in.bad() == true) return false;
+   return parse(buffer.data(),buffer.size(),parent);
 }
 
 
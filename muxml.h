@@ -57,6 +57,7 @@ namespace muxml {
       std::string getNodeValue(const XMLNode* node) const;
       XMLNode* getRoot() const;
 
+      bool parse(const char* buffer,const size_t& bytes,XMLNode* parent=NULL);
       void print(std::ostream& out,const int& level=0,const XMLNode* node=NULL) const;
 
       bool read(std::istream& in,XMLNode* parent=NULL,const int& level=0,const char& currentChar=' ');
@@ -101,6 +102,28 @@ namespace muxml {
       return true;
    }
 
+   // Strings are copied directly instead of going through a stringstream:
+
+   template<> inline bool MuXML::addAttribute<std::string>(XMLNode* node,const std::string& attribName,const std::string& attribValue) {
+      if (node == NULL) return false;
+      (node->attributes)[attribName] = attribValue;
+      return true;
+   }
+
+   template<> inline XMLNode* MuXML::addNode<std::string>(XMLNode* parent,const std::string& nodeName,const std::string& nodeValue) {
+      if (parent == NULL) return NULL;
+      XMLNode* node = new XMLNode(parent);
+      parent->children.insert(std::make_pair(nodeName,node));
+      node->value = nodeValue;
+      return node;
+   }
+
+   template<> inline bool MuXML::changeValue<std::string>(XMLNode* node,const std::string& value) {
+      if (node == NULL) return false;
+      node->value = value;
+      return true;
+   }
+
 } // namespace muxml
 
 #endif
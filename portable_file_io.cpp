@@ -24,16 +24,53 @@
 #ifdef WINDOWS
    #include <direct.h>
    #include <io.h>
+   #include <sys/types.h>
+   #include <sys/stat.h>
 #else
+   #include <cerrno>
+   #include <climits>
+   #include <fcntl.h>
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+   #include <sys/uio.h>
    #include <unistd.h>
 #endif
 
+#include <sstream>
+#include <vector>
+
 #include "portable_file_io.h"
 
 using namespace std;
 
 namespace fileio {
 
+	/** Give the operating system a hint about how a part of a memory-mapped 
+	 * file is going to be accessed. The range is extended to page boundaries.
+	 * @param data Pointer to the start of the range, must be inside a mapping created with mapFile.
+	 * @param bytes Byte size of the range.
+	 * @param hint Access pattern hint.
+	 * @return If true, the hint was given successfully.*/
+	bool adviseMapping(const char* data, uint64_t bytes, advice::type hint) {
+		#ifdef WINDOWS
+			return false;
+		#else
+			if (data == NULL || bytes == 0) return true;
+			int flag = MADV_NORMAL;
+			switch (hint) {
+				case advice::NORMAL:     flag = MADV_NORMAL;     break;
+				case advice::SEQUENTIAL: flag = MADV_SEQUENTIAL; break;
+				case advice::RANDOM:     flag = MADV_RANDOM;     break;
+				case advice::WILLNEED:   flag = MADV_WILLNEED;   break;
+				case advice::DONTNEED:   flag = MADV_DONTNEED;   break;
+			}
+			const uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+			const uintptr_t start = reinterpret_cast<uintptr_t>(data) / pageSize * pageSize;
+			const uintptr_t end = reinterpret_cast<uintptr_t>(data) + bytes;
+			return madvise(reinterpret_cast<void*>(start), end-start, flag) == 0;
+		#endif
+	}
+
 	int chdir(const char* path) {
 		#ifdef WINDOWS
 			return _chdir(path);
@@ -42,6 +79,14 @@ namespace fileio {
 		#endif
 	}
 
+	/** Close a file opened with openFile.
+	 * @param fd File descriptor.*/
+	void closeFile(int fd) {
+		#ifndef WINDOWS
+			if (fd >= 0) ::close(fd);
+		#endif
+	}
+
 	char* getcwd(char* buf, size_t size) {
 		#ifdef WINDOWS
 			return _getcwd(buf,size);
@@ -50,4 +95,152 @@ namespace fileio {
 		#endif
 	}
 
+	/** Map a file into memory for reading.
+	 * @param path Name of the file.
+	 * @param bytes Variable in which the byte size of the file is written.
+	 * @return Pointer to the mapped file, or NULL if the file could not be mapped. 
+	 * The mapping must be released with unmapFile.*/
+	const char* mapFile(const char* path, uint64_t& bytes) {
+		bytes = 0;
+		#ifdef WINDOWS
+			return NULL;
+		#else
+			const int fd = ::open(path,O_RDONLY);
+			if (fd < 0) return NULL;
+			struct stat status;
+			if (fstat(fd,&status) != 0 || status.st_size <= 0) {
+				::close(fd);
+				return NULL;
+			}
+			void* data = mmap(NULL,status.st_size,PROT_READ,MAP_SHARED,fd,0);
+			::close(fd);
+			if (data == MAP_FAILED) return NULL;
+			bytes = status.st_size;
+			return reinterpret_cast<const char*>(data);
+		#endif
+	}
+
+	/** Get a string that identifies the contents of a file. Two paths that 
+	 * refer to the same unmodified file give the same identity, and the 
+	 * identity changes if the file is modified or replaced.
+	 * @param path Name of the file.
+	 * @param identity Identity of the file is written here.
+	 * @return If true, the identity was determined successfully.*/
+	bool getFileIdentity(const char* path, std::string& identity) {
+		stringstream ss;
+		#ifdef WINDOWS
+			struct _stat64 info;
+			if (_stat64(path, &info) != 0) return false;
+			ss << path << ':' << info.st_size << ':' << info.st_mtime;
+		#else
+			struct stat info;
+			if (stat(path, &info) != 0) return false;
+			ss << info.st_dev << ':' << info.st_ino << ':' << info.st_size << ':' << info.st_mtime;
+			#ifdef __APPLE__
+				ss << '.' << info.st_mtimespec.tv_nsec;
+			#else
+				ss << '.' << info.st_mtim.tv_nsec;
+			#endif
+		#endif
+		identity = ss.str();
+		return true;
+	}
+
+	/** Open a file for positional reading, see readAt.
+	 * @param path Name of the file.
+	 * @return File descriptor, or a negative value if the file could not be opened 
+	 * or positional reads are not supported on this platform.*/
+	int openFile(const char* path) {
+		#ifdef WINDOWS
+			return -1;
+		#else
+			return ::open(path,O_RDONLY);
+		#endif
+	}
+
+	/** Read bytes from the given file position without moving the file 
+	 * offset. Several threads may call this function simultaneously 
+	 * with the same file descriptor.
+	 * @param fd File descriptor opened with openFile.
+	 * @param buffer Buffer in which the data is read.
+	 * @param bytes Number of bytes to read.
+	 * @param offset Position of the first byte relative to file start.
+	 * @return If true, all requested bytes were read.*/
+	bool readAt(int fd, char* buffer, uint64_t bytes, uint64_t offset) {
+		#ifdef WINDOWS
+			return false;
+		#else
+			while (bytes > 0) {
+				const ssize_t result = pread(fd,buffer,bytes,offset);
+				if (result < 0 && errno == EINTR) continue;
+				if (result <= 0) return false;
+				buffer += result;
+				bytes  -= result;
+				offset += result;
+			}
+			return true;
+		#endif
+	}
+
+	/** Read consecutive bytes from the given file position into several buffers 
+	 * without moving the file offset. The first bytes[0] bytes are written to 
+	 * buffers[0], the next bytes[1] bytes to buffers[1], and so on. The same 
+	 * buffer may be given several times to skip unwanted data.
+	 * @param fd File descriptor opened with openFile.
+	 * @param buffers Buffers in which the data is read.
+	 * @param bytes Number of bytes read to each buffer.
+	 * @param count Number of buffers.
+	 * @param offset Position of the first byte relative to file start.
+	 * @return If true, all requested bytes were read.*/
+	bool readAtVectored(int fd, char* const* buffers, const uint64_t* bytes, size_t count, uint64_t offset) {
+		#ifdef WINDOWS
+			return false;
+		#else
+			#ifdef IOV_MAX
+				const size_t maxVectors = IOV_MAX;
+			#else
+				const size_t maxVectors = 16;
+			#endif
+			std::vector<struct iovec> vectors(count);
+			for (size_t i=0; i<count; ++i) {
+				vectors[i].iov_base = buffers[i];
+				vectors[i].iov_len  = bytes[i];
+			}
+
+			size_t first = 0;
+			while (first < count) {
+				if (vectors[first].iov_len == 0) {
+					++first;
+					continue;
+				}
+				const size_t N = (count-first < maxVectors) ? count-first : maxVectors;
+				const ssize_t result = preadv(fd,&(vectors[first]),N,offset);
+				if (result < 0 && errno == EINTR) continue;
+				if (result <= 0) return false;
+
+				// Skip fully read buffers and adjust partially read one:
+				offset += result;
+				size_t remaining = result;
+				while (remaining > 0 && remaining >= vectors[first].iov_len) {
+					remaining -= vectors[first].iov_len;
+					++first;
+				}
+				if (remaining > 0) {
+					vectors[first].iov_base = reinterpret_cast<char*>(vectors[first].iov_base) + remaining;
+					vectors[first].iov_len -= remaining;
+				}
+			}
+			return true;
+		#endif
+	}
+
+	/** Release a mapping created with mapFile.
+	 * @param data Pointer to the mapped file.
+	 * @param bytes Byte size of the mapped file.*/
+	void unmapFile(const char* data, uint64_t bytes) {
+		#ifndef WINDOWS
+			if (data != NULL) munmap(const_cast<char*>(data),bytes);
+		#endif
+	}
+
 } // namespace fileio
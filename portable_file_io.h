@@ -16,18 +16,41 @@
 *
 *  You should have received a copy of the GNU Lesser General Public License
 *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
-*/
-
-#pragma once
-
-#ifndef PORTABLE_FILE_SYSTEM_H
-#define PORTABLE_FILE_SYSTEM_H
-
-namespace fileio {
-
-	int chdir(const char* path);
-	char* getcwd(char* buf, size_t size);
-
-} // namespace fileio
-
+*/
+
+#pragma once
+
+#ifndef PORTABLE_FILE_SYSTEM_H
+#define PORTABLE_FILE_SYSTEM_H
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+
+namespace fileio {
+
+	/** Access pattern hints for memory-mapped files, see adviseMapping.*/
+	namespace advice {
+		enum type {
+			NORMAL,         /**< No special treatment.*/
+			SEQUENTIAL,     /**< Data will be accessed sequentially, aggressive read-ahead.*/
+			RANDOM,         /**< Data will be accessed in random order, no read-ahead.*/
+			WILLNEED,       /**< Data will be needed soon, start reading it in the background.*/
+			DONTNEED        /**< Data will not be needed soon, cached pages may be released.*/
+		};
+	}
+
+	bool adviseMapping(const char* data, uint64_t bytes, advice::type hint);
+	int chdir(const char* path);
+	void closeFile(int fd);
+	char* getcwd(char* buf, size_t size);
+	bool getFileIdentity(const char* path, std::string& identity);
+	const char* mapFile(const char* path, uint64_t& bytes);
+	int openFile(const char* path);
+	bool readAt(int fd, char* buffer, uint64_t bytes, uint64_t offset);
+	bool readAtVectored(int fd, char* const* buffers, const uint64_t* bytes, size_t count, uint64_t offset);
+	void unmapFile(const char* data, uint64_t bytes);
+
+} // namespace fileio
+
 #endif
\ No newline at end of file
@@ -0,0 +1,127 @@
+/* Benchmark of concurrent reads from a single vlsv::Reader.
+ *
+ * Writes a file containing 20 variables (unless it already exists) and
+ * reads all of them with 1, 2, 4, ... threads sharing one Reader
+ * opened in concurrent mode. Compile, e.g., with
+ *
+ * mpic++ -O3 -std=c++0x -pthread -I.. bench_concurrent_read.cpp -L.. -lvlsv -o bench_concurrent_read
+ *
+ * and run as "./bench_concurrent_read <file> [cells per variable] [max threads]".
+ * For cold-cache numbers on a local disk, drop the page cache before each run,
+ * otherwise the benchmark measures reads from memory.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <mpi.h>
+
+#include "../vlsv_reader.h"
+#include "../vlsv_writer.h"
+
+using namespace std;
+
+const int N_VARIABLES = 20;
+
+string variableName(int v) {
+   stringstream ss;
+   ss << "variable" << v;
+   return ss.str();
+}
+
+bool writeFile(const string& fname,uint64_t cells) {
+   vlsv::Writer vlsvWriter;
+   if (vlsvWriter.open(fname,MPI_COMM_WORLD,0) == false) return false;
+
+   bool success = true;
+   vector<double> data(cells*3);
+   for (int v=0; v<N_VARIABLES; ++v) {
+      for (size_t i=0; i<data.size(); ++i) data[i] = v + 1e-6*i;
+      map<string,string> attribs;
+      attribs["name"] = variableName(v);
+      attribs["mesh"] = "mesh";
+      if (vlsvWriter.writeArray("VARIABLE",attribs,cells,3,data.data()) == false) success = false;
+   }
+   if (vlsvWriter.close() == false) success = false;
+   return success;
+}
+
+int main(int argn,char* args[]) {
+   MPI_Init(&argn,&args);
+   if (argn < 2) {
+      cerr << "USAGE: ./bench_concurrent_read <file> [cells per variable] [max threads]" << endl;
+      MPI_Finalize();
+      return 1;
+   }
+   const string fname = args[1];
+   uint64_t cells = 4000000;
+   if (argn > 2) cells = atol(args[2]);
+   int maxThreads = max(1u,thread::hardware_concurrency());
+   if (argn > 3) maxThreads = atoi(args[3]);
+
+   if (ifstream(fname.c_str()).good() == false) {
+      cout << "Writing " << N_VARIABLES << " variables of " << cells << " cells to '" << fname << "'" << endl;
+      if (writeFile(fname,cells) == false) {
+         cerr << "Failed to write '" << fname << "'" << endl;
+         MPI_Finalize();
+         return 1;
+      }
+   }
+
+   vlsv::Reader vlsvReader;
+   vlsvReader.setConcurrentReads(true);
+   if (vlsvReader.open(fname) == false) {
+      cerr << "Failed to open '" << fname << "'" << endl;
+      MPI_Finalize();
+      return 1;
+   }
+
+   cout << "threads\ttime (s)\tthroughput (MB/s)" << endl;
+   for (int threads=1; threads<=maxThreads; threads*=2) {
+      vector<uint64_t> bytes(N_VARIABLES,0);
+      atomic<int> nextVariable(0);
+      atomic<bool> success(true);
+      const double t_start = MPI_Wtime();
+
+      // Threads take variables from a shared counter until all variables have been read:
+      auto readVariables = [&]() {
+         for (int v=nextVariable++; v<N_VARIABLES; v=nextVariable++) {
+            list<pair<string,string> > attribs;
+            attribs.push_back(make_pair("name",variableName(v)));
+            attribs.push_back(make_pair("mesh","mesh"));
+
+            uint64_t arraySize,vectorSize,dataSize;
+            vlsv::datatype::type dataType;
+            if (vlsvReader.getArrayInfo("VARIABLE",attribs,arraySize,vectorSize,dataType,dataSize) == false) {
+               success = false;
+               continue;
+            }
+            double* data = NULL;
+            if (vlsvReader.read("VARIABLE",attribs,0,arraySize,data) == false) success = false;
+            else if (data[vectorSize*arraySize-1] != v + 1e-6*(vectorSize*arraySize-1)) success = false;
+            bytes[v] = arraySize*vectorSize*dataSize;
+            delete [] data;
+         }
+      };
+      vector<thread> workers;
+      for (int t=0; t<threads; ++t) workers.push_back(thread(readVariables));
+      for (size_t t=0; t<workers.size(); ++t) workers[t].join();
+      const double t_total = MPI_Wtime() - t_start;
+
+      uint64_t totalBytes = 0;
+      for (int v=0; v<N_VARIABLES; ++v) totalBytes += bytes[v];
+      cout << threads << '\t' << t_total << '\t' << totalBytes/t_total/1e6;
+      if (success == false) cout << "\t(READ FAILED)";
+      cout << endl;
+   }
+
+   vlsvReader.close();
+   MPI_Finalize();
+   return 0;
+}
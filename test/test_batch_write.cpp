@@ -0,0 +1,188 @@
+#include <cstdlib>
+#include <iostream>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <vector>
+
+#include "../vlsv_writer.h"
+#include "../vlsv_reader.h"
+#include "../vlsv_reader_parallel.h"
+
+using namespace std;
+
+/* Round-trip test of batched array writes. Arrays of different datatypes and vector
+ * sizes are written with beginBatch, addArray, and commitBatch through a combined file
+ * view, and with compression and aggregation, in which case the arrays are written
+ * one by one. Process #1 writes no elements to the first array. Data is read back with
+ * vlsv::Reader and vlsv::ParallelReader. Run with e.g. 'mpirun -np 3 ./test_batch_write'.*/
+
+const int N_ARRAYS = 3;
+
+uint64_t getElements(const int& rank,const int& array) {
+   if (rank == 1 && array == 0) return 0;
+   return 50 + 7*rank + 3*array;
+}
+
+double getValue(const uint64_t& globalIndex,const int& array) {
+   return 10000*array + globalIndex;
+}
+
+bool writeFile(const string& fileName,const int& mode,const int& myRank,const int& processes) {
+   bool success = true;
+   vlsv::Writer vlsv;
+   if (mode == 1) {
+      if (vlsv.setCodec("lz",100) == false) success = false;
+   }
+   if (mode == 2) {
+      if (vlsv.setAggregation(1) == false) success = false;
+   }
+   if (vlsv.open(fileName,MPI_COMM_WORLD,0) == false) return false;
+
+   // Committing without a batch fails on all processes:
+   if (vlsv.commitBatch() == true) {
+      cerr << "Writer committed a batch that was not started" << endl;
+      success = false;
+   }
+
+   // Arrays must remain valid until commitBatch returns:
+   vector<vector<double> > values(N_ARRAYS);
+   vector<vector<int32_t> > indices(N_ARRAYS);
+   if (vlsv.beginBatch() == false) success = false;
+   for (int a=0; a<N_ARRAYS; ++a) {
+      uint64_t offset = 0;
+      for (int i=0; i<myRank; ++i) offset += getElements(i,a);
+      const uint64_t N_elements = getElements(myRank,a);
+
+      values[a].resize(N_elements);
+      indices[a].resize(2*N_elements);
+      for (uint64_t i=0; i<N_elements; ++i) {
+         values[a][i] = getValue(offset+i,a);
+         indices[a][2*i+0] = offset+i;
+         indices[a][2*i+1] = -a;
+      }
+
+      map<string,string> attribs;
+      attribs["name"] = "values" + to_string(a);
+      if (vlsv.addArray("VARIABLE",attribs,N_elements,1,values[a].data()) == false) success = false;
+      attribs["name"] = "indices" + to_string(a);
+      if (vlsv.addArray("VARIABLE",attribs,N_elements,2,indices[a].data()) == false) success = false;
+   }
+   if (vlsv.commitBatch() == false) success = false;
+
+   // Empty batch writes nothing:
+   if (vlsv.beginBatch() == false) success = false;
+   if (vlsv.commitBatch() == false) success = false;
+
+   double time = 1.5;
+   if (vlsv.writeParameter("time",&time) == false) success = false;
+   if (vlsv.close() == false) success = false;
+   return success;
+}
+
+bool readFileSerial(const string& fileName,const int& processes) {
+   bool success = true;
+   vlsv::Reader vlsv;
+   if (vlsv.open(fileName) == false) return false;
+
+   for (int a=0; a<N_ARRAYS; ++a) {
+      uint64_t N_total = 0;
+      for (int i=0; i<processes; ++i) N_total += getElements(i,a);
+
+      list<pair<string,string> > attribs;
+      attribs.push_back(make_pair("name","values"+to_string(a)));
+      double* values = NULL;
+      if (vlsv.read("VARIABLE",attribs,0,N_total,values) == false) {
+         cerr << "Failed to read values of array " << a << endl;
+         success = false;
+      } else {
+         for (uint64_t i=0; i<N_total; ++i) if (values[i] != getValue(i,a)) success = false;
+      }
+      delete [] values; values = NULL;
+
+      attribs.clear();
+      attribs.push_back(make_pair("name","indices"+to_string(a)));
+      int32_t* indices = NULL;
+      if (vlsv.read("VARIABLE",attribs,0,N_total,indices) == false) {
+         cerr << "Failed to read indices of array " << a << endl;
+         success = false;
+      } else {
+         for (uint64_t i=0; i<N_total; ++i) {
+            if (indices[2*i+0] != static_cast<int32_t>(i) || indices[2*i+1] != -a) success = false;
+         }
+      }
+      delete [] indices; indices = NULL;
+   }
+
+   double time;
+   if (vlsv.readParameter("time",time) == false || time != 1.5) {
+      cerr << "Failed to read parameter" << endl;
+      success = false;
+   }
+   vlsv.close();
+   return success;
+}
+
+bool readFileParallel(const string& fileName,const int& myRank,const int& processes) {
+   bool success = true;
+   vlsv::ParallelReader vlsv;
+   if (vlsv.open(fileName,MPI_COMM_WORLD,0) == false) return false;
+
+   for (int a=0; a<N_ARRAYS; ++a) {
+      uint64_t offset = 0;
+      for (int i=0; i<myRank; ++i) offset += getElements(i,a);
+      const uint64_t N_elements = getElements(myRank,a);
+
+      list<pair<string,string> > attribs;
+      attribs.push_back(make_pair("name","values"+to_string(a)));
+      vector<double> buffer(N_elements+1);
+      if (vlsv.readArray("VARIABLE",attribs,offset,N_elements,reinterpret_cast<char*>(buffer.data())) == false) success = false;
+      for (uint64_t i=0; i<N_elements; ++i) if (buffer[i] != getValue(offset+i,a)) success = false;
+   }
+   vlsv.close();
+   return success;
+}
+
+int main(int argn,char* args[]) {
+   MPI_Init(&argn,&args);
+   int myRank,processes;
+   MPI_Comm_rank(MPI_COMM_WORLD,&myRank);
+   MPI_Comm_size(MPI_COMM_WORLD,&processes);
+   if (processes < 2) {
+      if (myRank == 0) cerr << "test_batch_write must be run with at least two processes" << endl;
+      MPI_Finalize();
+      return 1;
+   }
+
+   // Batch is written through a combined file view (mode 0), or one
+   // array at a time with compression (mode 1) and aggregation (mode 2):
+   bool success = true;
+   const string fileName = "test_batch_write.vlsv";
+   for (int mode=0; mode<3; ++mode) {
+      if (writeFile(fileName,mode,myRank,processes) == false) {
+         cerr << "Process #" << myRank << " failed to write file in mode " << mode << endl;
+         success = false;
+      }
+      MPI_Barrier(MPI_COMM_WORLD);
+
+      if (myRank == 0 && readFileSerial(fileName,processes) == false) {
+         cerr << "Failed to read file written in mode " << mode << endl;
+         success = false;
+      }
+      if (readFileParallel(fileName,myRank,processes) == false) {
+         cerr << "Process #" << myRank << " failed to read file written in mode " << mode << " in parallel" << endl;
+         success = false;
+      }
+      MPI_Barrier(MPI_COMM_WORLD);
+   }
+
+   uint8_t mySuccess = success;
+   uint8_t allSuccess;
+   MPI_Reduce(&mySuccess,&allSuccess,1,MPI_UINT8_T,MPI_MIN,0,MPI_COMM_WORLD);
+   if (myRank == 0) {
+      if (allSuccess > 0) cout << "test_batch_write: PASSED" << endl;
+      else cout << "test_batch_write: FAILED" << endl;
+   }
+   MPI_Finalize();
+   return success ? 0 : 1;
+}
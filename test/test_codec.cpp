@@ -0,0 +1,251 @@
+#include <cstdlib>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <map>
+#include <vector>
+
+#include "../vlsv_codec.h"
+#include "../vlsv_writer.h"
+#include "../vlsv_reader.h"
+#include "../vlsv_reader_parallel.h"
+
+using namespace std;
+
+/* Round-trip test of chunk compression codecs. Codecs are first tested directly
+ * on buffers of odd byte sizes and on corrupt streams, after which arrays are written
+ * with each codec and read back with vlsv::Reader and vlsv::ParallelReader. Last
+ * process writes no array elements. Run with e.g. 'mpirun -np 3 ./test_codec'.*/
+
+const uint64_t VECTOR_SIZE = 3;
+
+/** Number of array elements written by the given process. Counts are odd,
+ * except that the last process writes nothing.*/
+uint64_t getElements(const int& rank,const int& processes) {
+   if (rank == processes-1) return 0;
+   return 101 + 26*rank;
+}
+
+double getValue(const uint64_t& globalIndex,const int& array) {
+   // Slowly varying values so that the data is compressible:
+   return 1000*array + 0.25*(globalIndex/7) + (globalIndex % 3);
+}
+
+bool testCodec(const string& codecName) {
+   bool success = true;
+   const vlsv::Codec* codec = vlsv::getCodec(codecName);
+   if (codec == NULL) {
+      cerr << "Codec '" << codecName << "' not found" << endl;
+      return false;
+   }
+
+   // Round trip of compressible and random data of odd sizes, including empty input:
+   const uint64_t sizes[] = {0,1,7,15,1001,70001};
+   for (size_t s=0; s<sizeof(sizes)/sizeof(uint64_t); ++s) {
+      for (int random=0; random<2; ++random) {
+         vector<char> input(sizes[s]);
+         for (uint64_t i=0; i<sizes[s]; ++i) {
+            if (random == 0) input[i] = 'a' + (i/5) % 4;
+            else input[i] = rand() % 256;
+         }
+
+         vector<char> compressed;
+         vector<char> output(sizes[s]+1);
+         if (codec->compress(input.data(),input.size(),compressed) == false) {
+            cerr << codecName << ": compress failed, bytes " << sizes[s] << endl;
+            success = false; continue;
+         }
+         if (codec->decompress(compressed.data(),compressed.size(),output.data(),sizes[s]) == false
+             || memcmp(input.data(),output.data(),sizes[s]) != 0) {
+            cerr << codecName << ": round trip failed, bytes " << sizes[s] << endl;
+            success = false; continue;
+         }
+
+         // Decompression must fail if the stream does not produce exactly the requested number of bytes:
+         if (codec->decompress(compressed.data(),compressed.size(),output.data(),sizes[s]+1) == true) {
+            cerr << codecName << ": decompress succeeded with wrong output size, bytes " << sizes[s] << endl;
+            success = false;
+         }
+      }
+   }
+
+   // Corrupt streams, LZ stream has a match that points before the output start,
+   // and a token that claims more literals than there are in the stream:
+   if (codecName == "lz") {
+      const char badOffset[] = {0x10,'a',0x05,0x00};
+      const char badLiterals[] = {static_cast<char>(0xF0),0x20,'a','b'};
+      char output[64];
+      if (codec->decompress(badOffset,sizeof(badOffset),output,5) == true) {
+         cerr << codecName << ": decompress of stream with invalid match offset succeeded" << endl;
+         success = false;
+      }
+      if (codec->decompress(badLiterals,sizeof(badLiterals),output,47) == true) {
+         cerr << codecName << ": decompress of truncated stream succeeded" << endl;
+         success = false;
+      }
+   }
+   return success;
+}
+
+bool testShuffle() {
+   // Odd number of elements and element size that is not a power of two:
+   const uint64_t elements = 1001;
+   const uint64_t typeSize = 12;
+   vector<char> input(elements*typeSize);
+   vector<char> shuffled(input.size());
+   vector<char> output(input.size());
+   for (size_t i=0; i<input.size(); ++i) input[i] = rand() % 256;
+
+   vlsv::shuffle(input.data(),shuffled.data(),elements,typeSize);
+   if (shuffled[1] != input[typeSize]) return false;
+   vlsv::unshuffle(shuffled.data(),output.data(),elements,typeSize);
+   return input == output;
+}
+
+bool writeFile(const string& fileName,const int& myRank,const int& processes) {
+   bool success = true;
+   vlsv::Writer vlsv;
+   if (vlsv.open(fileName,MPI_COMM_WORLD,0) == false) return false;
+
+   uint64_t offset = 0;
+   for (int i=0; i<myRank; ++i) offset += getElements(i,processes);
+   const uint64_t N_elements = getElements(myRank,processes);
+
+   // Array 0 is not compressed, arrays 1-3 are written with codecs none, lz, and lz with
+   // shuffle filter. Chunk size is odd so that chunks do not align with process boundaries:
+   const string codecs[] = {"","none","lz","lz"};
+   for (int a=0; a<4; ++a) {
+      vector<double> data(N_elements*VECTOR_SIZE);
+      for (uint64_t i=0; i<data.size(); ++i) data[i] = getValue(offset*VECTOR_SIZE+i,a);
+
+      if (vlsv.setCodec(codecs[a],17) == false) success = false;
+      if (vlsv.setShuffle(a == 3) == false) success = false;
+
+      map<string,string> attribs;
+      attribs["name"] = "array" + to_string(a);
+      if (vlsv.writeArray("VARIABLE",attribs,N_elements,VECTOR_SIZE,data.data()) == false) success = false;
+   }
+
+   // Unknown codec is rejected with an error message:
+   if (vlsv.setCodec("nonexistent") == true) {
+      cerr << "Writer accepted an unknown codec" << endl;
+      success = false;
+   }
+   if (vlsv.close() == false) success = false;
+   return success;
+}
+
+bool readFileSerial(const string& fileName,const uint64_t& N_total) {
+   bool success = true;
+   vlsv::Reader vlsv;
+   if (vlsv.open(fileName) == false) return false;
+
+   const string codecs[] = {"","none","lz","lz"};
+   for (int a=0; a<4; ++a) {
+      list<pair<string,string> > attribs;
+      attribs.push_back(make_pair("name","array"+to_string(a)));
+
+      map<string,string> attribsOut;
+      vlsv.getArrayAttributes("VARIABLE",attribs,attribsOut);
+      if (attribsOut["codec"] != codecs[a] || (attribsOut["filter"] == "shuffle") != (a == 3)) {
+         cerr << "Array " << a << " has wrong codec attributes" << endl;
+         success = false;
+      }
+
+      // Read the whole array, and a range that starts and ends in the middle of chunks:
+      const uint64_t begins[] = {0,5};
+      const uint64_t amounts[] = {N_total,N_total-16};
+      for (int r=0; r<2; ++r) {
+         double* buffer = NULL;
+         if (vlsv.read("VARIABLE",attribs,begins[r],amounts[r],buffer) == false) {
+            cerr << "Failed to read array " << a << endl;
+            success = false; continue;
+         }
+         for (uint64_t i=0; i<amounts[r]*VECTOR_SIZE; ++i) {
+            if (buffer[i] != getValue(begins[r]*VECTOR_SIZE+i,a)) {
+               cerr << "Array " << a << " has wrong value at index " << begins[r]*VECTOR_SIZE+i << endl;
+               success = false; break;
+            }
+         }
+         delete [] buffer; buffer = NULL;
+      }
+   }
+   vlsv.close();
+   return success;
+}
+
+bool readFileParallel(const string& fileName,const int& myRank,const int& processes) {
+   bool success = true;
+   vlsv::ParallelReader vlsv;
+   if (vlsv.open(fileName,MPI_COMM_WORLD,0) == false) return false;
+
+   uint64_t offset = 0;
+   for (int i=0; i<myRank; ++i) offset += getElements(i,processes);
+   const uint64_t N_elements = getElements(myRank,processes);
+
+   for (int a=0; a<4; ++a) {
+      list<pair<string,string> > attribs;
+      attribs.push_back(make_pair("name","array"+to_string(a)));
+
+      vector<double> buffer(N_elements*VECTOR_SIZE);
+      if (vlsv.readArray("VARIABLE",attribs,offset,N_elements,reinterpret_cast<char*>(buffer.data())) == false) {
+         success = false; continue;
+      }
+      for (uint64_t i=0; i<buffer.size(); ++i) {
+         if (buffer[i] != getValue(offset*VECTOR_SIZE+i,a)) {
+            success = false; break;
+         }
+      }
+   }
+   vlsv.close();
+   return success;
+}
+
+int main(int argn,char* args[]) {
+   MPI_Init(&argn,&args);
+   int myRank,processes;
+   MPI_Comm_rank(MPI_COMM_WORLD,&myRank);
+   MPI_Comm_size(MPI_COMM_WORLD,&processes);
+   srand(1);
+   if (processes < 2) {
+      if (myRank == 0) cerr << "test_codec must be run with at least two processes" << endl;
+      MPI_Finalize();
+      return 1;
+   }
+
+   bool success = true;
+   if (myRank == 0) {
+      if (testCodec("none") == false) success = false;
+      if (testCodec("lz") == false) success = false;
+      if (testShuffle() == false) {
+         cerr << "Shuffle round trip failed" << endl;
+         success = false;
+      }
+   }
+
+   const string fileName = "test_codec.vlsv";
+   uint64_t N_total = 0;
+   for (int i=0; i<processes; ++i) N_total += getElements(i,processes);
+   if (writeFile(fileName,myRank,processes) == false) {
+      cerr << "Process #" << myRank << " failed to write file" << endl;
+      success = false;
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+
+   if (myRank == 0 && readFileSerial(fileName,N_total) == false) success = false;
+   if (readFileParallel(fileName,myRank,processes) == false) {
+      cerr << "Process #" << myRank << " failed to read file in parallel" << endl;
+      success = false;
+   }
+
+   uint8_t mySuccess = success;
+   uint8_t allSuccess;
+   MPI_Reduce(&mySuccess,&allSuccess,1,MPI_UINT8_T,MPI_MIN,0,MPI_COMM_WORLD);
+   if (myRank == 0) {
+      if (allSuccess > 0) cout << "test_codec: PASSED" << endl;
+      else cout << "test_codec: FAILED" << endl;
+   }
+   MPI_Finalize();
+   return success ? 0 : 1;
+}
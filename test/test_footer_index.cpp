@@ -0,0 +1,226 @@
+#include <cstdlib>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "../vlsv_footer.h"
+#include "../vlsv_writer.h"
+#include "../vlsv_reader.h"
+
+using namespace std;
+
+/* Round-trip test of the binary footer index. The same data is written to one file
+ * with the index and to another without it. Footer metadata read from both files must
+ * be identical. Master process then corrupts the index in several ways, after which
+ * the reader must fall back to parsing the XML footer.
+ * Run with e.g. 'mpirun -np 3 ./test_footer_index'.*/
+
+const int N_ARRAYS = 4;
+const int N_PARAMETERS = 20;
+
+uint64_t getElements(const int& rank) {
+   return 10 + rank;
+}
+
+double getValue(const uint64_t& globalIndex,const int& array) {
+   return 1000*array + globalIndex;
+}
+
+bool writeFile(const string& fileName,const bool& binaryFooter,const int& myRank,const int& processes) {
+   bool success = true;
+   vlsv::Writer vlsv;
+   if (vlsv.setBinaryFooter(binaryFooter) == false) success = false;
+   if (vlsv.open(fileName,MPI_COMM_WORLD,0) == false) return false;
+
+   for (int i=0; i<N_PARAMETERS; ++i) {
+      double value = 0.5*i;
+      if (vlsv.writeParameter("parameter"+to_string(i),&value) == false) success = false;
+   }
+
+   uint64_t offset = 0;
+   for (int i=0; i<myRank; ++i) offset += getElements(i);
+   vector<double> data(getElements(myRank));
+   for (int a=0; a<N_ARRAYS; ++a) {
+      for (uint64_t i=0; i<data.size(); ++i) data[i] = getValue(offset+i,a);
+
+      // Attribute values with spaces and quotes must be preserved in the index:
+      map<string,string> attribs;
+      attribs["name"] = "array" + to_string(a);
+      attribs["mesh"] = "mesh";
+      if (a == 1) attribs["unit"] = "m/s 'x' y";
+      if (a == 3) {
+         if (vlsv.setCodec("lz",3) == false) success = false;
+      }
+      if (vlsv.writeArray("VARIABLE",attribs,data.size(),1,data.data()) == false) success = false;
+   }
+   if (vlsv.close() == false) success = false;
+   return success;
+}
+
+/** Read footer metadata and array contents from the given file.
+ * @param fileName Name of the file.
+ * @param processes Number of processes that wrote the file.
+ * @param metadata Map in which attributes of all arrays are written.
+ * @return If true, file contents were correct.*/
+bool readFile(const string& fileName,const int& processes,map<string,map<string,string> >& metadata) {
+   bool success = true;
+   vlsv::Reader vlsv;
+   if (vlsv.open(fileName) == false) return false;
+
+   for (int i=0; i<N_PARAMETERS; ++i) {
+      double value;
+      if (vlsv.readParameter("parameter"+to_string(i),value) == false || value != 0.5*i) {
+         cerr << fileName << ": failed to read parameter " << i << endl;
+         success = false;
+      }
+   }
+
+   uint64_t N_total = 0;
+   for (int i=0; i<processes; ++i) N_total += getElements(i);
+   for (int a=0; a<N_ARRAYS; ++a) {
+      list<pair<string,string> > attribs;
+      attribs.push_back(make_pair("name","array"+to_string(a)));
+      attribs.push_back(make_pair("mesh","mesh"));
+      if (vlsv.getArrayAttributes("VARIABLE",attribs,metadata["array"+to_string(a)]) == false) success = false;
+
+      double* buffer = NULL;
+      if (vlsv.read("VARIABLE",attribs,0,N_total,buffer) == false) {
+         cerr << fileName << ": failed to read array " << a << endl;
+         success = false; continue;
+      }
+      for (uint64_t i=0; i<N_total; ++i) if (buffer[i] != getValue(i,a)) success = false;
+      delete [] buffer; buffer = NULL;
+   }
+
+   set<string> names;
+   if (vlsv.getUniqueAttributeValues("VARIABLE","name",names) == false || names.size() != N_ARRAYS) success = false;
+   if (metadata["array1"]["unit"] != "m/s 'x' y") {
+      cerr << fileName << ": attribute value was not preserved" << endl;
+      success = false;
+   }
+   vlsv.close();
+   return success;
+}
+
+/** Read the binary footer index of the given file.
+ * @param fileName Name of the file.
+ * @param indexOffset Offset of the index in the file.
+ * @param index Vector in which the index is written, excluding the trailer.
+ * @return If true, the file has an index.*/
+bool getIndex(const string& fileName,uint64_t& indexOffset,vector<char>& index) {
+   fstream in(fileName.c_str(),fstream::in|fstream::binary);
+   uint64_t footerOffset;
+   in.seekg(8);
+   in.read(reinterpret_cast<char*>(&footerOffset),sizeof(uint64_t));
+
+   char trailer[vlsv::footerindex::TRAILER_BYTES];
+   in.seekg(footerOffset-vlsv::footerindex::TRAILER_BYTES);
+   in.read(trailer,vlsv::footerindex::TRAILER_BYTES);
+   uint64_t indexBytes;
+   if (in.good() == false || vlsv::getFooterIndexSize(trailer,indexBytes) == false) return false;
+
+   indexOffset = footerOffset - vlsv::footerindex::TRAILER_BYTES - indexBytes;
+   index.resize(indexBytes);
+   in.seekg(indexOffset);
+   in.read(index.data(),indexBytes);
+   return in.good();
+}
+
+/** Overwrite bytes in the given file.*/
+void overwrite(const string& fileName,const uint64_t& offset,const char* data,const uint64_t& bytes) {
+   fstream out(fileName.c_str(),fstream::in|fstream::out|fstream::binary);
+   out.seekp(offset);
+   out.write(data,bytes);
+}
+
+bool testIndex(const string& indexedFile,const string& xmlFile,const int& processes) {
+   bool success = true;
+   map<string,map<string,string> > indexedMetadata;
+   map<string,map<string,string> > xmlMetadata;
+   if (readFile(indexedFile,processes,indexedMetadata) == false) success = false;
+   if (readFile(xmlFile,processes,xmlMetadata) == false) success = false;
+   if (indexedMetadata != xmlMetadata) {
+      cerr << "Metadata read from binary footer index differs from XML footer" << endl;
+      success = false;
+   }
+
+   uint64_t indexOffset;
+   vector<char> index;
+   if (getIndex(xmlFile,indexOffset,index) == true) {
+      cerr << "File written without binary footer index has one" << endl;
+      success = false;
+   }
+   if (getIndex(indexedFile,indexOffset,index) == false) {
+      cerr << "File written with binary footer index does not have one" << endl;
+      return false;
+   }
+
+   // Decoding must fail on truncated index and on invalid string count:
+   muxml::MuXML xml;
+   if (vlsv::decodeFooterIndex(index.data(),index.size(),xml) == false) {
+      cerr << "Failed to decode binary footer index" << endl;
+      success = false;
+   }
+   if (vlsv::decodeFooterIndex(index.data(),index.size()-1,xml) == true) {
+      cerr << "Truncated binary footer index was decoded" << endl;
+      success = false;
+   }
+   vector<char> corrupt = index;
+   const uint64_t strings = 0xFFFFFFFFFFFF;
+   memcpy(corrupt.data(),&strings,sizeof(uint64_t));
+   if (vlsv::decodeFooterIndex(corrupt.data(),corrupt.size(),xml) == true) {
+      cerr << "Binary footer index with invalid string count was decoded" << endl;
+      success = false;
+   }
+
+   // Reader must fall back to XML footer if the index is corrupt. String count
+   // is corrupted first, then the index size in trailer, and finally the magic:
+   const uint64_t indexBytes = index.size();
+   const uint64_t hugeBytes = 0xFFFFFFFFFFFF;
+   overwrite(indexedFile,indexOffset,reinterpret_cast<const char*>(&strings),sizeof(uint64_t));
+   if (readFile(indexedFile,processes,indexedMetadata) == false || indexedMetadata != xmlMetadata) {
+      cerr << "Failed to read file with corrupt string count" << endl;
+      success = false;
+   }
+   overwrite(indexedFile,indexOffset+indexBytes,reinterpret_cast<const char*>(&hugeBytes),sizeof(uint64_t));
+   if (readFile(indexedFile,processes,indexedMetadata) == false || indexedMetadata != xmlMetadata) {
+      cerr << "Failed to read file with corrupt index size" << endl;
+      success = false;
+   }
+   overwrite(indexedFile,indexOffset+indexBytes+sizeof(uint64_t),"XXXXXXXX",8);
+   if (readFile(indexedFile,processes,indexedMetadata) == false || indexedMetadata != xmlMetadata) {
+      cerr << "Failed to read file with corrupt index magic" << endl;
+      success = false;
+   }
+   return success;
+}
+
+int main(int argn,char* args[]) {
+   MPI_Init(&argn,&args);
+   int myRank,processes;
+   MPI_Comm_rank(MPI_COMM_WORLD,&myRank);
+   MPI_Comm_size(MPI_COMM_WORLD,&processes);
+
+   bool success = true;
+   const string indexedFile = "test_footer_index.vlsv";
+   const string xmlFile = "test_footer_xml.vlsv";
+   if (writeFile(indexedFile,true,myRank,processes) == false) success = false;
+   if (writeFile(xmlFile,false,myRank,processes) == false) success = false;
+   if (success == false) cerr << "Process #" << myRank << " failed to write files" << endl;
+   MPI_Barrier(MPI_COMM_WORLD);
+
+   if (myRank == 0) {
+      if (testIndex(indexedFile,xmlFile,processes) == true) cout << "test_footer_index: PASSED" << endl;
+      else {
+         cout << "test_footer_index: FAILED" << endl;
+         success = false;
+      }
+   }
+   MPI_Finalize();
+   return success ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+#include <cstdlib>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <list>
+#include <map>
+#include <vector>
+
+#include "../muxml.h"
+#include "../vlsv_common.h"
+#include "../vlsv_writer.h"
+#include "../vlsv_reader_parallel.h"
+
+using namespace std;
+
+/* Round-trip test of non-blocking collective reads. Arrays are read with ireadArray and
+ * iendMultiread, several reads are kept in flight and completed with wait in a different
+ * order than they were started. Master process then converts the file to the opposite
+ * byte order, in which case wait swaps the byte order of the read data. Process #1 reads
+ * no elements. Run with e.g. 'mpirun -np 3 ./test_iread'.*/
+
+const int N_ARRAYS = 4;
+const uint64_t VECTOR_SIZE = 3;
+
+uint64_t getElements(const int& rank) {
+   if (rank == 1) return 0;
+   return 1000 + 37*rank;
+}
+
+double getValue(const uint64_t& globalIndex,const int& array) {
+   return 1000000*array + globalIndex;
+}
+
+list<pair<string,string> > getAttributes(const int& array) {
+   list<pair<string,string> > attribs;
+   attribs.push_back(make_pair("name","array"+to_string(array)));
+   return attribs;
+}
+
+/** Write N_ARRAYS double arrays and an int32 array. If compressed is true,
+ * an additional compressed array is written.*/
+bool writeFile(const string& fileName,const bool& compressed,const int& myRank,const uint64_t& offset) {
+   bool success = true;
+   vlsv::Writer vlsv;
+   if (vlsv.open(fileName,MPI_COMM_WORLD,0) == false) return false;
+
+   const uint64_t N_elements = getElements(myRank);
+   const int N_doubles = compressed ? N_ARRAYS+1 : N_ARRAYS;
+   for (int a=0; a<N_doubles; ++a) {
+      vector<double> data(N_elements*VECTOR_SIZE);
+      for (uint64_t i=0; i<data.size(); ++i) data[i] = getValue(offset*VECTOR_SIZE+i,a);
+
+      map<string,string> attribs;
+      attribs["name"] = "array" + to_string(a);
+      if (a == N_ARRAYS) {
+         if (vlsv.setCodec("lz",100) == false) success = false;
+      }
+      if (vlsv.writeArray("VARIABLE",attribs,N_elements,VECTOR_SIZE,data.data()) == false) success = false;
+   }
+   if (vlsv.setCodec("") == false) success = false;
+
+   vector<int32_t> indices(N_elements);
+   for (uint64_t i=0; i<N_elements; ++i) indices[i] = -static_cast<int32_t>(offset+i);
+   map<string,string> attribs;
+   attribs["name"] = "indices";
+   if (vlsv.writeArray("VARIABLE",attribs,N_elements,1,indices.data()) == false) success = false;
+   if (vlsv.close() == false) success = false;
+   return success;
+}
+
+/** Swap the byte order of all arrays under the given XML node.*/
+void swapArrays(muxml::XMLNode* node,vector<char>& file) {
+   for (multimap<string,muxml::XMLNode*>::iterator it=node->children.begin(); it!=node->children.end(); ++it) {
+      muxml::XMLNode* child = it->second;
+      if (child->attributes.find("datasize") != child->attributes.end()) {
+         const uint64_t offset = strtoull(child->value.c_str(),NULL,10);
+         const uint64_t values = strtoull(child->attributes["arraysize"].c_str(),NULL,10)
+                               * strtoull(child->attributes["vectorsize"].c_str(),NULL,10);
+         const uint64_t dataSize = strtoull(child->attributes["datasize"].c_str(),NULL,10);
+         vlsv::swapByteOrder(file.data()+offset,values,dataSize);
+      }
+      swapArrays(child,file);
+   }
+}
+
+/** Copy an uncompressed file written in native byte order to a file in the opposite byte order.*/
+bool swapFileEndianness(const string& input,const string& output) {
+   ifstream in(input.c_str(),ifstream::binary);
+   vector<char> file((istreambuf_iterator<char>(in)),istreambuf_iterator<char>());
+   if (file.size() < 16) return false;
+
+   uint64_t footerOffset;
+   memcpy(&footerOffset,file.data()+8,sizeof(uint64_t));
+   if (footerOffset >= file.size()) return false;
+   muxml::MuXML footer;
+   if (footer.parse(file.data()+footerOffset,file.size()-footerOffset) == false) return false;
+   swapArrays(footer.getRoot(),file);
+
+   if (vlsv::detectEndianness() == vlsv::datatype::ENDIANNESS_LITTLE) file[0] = vlsv::datatype::ENDIANNESS_BIG;
+   else file[0] = vlsv::datatype::ENDIANNESS_LITTLE;
+   vlsv::swapByteOrder(file.data()+8,1,sizeof(uint64_t));
+
+   ofstream out(output.c_str(),ofstream::binary);
+   out.write(file.data(),file.size());
+   return out.good();
+}
+
+bool checkArray(const vector<double>& buffer,const uint64_t& offset,const int& array) {
+   for (uint64_t i=0; i<buffer.size(); ++i) {
+      if (buffer[i] != getValue(offset*VECTOR_SIZE+i,array)) return false;
+   }
+   return true;
+}
+
+bool readFile(const string& fileName,const bool& compressed,const int& myRank,const uint64_t& offset) {
+   bool success = true;
+   vlsv::ParallelReader vlsv;
+   if (vlsv.open(fileName,MPI_COMM_WORLD,0) == false) return false;
+   const uint64_t N_elements = getElements(myRank);
+   const int N_doubles = compressed ? N_ARRAYS+1 : N_ARRAYS;
+
+   // Start reads of all arrays, and complete them in a different order:
+   vector<vector<double> > buffers(N_doubles,vector<double>(N_elements*VECTOR_SIZE));
+   vector<vlsv::ReadRequest> requests(N_doubles);
+   for (int a=0; a<N_doubles; ++a) {
+      if (vlsv.ireadArray("VARIABLE",getAttributes(a),offset,N_elements,reinterpret_cast<char*>(buffers[a].data()),requests[a]) == false) {
+         cerr << "Process #" << myRank << " failed to start read of array " << a << endl;
+         success = false;
+      }
+   }
+   vector<int32_t> indices(N_elements);
+   vlsv::ReadRequest indexRequest;
+   list<pair<string,string> > attribs;
+   attribs.push_back(make_pair("name","indices"));
+   if (vlsv.ireadArray("VARIABLE",attribs,offset,N_elements,reinterpret_cast<char*>(indices.data()),indexRequest) == false) success = false;
+
+   // Active request cannot be reused:
+   if (vlsv.ireadArray("VARIABLE",getAttributes(0),offset,N_elements,reinterpret_cast<char*>(buffers[0].data()),requests[0]) == true) {
+      cerr << "Process #" << myRank << " reused an active request" << endl;
+      success = false;
+   }
+
+   if (vlsv.wait(indexRequest) == false) success = false;
+   for (uint64_t i=0; i<N_elements; ++i) {
+      if (indices[i] != -static_cast<int32_t>(offset+i)) {
+         cerr << "Process #" << myRank << " read wrong indices" << endl;
+         success = false; break;
+      }
+   }
+   for (int a=N_doubles-1; a>=0; --a) {
+      if (vlsv.wait(requests[a]) == false || checkArray(buffers[a],offset,a) == false) {
+         cerr << "Process #" << myRank << " failed to read array " << a << endl;
+         success = false;
+      }
+   }
+
+   // Completed request cannot be waited again:
+   if (vlsv.wait(requests[0]) == true) {
+      cerr << "Process #" << myRank << " waited for a completed request" << endl;
+      success = false;
+   }
+
+   // Multiread with two units, overlapped with a read of another array:
+   vector<double> first(VECTOR_SIZE*(N_elements/2));
+   vector<double> second(VECTOR_SIZE*(N_elements-N_elements/2));
+   vlsv::ReadRequest multireadRequest;
+   buffers[0].assign(buffers[0].size(),0.0);
+   if (vlsv.ireadArray("VARIABLE",getAttributes(0),offset,N_elements,reinterpret_cast<char*>(buffers[0].data()),requests[0]) == false) success = false;
+   if (vlsv.startMultiread("VARIABLE",getAttributes(1)) == false) success = false;
+   if (vlsv.addMultireadUnit(reinterpret_cast<char*>(first.data()),N_elements/2) == false) success = false;
+   if (vlsv.addMultireadUnit(reinterpret_cast<char*>(second.data()),N_elements-N_elements/2) == false) success = false;
+   if (vlsv.iendMultiread(offset,multireadRequest) == false) success = false;
+   if (vlsv.wait(requests[0]) == false || checkArray(buffers[0],offset,0) == false) success = false;
+   if (vlsv.wait(multireadRequest) == false) success = false;
+   if (checkArray(first,offset,1) == false || checkArray(second,offset+N_elements/2,1) == false) {
+      cerr << "Process #" << myRank << " failed to read array with multiread" << endl;
+      success = false;
+   }
+   vlsv.close();
+   return success;
+}
+
+int main(int argn,char* args[]) {
+   MPI_Init(&argn,&args);
+   int myRank,processes;
+   MPI_Comm_rank(MPI_COMM_WORLD,&myRank);
+   MPI_Comm_size(MPI_COMM_WORLD,&processes);
+
+   bool success = true;
+   const string fileName = "test_iread.vlsv";
+   const string uncompressedFileName = "test_iread_native.vlsv";
+   const string swappedFileName = "test_iread_swapped.vlsv";
+   uint64_t offset = 0;
+   for (int i=0; i<myRank; ++i) offset += getElements(i);
+
+   if (writeFile(fileName,true,myRank,offset) == false) success = false;
+   if (writeFile(uncompressedFileName,false,myRank,offset) == false) success = false;
+   if (success == false) cerr << "Process #" << myRank << " failed to write files" << endl;
+   if (myRank == 0 && swapFileEndianness(uncompressedFileName,swappedFileName) == false) {
+      cerr << "Failed to convert file byte order" << endl;
+      success = false;
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+
+   if (readFile(fileName,true,myRank,offset) == false) success = false;
+   if (readFile(swappedFileName,false,myRank,offset) == false) {
+      cerr << "Process #" << myRank << " failed to read file in opposite byte order" << endl;
+      success = false;
+   }
+
+   uint8_t mySuccess = success;
+   uint8_t allSuccess;
+   MPI_Reduce(&mySuccess,&allSuccess,1,MPI_UINT8_T,MPI_MIN,0,MPI_COMM_WORLD);
+   if (myRank == 0) {
+      if (allSuccess > 0) cout << "test_iread: PASSED" << endl;
+      else cout << "test_iread: FAILED" << endl;
+   }
+   MPI_Finalize();
+   return success ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "../muxml.h"
+
+using namespace std;
+
+/* Test of the bulk XML parser used to read VLSV footers. A footer is parsed
+ * in full and from every truncated prefix, which must be rejected, and the
+ * parsed tree is printed and read back. Run with './test_muxml'.*/
+
+const string footer =
+   "<?xml version=\"1.0\"?>\n"
+   "<!-- comment -->\n"
+   "<VLSV>\n"
+   "   <PARAMETER arraysize=\"1\" datasize=\"8\" name='time' vectorsize=\"1\">16</PARAMETER>\n"
+   "   <MESH name=\"mesh\" type = \"multi_ucd\"/>\n"
+   "   <VARIABLE mesh=\"mesh\" name=\"rho\" unit=\"1/m^3 'SI'\">24</VARIABLE>\n"
+   "   <VARIABLE mesh=\"mesh\" name=\"B\">\n"
+   "      1024\n"
+   "   </VARIABLE>\n"
+   "</VLSV>\n";
+
+bool checkTree(const muxml::MuXML& xml) {
+   bool success = true;
+   muxml::XMLNode* vlsvNode = xml.find("VLSV");
+   if (vlsvNode == NULL || vlsvNode->children.size() != 4) return false;
+
+   list<pair<string,string> > attribs;
+   attribs.push_back(make_pair("name","rho"));
+   muxml::XMLNode* node = xml.find("VARIABLE",attribs);
+   if (node == NULL || node->value != "24" || xml.getAttributeValue(node,"unit") != "1/m^3 'SI'") success = false;
+
+   attribs.clear();
+   attribs.push_back(make_pair("name","B"));
+   node = xml.find("VARIABLE",attribs);
+   if (node == NULL || node->value != "1024") success = false;
+
+   node = xml.find("PARAMETER");
+   if (node == NULL || node->value != "16" || xml.getAttributeValue(node,"name") != "time") success = false;
+
+   node = xml.find("MESH");
+   if (node == NULL || node->value != "" || xml.getAttributeValue(node,"type") != "multi_ucd") success = false;
+   return success;
+}
+
+int main(int argn,char* args[]) {
+   bool success = true;
+
+   muxml::MuXML xml;
+   if (xml.parse(footer.data(),footer.size()) == false || checkTree(xml) == false) {
+      cerr << "Failed to parse footer" << endl;
+      success = false;
+   }
+
+   // Footers truncated after the VLSV tag has been opened must be rejected:
+   const size_t first = footer.find("<VLSV>") + 1;
+   const size_t last = footer.find("</VLSV>") + 7;
+   for (size_t bytes=first; bytes<last; ++bytes) {
+      muxml::MuXML truncated;
+      if (truncated.parse(footer.data(),bytes) == true) {
+         cerr << "Footer truncated to " << bytes << " bytes was parsed successfully" << endl;
+         success = false;
+         break;
+      }
+   }
+
+   // Malformed tags must be rejected:
+   const string malformed[] = {"<VLSV><A name=\"x>1</A></VLSV>","<VLSV><A name>1</A></VLSV>","<VLSV><A/ ></VLSV>","VLSV"};
+   for (size_t i=0; i<sizeof(malformed)/sizeof(string); ++i) {
+      muxml::MuXML bad;
+      if (bad.parse(malformed[i].data(),malformed[i].size()) == true) {
+         cerr << "Malformed XML '" << malformed[i] << "' was parsed successfully" << endl;
+         success = false;
+      }
+   }
+
+   // Printed tree must be read back to an identical tree:
+   stringstream printed;
+   xml.print(printed);
+   muxml::MuXML copy;
+   stringstream reprinted;
+   if (copy.read(printed) == false || checkTree(copy) == false) {
+      cerr << "Failed to read printed footer" << endl;
+      success = false;
+   }
+   copy.print(reprinted);
+   if (reprinted.str() != printed.str()) {
+      cerr << "Printed footers differ" << endl;
+      success = false;
+   }
+
+   if (success == true) cout << "test_muxml: PASSED" << endl;
+   else cout << "test_muxml: FAILED" << endl;
+   return success ? 0 : 1;
+}
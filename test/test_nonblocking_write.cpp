@@ -0,0 +1,154 @@
+#include <cstdlib>
+#include <iostream>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <vector>
+
+#include "../vlsv_writer.h"
+#include "../vlsv_reader.h"
+
+using namespace std;
+
+/* Round-trip test of non-blocking writes. Arrays are written with iwriteArray and
+ * iendMultiwrite without staging buffers, with staging buffers that only fit some of
+ * the arrays, and with staging buffers that fit all of them. Staged user buffers are
+ * overwritten right after the write has been started. Writes are completed with test,
+ * wait, waitAll, and close. Run with e.g. 'mpirun -np 3 ./test_nonblocking_write'.*/
+
+const int N_ARRAYS = 6;
+
+uint64_t getElements(const int& rank) {
+   return 100 + 13*rank;
+}
+
+double getValue(const uint64_t& globalIndex,const int& array) {
+   return 1000000*array + globalIndex;
+}
+
+bool writeFile(const string& fileName,const uint64_t& stagingBytes,const int& myRank,const int& processes) {
+   bool success = true;
+   vlsv::Writer vlsv;
+   if (vlsv.setStagingBufferSize(stagingBytes) == false) success = false;
+   if (vlsv.open(fileName,MPI_COMM_WORLD,0) == false) return false;
+
+   uint64_t offset = 0;
+   for (int i=0; i<myRank; ++i) offset += getElements(i);
+   const uint64_t N_elements = getElements(myRank);
+
+   vector<vector<double> > data(N_ARRAYS,vector<double>(N_elements));
+   vector<int> requestIDs(N_ARRAYS);
+   for (int a=0; a<N_ARRAYS; ++a) {
+      for (uint64_t i=0; i<N_elements; ++i) data[a][i] = getValue(offset+i,a);
+
+      map<string,string> attribs;
+      attribs["name"] = "array" + to_string(a);
+      if (a % 2 == 0) {
+         if (vlsv.iwriteArray("VARIABLE",attribs,N_elements,1,data[a].data(),requestIDs[a]) == false) success = false;
+      } else {
+         if (vlsv.startMultiwrite<double>(N_elements,1) == false) success = false;
+         if (vlsv.addMultiwriteUnit(data[a].data(),N_elements/2) == false) success = false;
+         if (vlsv.addMultiwriteUnit(data[a].data()+N_elements/2,N_elements-N_elements/2) == false) success = false;
+         if (vlsv.iendMultiwrite("VARIABLE",attribs,requestIDs[a]) == false) success = false;
+      }
+
+      // Staged data has been copied, or the write has completed before return:
+      if (stagingBytes > 0) data[a].assign(N_elements,-1.0);
+   }
+
+   // Poll the first write until it has completed. Completed writes remain completed:
+   bool completed = false;
+   while (completed == false) {
+      if (vlsv.test(requestIDs[0],completed) == false) {
+         success = false; break;
+      }
+   }
+   if (vlsv.test(requestIDs[0],completed) == false || completed == false) success = false;
+   if (vlsv.wait(requestIDs[1]) == false) success = false;
+   if (vlsv.wait(requestIDs[1]) == false) success = false;
+   if (vlsv.wait(requestIDs.back()+1) == true) {
+      cerr << "Writer waited for a write that has not been started" << endl;
+      success = false;
+   }
+   if (vlsv.waitAll() == false) success = false;
+
+   // Last write is left pending and completed by close:
+   for (uint64_t i=0; i<N_elements; ++i) data[0][i] = getValue(offset+i,N_ARRAYS);
+   map<string,string> attribs;
+   attribs["name"] = "array" + to_string(N_ARRAYS);
+   int requestID;
+   if (vlsv.iwriteArray("VARIABLE",attribs,N_elements,1,data[0].data(),requestID) == false) success = false;
+
+   double time = 1.5;
+   if (vlsv.writeParameter("time",&time) == false) success = false;
+   if (vlsv.close() == false) success = false;
+   return success;
+}
+
+bool readFile(const string& fileName,const uint64_t& N_total) {
+   bool success = true;
+   vlsv::Reader vlsv;
+   if (vlsv.open(fileName) == false) return false;
+
+   for (int a=0; a<=N_ARRAYS; ++a) {
+      list<pair<string,string> > attribs;
+      attribs.push_back(make_pair("name","array"+to_string(a)));
+      double* buffer = NULL;
+      if (vlsv.read("VARIABLE",attribs,0,N_total,buffer) == false) {
+         cerr << "Failed to read array " << a << endl;
+         success = false; continue;
+      }
+      for (uint64_t i=0; i<N_total; ++i) {
+         if (buffer[i] != getValue(i,a)) {
+            cerr << "Array " << a << " has wrong value at index " << i << endl;
+            success = false; break;
+         }
+      }
+      delete [] buffer; buffer = NULL;
+   }
+
+   double time;
+   if (vlsv.readParameter("time",time) == false || time != 1.5) {
+      cerr << "Failed to read parameter" << endl;
+      success = false;
+   }
+   vlsv.close();
+   return success;
+}
+
+int main(int argn,char* args[]) {
+   MPI_Init(&argn,&args);
+   int myRank,processes;
+   MPI_Comm_rank(MPI_COMM_WORLD,&myRank);
+   MPI_Comm_size(MPI_COMM_WORLD,&processes);
+
+   bool success = true;
+   const string fileName = "test_nonblocking_write.vlsv";
+   uint64_t N_total = 0;
+   for (int i=0; i<processes; ++i) N_total += getElements(i);
+
+   // No staging, staging buffers that fit about two arrays, and staging buffers that fit all arrays:
+   const uint64_t stagingBytes[] = {0,2*getElements(processes)*sizeof(double),64*1024*1024};
+   for (int s=0; s<3; ++s) {
+      if (writeFile(fileName,stagingBytes[s],myRank,processes) == false) {
+         cerr << "Process #" << myRank << " failed to write file, staging buffer size " << stagingBytes[s] << endl;
+         success = false;
+      }
+      MPI_Barrier(MPI_COMM_WORLD);
+      if (myRank == 0 && readFile(fileName,N_total) == false) {
+         cerr << "Failed to read file, staging buffer size " << stagingBytes[s] << endl;
+         success = false;
+      }
+      MPI_Barrier(MPI_COMM_WORLD);
+   }
+
+   uint8_t mySuccess = success;
+   uint8_t allSuccess;
+   MPI_Reduce(&mySuccess,&allSuccess,1,MPI_UINT8_T,MPI_MIN,0,MPI_COMM_WORLD);
+   if (myRank == 0) {
+      if (allSuccess > 0) cout << "test_nonblocking_write: PASSED" << endl;
+      else cout << "test_nonblocking_write: FAILED" << endl;
+   }
+   MPI_Finalize();
+   return success ? 0 : 1;
+}
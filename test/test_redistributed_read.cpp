@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "../vlsv_writer.h"
+#include "../vlsv_reader_parallel.h"
+
+using namespace std;
+
+/* Round-trip test of ParallelReader::readRedistributed. A multi-domain mesh whose domains
+ * end with ghost cells is written by all but the last process, and read back by all
+ * processes. Every real cell must be received exactly once by its owner, ghost cells must
+ * be skipped, and variable values must follow their cells. The test is repeated with a
+ * small maxRoundBytes so that the data is redistributed in several rounds.
+ * Run with e.g. 'mpirun -np 3 ./test_redistributed_read'.*/
+
+const uint64_t GHOST_ID = 5;
+
+uint64_t getElements(const int& rank) {
+   return 200 + 37*rank;
+}
+
+uint64_t getGhosts(const int& rank) {
+   return rank + 3;
+}
+
+uint64_t getCellID(const int& rank,const uint64_t& i) {
+   return 1000000*(rank+1) + 7*i;
+}
+
+int getOwner(const uint64_t& cellID,const int& processes) {
+   return (cellID/7) % processes;
+}
+
+bool writeFile(const string& fileName,const int& writers,const int& myRank) {
+   bool success = true;
+   MPI_Comm comm;
+   MPI_Comm_split(MPI_COMM_WORLD,myRank < writers ? 0 : MPI_UNDEFINED,myRank,&comm);
+   if (myRank >= writers) return success;
+
+   const uint64_t N_elements = getElements(myRank);
+   const uint64_t N_ghosts = getGhosts(myRank);
+   vector<uint64_t> cellIDs(N_elements+N_ghosts,GHOST_ID);
+   vector<double> vectors(3*N_elements);
+   vector<float> scalars(N_elements);
+   for (uint64_t i=0; i<N_elements; ++i) {
+      cellIDs[i] = getCellID(myRank,i);
+      for (int c=0; c<3; ++c) vectors[3*i+c] = cellIDs[i] + 0.25*c;
+      scalars[i] = cellIDs[i] % 1000;
+   }
+
+   vlsv::Writer vlsv;
+   if (vlsv.open(fileName,comm,0) == false) success = false;
+   map<string,string> attribs;
+   attribs["name"] = "mesh";
+   if (vlsv.writeArray("MESH",attribs,cellIDs.size(),1,cellIDs.data()) == false) success = false;
+
+   const uint64_t domainSizes[] = {N_elements+N_ghosts,N_ghosts};
+   attribs.clear();
+   attribs["mesh"] = "mesh";
+   if (vlsv.writeArray("MESH_DOMAIN_SIZES",attribs,1,2,domainSizes) == false) success = false;
+
+   attribs["name"] = "vectors";
+   if (vlsv.writeArray("VARIABLE",attribs,N_elements,3,vectors.data()) == false) success = false;
+
+   // Second variable is compressed so that chunked reads are redistributed as well:
+   attribs["name"] = "scalars";
+   if (vlsv.setCodec("lz",100) == false) success = false;
+   if (vlsv.writeArray("VARIABLE",attribs,N_elements,1,scalars.data()) == false) success = false;
+   if (vlsv.close() == false) success = false;
+   MPI_Comm_free(&comm);
+   return success;
+}
+
+bool readFile(const string& fileName,const uint64_t& maxRoundBytes,const uint64_t& N_total,const int& myRank,const int& processes) {
+   bool success = true;
+   vlsv::ParallelReader vlsv;
+   if (vlsv.open(fileName,MPI_COMM_WORLD,0) == false) return false;
+
+   vector<string> variableNames;
+   variableNames.push_back("vectors");
+   variableNames.push_back("scalars");
+   auto owner = [processes](const uint64_t& cellID) {return getOwner(cellID,processes);};
+   vector<uint64_t> cellIDs;
+   vector<vector<char> > variables;
+   if (vlsv.readRedistributed("mesh",variableNames,owner,cellIDs,variables,maxRoundBytes) == false) {
+      vlsv.close();
+      return false;
+   }
+
+   if (variables.size() != 2 || variables[0].size() != cellIDs.size()*3*sizeof(double)
+       || variables[1].size() != cellIDs.size()*sizeof(float)) {
+      cerr << "Process #" << myRank << " received variables of wrong size" << endl;
+      vlsv.close();
+      return false;
+   }
+   const double* vectors = reinterpret_cast<const double*>(variables[0].data());
+   const float* scalars = reinterpret_cast<const float*>(variables[1].data());
+   for (size_t i=0; i<cellIDs.size(); ++i) {
+      if (owner(cellIDs[i]) != myRank) {
+         cerr << "Process #" << myRank << " received cell " << cellIDs[i] << " that it does not own" << endl;
+         success = false; break;
+      }
+      if (vectors[3*i+2] != cellIDs[i]+0.5 || scalars[i] != cellIDs[i] % 1000) {
+         cerr << "Process #" << myRank << " received wrong values for cell " << cellIDs[i] << endl;
+         success = false; break;
+      }
+   }
+
+   // Every real cell is received once, ghost cells are skipped:
+   set<uint64_t> uniqueIDs(cellIDs.begin(),cellIDs.end());
+   if (uniqueIDs.size() != cellIDs.size() || uniqueIDs.count(GHOST_ID) > 0) {
+      cerr << "Process #" << myRank << " received duplicate or ghost cells" << endl;
+      success = false;
+   }
+   uint64_t myCells = cellIDs.size();
+   uint64_t totalCells;
+   MPI_Allreduce(&myCells,&totalCells,1,MPI_UINT64_T,MPI_SUM,MPI_COMM_WORLD);
+   if (totalCells != N_total) {
+      if (myRank == 0) cerr << "Received " << totalCells << " cells instead of " << N_total << endl;
+      success = false;
+   }
+   vlsv.close();
+   return success;
+}
+
+int main(int argn,char* args[]) {
+   MPI_Init(&argn,&args);
+   int myRank,processes;
+   MPI_Comm_rank(MPI_COMM_WORLD,&myRank);
+   MPI_Comm_size(MPI_COMM_WORLD,&processes);
+
+   bool success = true;
+   const string fileName = "test_redistributed_read.vlsv";
+   const int writers = max(1,processes-1);
+   uint64_t N_total = 0;
+   for (int i=0; i<writers; ++i) N_total += getElements(i);
+   if (writeFile(fileName,writers,myRank) == false) {
+      cerr << "Process #" << myRank << " failed to write file" << endl;
+      success = false;
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+
+   // Default round size reads everything in one round:
+   const uint64_t roundBytes[] = {64*1024*1024,1000};
+   for (int r=0; r<2; ++r) {
+      if (readFile(fileName,roundBytes[r],N_total,myRank,processes) == false) {
+         cerr << "Process #" << myRank << " failed to read file with round size " << roundBytes[r] << endl;
+         success = false;
+      }
+   }
+
+   uint8_t mySuccess = success;
+   uint8_t allSuccess;
+   MPI_Reduce(&mySuccess,&allSuccess,1,MPI_UINT8_T,MPI_MIN,0,MPI_COMM_WORLD);
+   if (myRank == 0) {
+      if (allSuccess > 0) cout << "test_redistributed_read: PASSED" << endl;
+      else cout << "test_redistributed_read: FAILED" << endl;
+   }
+   MPI_Finalize();
+   return success ? 0 : 1;
+}
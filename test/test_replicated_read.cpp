@@ -0,0 +1,129 @@
+#include <cstdlib>
+#include <iostream>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <vector>
+
+#include "../vlsv_writer.h"
+#include "../vlsv_reader_parallel.h"
+
+using namespace std;
+
+/* Round-trip test of ParallelReader::readReplicated. Lookup tables are written by the
+ * master process, uncompressed and compressed, and every process reads them to node-local
+ * shared memory. Tables read earlier must remain valid while other tables are read, and
+ * the file is reopened to check that shared windows are released and recreated.
+ * Run with e.g. 'mpirun -np 3 ./test_replicated_read'.*/
+
+const uint64_t N_ELEMENTS = 100003;
+
+double getValue(const uint64_t& index,const int& table) {
+   return 0.5*index + 1000000*table;
+}
+
+bool writeFile(const string& fileName,const int& myRank) {
+   bool success = true;
+   vlsv::Writer vlsv;
+   if (vlsv.open(fileName,MPI_COMM_WORLD,0) == false) return false;
+
+   const uint64_t N_elements = (myRank == 0) ? N_ELEMENTS : 0;
+   for (int t=0; t<2; ++t) {
+      vector<double> data(2*N_elements);
+      for (uint64_t i=0; i<data.size(); ++i) data[i] = getValue(i,t);
+
+      map<string,string> attribs;
+      attribs["name"] = "table" + to_string(t);
+      if (t == 1) {
+         if (vlsv.setCodec("lz",1000) == false) success = false;
+      }
+      if (vlsv.writeArray("VARIABLE",attribs,N_elements,2,data.data()) == false) success = false;
+   }
+   if (vlsv.close() == false) success = false;
+   return success;
+}
+
+bool checkTable(const double* data,const int& table) {
+   for (uint64_t i=0; i<2*N_ELEMENTS; ++i) {
+      if (data[i] != getValue(i,table)) {
+         cerr << "Table " << table << " has wrong value at index " << i << endl;
+         return false;
+      }
+   }
+   return true;
+}
+
+bool readFile(const string& fileName) {
+   bool success = true;
+   vlsv::ParallelReader vlsv;
+   if (vlsv.open(fileName,MPI_COMM_WORLD,0) == false) return false;
+
+   vector<const double*> tables(2,static_cast<const double*>(NULL));
+   for (int t=0; t<2; ++t) {
+      list<pair<string,string> > attribs;
+      attribs.push_back(make_pair("name","table"+to_string(t)));
+
+      const char* data = NULL;
+      uint64_t arraySize,vectorSize,dataSize;
+      vlsv::datatype::type dataType;
+      if (vlsv.readReplicated("VARIABLE",attribs,data,arraySize,vectorSize,dataType,dataSize) == false) {
+         cerr << "Failed to read table " << t << endl;
+         success = false; continue;
+      }
+      if (arraySize != N_ELEMENTS || vectorSize != 2 || dataType != vlsv::datatype::FLOAT || dataSize != sizeof(double)) {
+         cerr << "Table " << t << " has wrong metadata" << endl;
+         success = false; continue;
+      }
+      tables[t] = reinterpret_cast<const double*>(data);
+   }
+
+   // All tables remain valid until the file is closed:
+   for (int t=0; t<2; ++t) {
+      if (tables[t] != NULL && checkTable(tables[t],t) == false) success = false;
+   }
+
+   // Reading a nonexistent array fails on all processes:
+   list<pair<string,string> > attribs;
+   attribs.push_back(make_pair("name","nonexistent"));
+   const char* data = NULL;
+   uint64_t arraySize,vectorSize,dataSize;
+   vlsv::datatype::type dataType;
+   if (vlsv.readReplicated("VARIABLE",attribs,data,arraySize,vectorSize,dataType,dataSize) == true) {
+      cerr << "Nonexistent table was read" << endl;
+      success = false;
+   }
+   vlsv.close();
+   return success;
+}
+
+int main(int argn,char* args[]) {
+   MPI_Init(&argn,&args);
+   int myRank,processes;
+   MPI_Comm_rank(MPI_COMM_WORLD,&myRank);
+   MPI_Comm_size(MPI_COMM_WORLD,&processes);
+
+   bool success = true;
+   const string fileName = "test_replicated_read.vlsv";
+   if (writeFile(fileName,myRank) == false) {
+      cerr << "Process #" << myRank << " failed to write file" << endl;
+      success = false;
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+
+   for (int r=0; r<2; ++r) {
+      if (readFile(fileName) == false) {
+         cerr << "Process #" << myRank << " failed to read file" << endl;
+         success = false;
+      }
+   }
+
+   uint8_t mySuccess = success;
+   uint8_t allSuccess;
+   MPI_Reduce(&mySuccess,&allSuccess,1,MPI_UINT8_T,MPI_MIN,0,MPI_COMM_WORLD);
+   if (myRank == 0) {
+      if (allSuccess > 0) cout << "test_replicated_read: PASSED" << endl;
+      else cout << "test_replicated_read: FAILED" << endl;
+   }
+   MPI_Finalize();
+   return success ? 0 : 1;
+}
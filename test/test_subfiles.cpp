@@ -0,0 +1,209 @@
+#include <cstdlib>
+#include <iostream>
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <map>
+#include <vector>
+
+#include "../vlsv_writer.h"
+#include "../vlsv_reader.h"
+#include "../vlsv_reader_parallel.h"
+
+using namespace std;
+
+/* Round-trip test of subfiling. Arrays are written to the given number of subfiles
+ * with blocking, multiwrite, non-blocking, master-only, and compressed writes, and
+ * read back with vlsv::Reader and vlsv::ParallelReader. Processes write different
+ * numbers of elements and process #1 writes none.
+ * Run with e.g. 'mpirun -np 4 ./test_subfiles 3'.*/
+
+const int N_ARRAYS = 5;
+
+uint64_t getElements(const int& rank) {
+   if (rank == 1) return 0;
+   return 53 + 10*rank;
+}
+
+double getValue(const uint64_t& globalIndex,const int& array) {
+   return 1000000*array + globalIndex;
+}
+
+bool writeFile(const string& fileName,const int& subfiles,const int& myRank,const int& processes) {
+   bool success = true;
+   vlsv::Writer vlsv;
+   if (vlsv.open(fileName,MPI_COMM_WORLD,0,MPI_INFO_NULL,false,subfiles) == false) return false;
+
+   uint64_t offset = 0;
+   uint64_t N_total = 0;
+   for (int i=0; i<processes; ++i) {
+      if (i < myRank) offset += getElements(i);
+      N_total += getElements(i);
+   }
+   const uint64_t N_elements = getElements(myRank);
+
+   for (int a=0; a<N_ARRAYS; ++a) {
+      map<string,string> attribs;
+      attribs["name"] = "array" + to_string(a);
+
+      // Array 3 is gathered to master process and written to the main file:
+      uint64_t myOffset = offset;
+      uint64_t myElements = N_elements;
+      if (a == 3) {
+         myOffset = 0;
+         myElements = 0;
+         if (myRank == 0) myElements = N_total;
+      }
+      vector<double> data(myElements);
+      for (uint64_t i=0; i<data.size(); ++i) data[i] = getValue(myOffset+i,a);
+
+      switch (a) {
+       case 0:
+         if (vlsv.writeArray("VARIABLE",attribs,N_elements,1,data.data()) == false) success = false;
+         break;
+       case 1:
+         if (vlsv.startMultiwrite<double>(N_elements,1) == false) success = false;
+         if (vlsv.addMultiwriteUnit(data.data(),N_elements/2) == false) success = false;
+         if (vlsv.addMultiwriteUnit(data.data()+N_elements/2,N_elements-N_elements/2) == false) success = false;
+         if (vlsv.endMultiwrite("VARIABLE",attribs) == false) success = false;
+         break;
+       case 2:
+         int requestID;
+         if (vlsv.iwriteArray("VARIABLE",attribs,N_elements,1,data.data(),requestID) == false) success = false;
+         if (vlsv.wait(requestID) == false) success = false;
+         break;
+       case 3:
+         if (vlsv.writeArrayMaster("VARIABLE",attribs,"float",myElements,1,sizeof(double),
+                                   reinterpret_cast<char*>(data.data())) == false) success = false;
+         break;
+       case 4:
+         if (vlsv.setCodec("lz",11) == false) success = false;
+         if (vlsv.writeArray("VARIABLE",attribs,N_elements,1,data.data()) == false) success = false;
+         if (vlsv.setCodec("") == false) success = false;
+         break;
+      }
+   }
+
+   double time = 1.5;
+   if (vlsv.writeParameter("time",&time) == false) success = false;
+   if (vlsv.close() == false) success = false;
+   return success;
+}
+
+bool readFileSerial(const string& fileName,const int& subfiles,const uint64_t& N_total) {
+   bool success = true;
+
+   // Check that subfiles exist:
+   if (subfiles > 1) {
+      for (int s=0; s<subfiles; ++s) {
+         ifstream in((fileName + '.' + to_string(s)).c_str());
+         if (in.good() == false) {
+            cerr << "Subfile " << s << " does not exist" << endl;
+            success = false;
+         }
+      }
+   }
+
+   vlsv::Reader vlsv;
+   if (vlsv.open(fileName) == false) return false;
+   for (int a=0; a<N_ARRAYS; ++a) {
+      list<pair<string,string> > attribs;
+      attribs.push_back(make_pair("name","array"+to_string(a)));
+
+      // Read the whole array, and a range that crosses subfile boundaries:
+      const uint64_t begins[] = {0,N_total/4};
+      const uint64_t amounts[] = {N_total,N_total/2};
+      for (int r=0; r<2; ++r) {
+         double* buffer = NULL;
+         if (vlsv.read("VARIABLE",attribs,begins[r],amounts[r],buffer) == false) {
+            cerr << "Failed to read array " << a << endl;
+            success = false; continue;
+         }
+         for (uint64_t i=0; i<amounts[r]; ++i) {
+            if (buffer[i] != getValue(begins[r]+i,a)) {
+               cerr << "Array " << a << " has wrong value at index " << begins[r]+i << endl;
+               success = false; break;
+            }
+         }
+         delete [] buffer; buffer = NULL;
+      }
+   }
+
+   double time;
+   if (vlsv.readParameter("time",time) == false || time != 1.5) {
+      cerr << "Failed to read parameter" << endl;
+      success = false;
+   }
+   vlsv.close();
+   return success;
+}
+
+bool readFileParallel(const string& fileName,const int& myRank,const int& processes) {
+   bool success = true;
+   vlsv::ParallelReader vlsv;
+   if (vlsv.open(fileName,MPI_COMM_WORLD,0) == false) return false;
+
+   uint64_t offset = 0;
+   for (int i=0; i<myRank; ++i) offset += getElements(i);
+   const uint64_t N_elements = getElements(myRank);
+
+   for (int a=0; a<N_ARRAYS; ++a) {
+      list<pair<string,string> > attribs;
+      attribs.push_back(make_pair("name","array"+to_string(a)));
+
+      // Read the data with a single call and with multiread:
+      vector<double> buffer(N_elements);
+      if (vlsv.readArray("VARIABLE",attribs,offset,N_elements,reinterpret_cast<char*>(buffer.data())) == false) success = false;
+      for (uint64_t i=0; i<N_elements; ++i) if (buffer[i] != getValue(offset+i,a)) success = false;
+
+      buffer.assign(N_elements,0.0);
+      if (vlsv.startMultiread("VARIABLE",attribs) == false) success = false;
+      if (vlsv.addMultireadUnit(reinterpret_cast<char*>(buffer.data()),N_elements/3) == false) success = false;
+      if (vlsv.addMultireadUnit(reinterpret_cast<char*>(buffer.data()+N_elements/3),N_elements-N_elements/3) == false) success = false;
+      if (vlsv.endMultiread(offset) == false) success = false;
+      for (uint64_t i=0; i<N_elements; ++i) if (buffer[i] != getValue(offset+i,a)) success = false;
+   }
+   vlsv.close();
+   return success;
+}
+
+int main(int argn,char* args[]) {
+   MPI_Init(&argn,&args);
+   int myRank,processes;
+   MPI_Comm_rank(MPI_COMM_WORLD,&myRank);
+   MPI_Comm_size(MPI_COMM_WORLD,&processes);
+
+   int subfiles = 2;
+   if (argn > 1) subfiles = atoi(args[1]);
+   if (processes < 2 || subfiles < 1 || subfiles > processes) {
+      if (myRank == 0) cerr << "USAGE: mpirun -np N ./test_subfiles M, where 2 <= N and 1 <= M <= N" << endl;
+      MPI_Finalize();
+      return 1;
+   }
+
+   bool success = true;
+   const string fileName = "test_subfiles.vlsv";
+   uint64_t N_total = 0;
+   for (int i=0; i<processes; ++i) N_total += getElements(i);
+   if (writeFile(fileName,subfiles,myRank,processes) == false) {
+      cerr << "Process #" << myRank << " failed to write file" << endl;
+      success = false;
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+
+   if (myRank == 0 && readFileSerial(fileName,subfiles,N_total) == false) success = false;
+   if (readFileParallel(fileName,myRank,processes) == false) {
+      cerr << "Process #" << myRank << " failed to read file in parallel" << endl;
+      success = false;
+   }
+
+   uint8_t mySuccess = success;
+   uint8_t allSuccess;
+   MPI_Reduce(&mySuccess,&allSuccess,1,MPI_UINT8_T,MPI_MIN,0,MPI_COMM_WORLD);
+   if (myRank == 0) {
+      if (allSuccess > 0) cout << "test_subfiles: PASSED" << endl;
+      else cout << "test_subfiles: FAILED" << endl;
+   }
+   MPI_Finalize();
+   return success ? 0 : 1;
+}
@@ -0,0 +1,225 @@
+/** This file is part of VLSV file format.
+ * 
+ *  Copyright 2011-2016 Finnish Meteorological Institute
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "vlsv_block_cache.h"
+
+using namespace std;
+
+namespace vlsv {
+
+   /** Constructor for class BlockCache. The cache is initially disabled.*/
+   BlockCache::BlockCache() {
+      byteLimit = 0;
+      bytes = 0;
+      evictions = 0;
+      hits = 0;
+      misses = 0;
+   }
+
+   /** Compare two block identifiers. Blocks of the same array are ordered by their first element.
+    * @param other Identifier compared to this one.
+    * @return If true, this identifier is ordered before the other one.*/
+   bool BlockCache::Key::operator<(const Key& other) const {
+      if (file != other.file) return file < other.file;
+      if (array != other.array) return array < other.array;
+      return begin < other.begin;
+   }
+
+   /** Remove all blocks from the cache. Counters are not reset.*/
+   void BlockCache::clear() {
+      lock_guard<mutex> lock(cacheMutex);
+      blocks.clear();
+      lruOrder.clear();
+      bytes = 0;
+   }
+
+   /** Remove a block from the cache. Caller must hold the mutex.
+    * @param it Iterator to the removed block.*/
+   void BlockCache::erase(std::map<Key,Block>::iterator it) {
+      bytes -= it->second.data.size();
+      lruOrder.erase(it->second.lru);
+      blocks.erase(it);
+   }
+
+   /** Evict least recently used blocks until the total size of cached 
+    * blocks is at most the given limit. Caller must hold the mutex.
+    * @param limit Maximum total size of cached blocks in bytes.*/
+   void BlockCache::evict(const uint64_t& limit) {
+      while (bytes > limit && lruOrder.empty() == false) {
+         erase(blocks.find(lruOrder.back()));
+         ++evictions;
+      }
+   }
+
+   /** Copy the given array elements from the cache. The elements are found if 
+    * they are contained in a single cached block. Cached blocks of an array never 
+    * contain each other, see insert, so the blocks of an array that are ordered by 
+    * their first element are also ordered by their last element. The block with 
+    * the largest first element not after begin is therefore the only block that 
+    * needs to be checked.
+    * @param file Identity of the file.
+    * @param array Identity of the array within the file.
+    * @param elementBytes Byte size of an array element.
+    * @param begin Index of the first requested array element.
+    * @param amount Number of requested array elements.
+    * @param buffer Buffer in which the elements are copied.
+    * @return If true, the elements were found and copied to buffer.*/
+   bool BlockCache::find(const std::string& file,const std::string& array,const uint64_t& elementBytes,
+                         const uint64_t& begin,const uint64_t& amount,char* buffer) {
+      lock_guard<mutex> lock(cacheMutex);
+      Key key;
+      key.file = file;
+      key.array = array;
+      key.begin = begin;
+
+      map<Key,Block>::iterator it = findCovering(key,elementBytes,amount);
+      if (it == blocks.end()) {
+         ++misses;
+         return false;
+      }
+      const Block& block = it->second;
+      memcpy(buffer,&(block.data[(begin-it->first.begin)*elementBytes]),amount*elementBytes);
+      lruOrder.splice(lruOrder.begin(),lruOrder,block.lru);
+      ++hits;
+      return true;
+   }
+
+   /** Find the cached block that contains the given array elements. Caller must hold the mutex.
+    * @param key Identifier of the file, the array, and the first requested array element.
+    * @param elementBytes Byte size of an array element.
+    * @param amount Number of requested array elements.
+    * @return Iterator to the block, or blocks.end() if the elements are not in a single block.*/
+   std::map<BlockCache::Key,BlockCache::Block>::iterator BlockCache::findCovering(const Key& key,const uint64_t& elementBytes,
+                                                                                 const uint64_t& amount) {
+      // Find the block of this array that has the largest first element not after begin:
+      map<Key,Block>::iterator it = blocks.upper_bound(key);
+      if (it == blocks.begin()) return blocks.end();
+      --it;
+      const Key& found = it->first;
+      const Block& block = it->second;
+      if (found.file == key.file && found.array == key.array && block.elementBytes == elementBytes
+          && found.begin + block.amount >= key.begin + amount) return it;
+      return blocks.end();
+   }
+
+   /** Get the process-wide cache used by all instances of vlsv::Reader.
+    * @return Reference to the cache.*/
+   BlockCache& BlockCache::global() {
+      static BlockCache cache;
+      return cache;
+   }
+
+   /** @return Maximum total size of cached blocks in bytes.*/
+   uint64_t BlockCache::getByteLimit() const {
+      lock_guard<mutex> lock(cacheMutex);
+      return byteLimit;
+   }
+
+   /** @return Total size of cached blocks in bytes.*/
+   uint64_t BlockCache::getBytes() const {
+      lock_guard<mutex> lock(cacheMutex);
+      return bytes;
+   }
+
+   /** @return Number of blocks evicted to make room for new blocks.*/
+   uint64_t BlockCache::getEvictions() const {
+      lock_guard<mutex> lock(cacheMutex);
+      return evictions;
+   }
+
+   /** @return Number of reads served from the cache.*/
+   uint64_t BlockCache::getHits() const {
+      lock_guard<mutex> lock(cacheMutex);
+      return hits;
+   }
+
+   /** @return Number of reads that were not found in the cache.*/
+   uint64_t BlockCache::getMisses() const {
+      lock_guard<mutex> lock(cacheMutex);
+      return misses;
+   }
+
+   /** Add array elements to the cache. Blocks larger than the byte limit are not cached. 
+    * If the elements are already contained in a cached block, nothing is added. Cached 
+    * blocks of the same array that are contained in the new block are removed.
+    * @param file Identity of the file.
+    * @param array Identity of the array within the file.
+    * @param elementBytes Byte size of an array element.
+    * @param begin Index of the first array element.
+    * @param amount Number of array elements.
+    * @param buffer Contents of the array elements.*/
+   void BlockCache::insert(const std::string& file,const std::string& array,const uint64_t& elementBytes,
+                           const uint64_t& begin,const uint64_t& amount,const char* buffer) {
+      lock_guard<mutex> lock(cacheMutex);
+      const uint64_t blockBytes = amount*elementBytes;
+      if (blockBytes == 0 || blockBytes > byteLimit) return;
+
+      Key key;
+      key.file = file;
+      key.array = array;
+      key.begin = begin;
+      map<Key,Block>::iterator it = findCovering(key,elementBytes,amount);
+      if (it != blocks.end()) {
+         lruOrder.splice(lruOrder.begin(),lruOrder,it->second.lru);
+         return;
+      }
+
+      // Remove blocks contained in the new block. Blocks of an array do not contain 
+      // each other, so they are ordered by their last element and the search can stop 
+      // at the first block that ends after the new block:
+      it = blocks.lower_bound(key);
+      while (it != blocks.end() && it->first.file == file && it->first.array == array
+             && it->first.begin + it->second.amount <= begin + amount) {
+         map<Key,Block>::iterator next = it;
+         ++next;
+         erase(it);
+         it = next;
+      }
+      evict(byteLimit - blockBytes);
+
+      Block& block = blocks[key];
+      block.amount = amount;
+      block.elementBytes = elementBytes;
+      block.data.assign(buffer,buffer+blockBytes);
+      lruOrder.push_front(key);
+      block.lru = lruOrder.begin();
+      bytes += blockBytes;
+   }
+
+   /** Reset hit, miss, and eviction counters to zero.*/
+   void BlockCache::resetCounters() {
+      lock_guard<mutex> lock(cacheMutex);
+      evictions = 0;
+      hits = 0;
+      misses = 0;
+   }
+
+   /** Set the maximum total size of cached blocks. Blocks are evicted if 
+    * the cache is larger than the new limit. Zero disables the cache.
+    * @param limit Maximum total size of cached blocks in bytes.
+    * @return If true, the limit was set successfully.*/
+   bool BlockCache::setByteLimit(const uint64_t& limit) {
+      lock_guard<mutex> lock(cacheMutex);
+      byteLimit = limit;
+      evict(byteLimit);
+      return true;
+   }
+
+} // namespace vlsv
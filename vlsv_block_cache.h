@@ -0,0 +1,89 @@
+/** This file is part of VLSV file format.
+ * 
+ *  Copyright 2011-2016 Finnish Meteorological Institute
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VLSV_BLOCK_CACHE_H
+#define VLSV_BLOCK_CACHE_H
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace vlsv {
+
+   /** Process-wide cache of array data read by vlsv::Reader. Blocks are identified 
+    * by the file, the array, and the range of array elements, so that readers 
+    * that open the same file share the cached data. Cached data is in native byte 
+    * order and in the datatype it is stored in the file. When the total size of 
+    * cached blocks exceeds the byte limit, least recently used blocks are evicted. 
+    * The cache is disabled until a byte limit larger than zero is set.*/
+   class BlockCache {
+    public:
+      static BlockCache& global();
+
+      void clear();
+      bool find(const std::string& file,const std::string& array,const uint64_t& elementBytes,
+                const uint64_t& begin,const uint64_t& amount,char* buffer);
+      uint64_t getByteLimit() const;
+      uint64_t getBytes() const;
+      uint64_t getEvictions() const;
+      uint64_t getHits() const;
+      uint64_t getMisses() const;
+      void insert(const std::string& file,const std::string& array,const uint64_t& elementBytes,
+                  const uint64_t& begin,const uint64_t& amount,const char* buffer);
+      void resetCounters();
+      bool setByteLimit(const uint64_t& limit);
+
+    private:
+      BlockCache();
+
+      /** Identifier of a cached block.*/
+      struct Key {
+         std::string file;            /**< Identity of the file, see fileio::getFileIdentity.*/
+         std::string array;           /**< Identity of the array within the file.*/
+         uint64_t begin;              /**< Index of the first array element in the block.*/
+         bool operator<(const Key& other) const;
+      };
+
+      /** Cached block of array data.*/
+      struct Block {
+         uint64_t amount;             /**< Number of array elements in the block.*/
+         uint64_t elementBytes;       /**< Byte size of an array element.*/
+         std::vector<char> data;      /**< Contents of the block.*/
+         std::list<Key>::iterator lru; /**< Position of the block in usage order.*/
+      };
+
+      std::map<Key,Block> blocks;     /**< Cached blocks.*/
+      uint64_t byteLimit;             /**< Maximum total size of cached blocks in bytes.*/
+      uint64_t bytes;                 /**< Total size of cached blocks in bytes.*/
+      mutable std::mutex cacheMutex;  /**< Mutex that protects all member variables.*/
+      uint64_t evictions;             /**< Number of blocks evicted to make room for new blocks.*/
+      uint64_t hits;                  /**< Number of reads served from the cache.*/
+      std::list<Key> lruOrder;        /**< Keys of cached blocks, most recently used first.*/
+      uint64_t misses;                /**< Number of reads not found in the cache.*/
+
+      void erase(std::map<Key,Block>::iterator it);
+      void evict(const uint64_t& limit);
+      std::map<Key,Block>::iterator findCovering(const Key& key,const uint64_t& elementBytes,const uint64_t& amount);
+   };
+
+} // namespace vlsv
+
+#endif
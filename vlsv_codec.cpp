@@ -0,0 +1,366 @@
+/** This file is part of VLSV file format.
+ *
+ *  Copyright 2011-2016 Finnish Meteorological Institute
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+
+#include "vlsv_codec.h"
+
+#if defined(__AVX2__)
+   #include <immintrin.h>
+#elif defined(__SSE2__)
+   #include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace vlsv {
+
+   static const uint64_t LZ_MIN_MATCH   = 4;            /**< Shortest match encoded by CodecLZ.*/
+   static const uint64_t LZ_MAX_OFFSET  = 65535;        /**< Maximum distance to a match in CodecLZ.*/
+   static const int LZ_HASH_BITS        = 14;           /**< Number of bits in CodecLZ hash table index.*/
+
+   /** Container for registered codecs. Built-in codecs are registered when
+    * the container is first accessed. The codecs are deleted at program exit.*/
+   struct CodecRegistry {
+      map<string,Codec*> codecs;
+
+      CodecRegistry() {
+         Codec* lz = new CodecLZ();
+         codecs[lz->getName()] = lz;
+         Codec* none = new CodecNone();
+         codecs[none->getName()] = none;
+      }
+      ~CodecRegistry() {
+         for (map<string,Codec*>::iterator it=codecs.begin(); it!=codecs.end(); ++it) delete it->second;
+      }
+   };
+
+   static CodecRegistry& getCodecRegistry() {
+      static CodecRegistry registry;
+      return registry;
+   }
+
+   Codec::~Codec() { }
+
+   /** Get the codec with the given name.
+    * @param name Name of the codec.
+    * @return Pointer to the codec, or NULL if no codec with the given name has been registered.*/
+   const Codec* getCodec(const std::string& name) {
+      map<string,Codec*>::const_iterator it = getCodecRegistry().codecs.find(name);
+      if (it == getCodecRegistry().codecs.end()) return NULL;
+      return it->second;
+   }
+
+   /** Register a new compression codec. The codec is deleted at program exit.
+    * This function is not thread-safe, codecs should be registered before any
+    * files are written or read.
+    * @param codec Pointer to the codec.
+    * @return If true, the codec was registered. If false, a codec with the same name already exists.*/
+   bool registerCodec(Codec* codec) {
+      if (codec == NULL) return false;
+      CodecRegistry& registry = getCodecRegistry();
+      if (registry.codecs.find(codec->getName()) != registry.codecs.end()) return false;
+      registry.codecs[codec->getName()] = codec;
+      return true;
+   }
+
+   // ***** CODEC NONE ***** //
+
+   bool CodecNone::compress(const char* input,const uint64_t& inputBytes,std::vector<char>& output) const {
+      output.assign(input,input+inputBytes);
+      return true;
+   }
+
+   bool CodecNone::decompress(const char* input,const uint64_t& inputBytes,char* output,const uint64_t& outputBytes) const {
+      if (inputBytes != outputBytes) return false;
+      memcpy(output,input,outputBytes);
+      return true;
+   }
+
+   std::string CodecNone::getName() const {return "none";}
+
+   // ***** CODEC LZ ***** //
+
+   static inline uint32_t lzRead32(const unsigned char* ptr) {
+      uint32_t value;
+      memcpy(&value,ptr,sizeof(uint32_t));
+      return value;
+   }
+
+   static inline uint32_t lzHash(const uint32_t& value) {
+      return (value * 2654435761U) >> (32-LZ_HASH_BITS);
+   }
+
+   static inline void lzWriteLength(vector<char>& output,uint64_t length) {
+      while (length >= 255) {
+         output.push_back(static_cast<char>(255));
+         length -= 255;
+      }
+      output.push_back(static_cast<char>(length));
+   }
+
+   static inline bool lzReadLength(const unsigned char*& ip,const unsigned char* const ipEnd,uint64_t& length) {
+      unsigned char c;
+      do {
+         if (ip == ipEnd) return false;
+         c = *ip;
+         ++ip;
+         length += c;
+      } while (c == 255);
+      return true;
+   }
+
+   /** Write a sequence of literals followed by a match to the output stream.
+    * If matchLength is zero the sequence is the last one and it contains literals only.*/
+   static void lzWriteSequence(vector<char>& output,const unsigned char* literals,const uint64_t& literalLength,
+                               const uint64_t& matchOffset,const uint64_t& matchLength) {
+      const uint64_t matchCode = (matchLength == 0) ? 0 : matchLength-LZ_MIN_MATCH;
+      unsigned char token = 0;
+      token |= (literalLength < 15 ? literalLength : 15) << 4;
+      token |= (matchCode < 15 ? matchCode : 15);
+      output.push_back(static_cast<char>(token));
+      if (literalLength >= 15) lzWriteLength(output,literalLength-15);
+      output.insert(output.end(),literals,literals+literalLength);
+      if (matchLength == 0) return;
+
+      output.push_back(static_cast<char>(matchOffset & 0xFF));
+      output.push_back(static_cast<char>((matchOffset >> 8) & 0xFF));
+      if (matchCode >= 15) lzWriteLength(output,matchCode-15);
+   }
+
+   bool CodecLZ::compress(const char* input,const uint64_t& inputBytes,std::vector<char>& output) const {
+      output.clear();
+      output.reserve(inputBytes + inputBytes/255 + 16);
+      const unsigned char* in = reinterpret_cast<const unsigned char*>(input);
+
+      vector<int64_t> hashTable(1 << LZ_HASH_BITS,-1);
+      uint64_t anchor = 0;
+      uint64_t i = 0;
+      while (i + LZ_MIN_MATCH <= inputBytes) {
+         const uint32_t sequence = lzRead32(in+i);
+         const uint32_t h = lzHash(sequence);
+         const int64_t candidate = hashTable[h];
+         hashTable[h] = i;
+
+         if (candidate < 0 || i-candidate > LZ_MAX_OFFSET || lzRead32(in+candidate) != sequence) {
+            ++i;
+            continue;
+         }
+
+         // Extend the match as far as possible:
+         uint64_t matchLength = LZ_MIN_MATCH;
+         while (i+matchLength < inputBytes && in[candidate+matchLength] == in[i+matchLength]) ++matchLength;
+
+         lzWriteSequence(output,in+anchor,i-anchor,i-candidate,matchLength);
+         i += matchLength;
+         anchor = i;
+      }
+
+      // Write remaining bytes as literals:
+      lzWriteSequence(output,in+anchor,inputBytes-anchor,0,0);
+      return true;
+   }
+
+   bool CodecLZ::decompress(const char* input,const uint64_t& inputBytes,char* output,const uint64_t& outputBytes) const {
+      const unsigned char* ip = reinterpret_cast<const unsigned char*>(input);
+      const unsigned char* const ipEnd = ip + inputBytes;
+      unsigned char* op = reinterpret_cast<unsigned char*>(output);
+      unsigned char* const opStart = op;
+      unsigned char* const opEnd = op + outputBytes;
+
+      while (ip < ipEnd) {
+         const unsigned char token = *ip;
+         ++ip;
+
+         // Copy literals:
+         uint64_t literalLength = token >> 4;
+         if (literalLength == 15 && lzReadLength(ip,ipEnd,literalLength) == false) return false;
+         if (literalLength > static_cast<uint64_t>(ipEnd-ip)) return false;
+         if (literalLength > static_cast<uint64_t>(opEnd-op)) return false;
+         memcpy(op,ip,literalLength);
+         ip += literalLength;
+         op += literalLength;
+
+         // Last sequence has no match:
+         if (ip == ipEnd) break;
+
+         // Copy match, source and destination may overlap:
+         if (ipEnd-ip < 2) return false;
+         const uint64_t matchOffset = ip[0] | (static_cast<uint64_t>(ip[1]) << 8);
+         ip += 2;
+         uint64_t matchLength = token & 15;
+         if (matchLength == 15 && lzReadLength(ip,ipEnd,matchLength) == false) return false;
+         matchLength += LZ_MIN_MATCH;
+         if (matchOffset == 0 || matchOffset > static_cast<uint64_t>(op-opStart)) return false;
+         if (matchLength > static_cast<uint64_t>(opEnd-op)) return false;
+         const unsigned char* match = op - matchOffset;
+         for (uint64_t j=0; j<matchLength; ++j) op[j] = match[j];
+         op += matchLength;
+      }
+      return op == opEnd;
+   }
+
+   std::string CodecLZ::getName() const {return "lz";}
+
+   // ***** SHUFFLE FILTER ***** //
+
+   /** Copy even bytes of input to array even and odd bytes to array odd.
+    * @param input Input bytes.
+    * @param even Output array for bytes 0,2,4,...
+    * @param odd Output array for bytes 1,3,5,...
+    * @param pairs Number of byte pairs in input.*/
+   static void deinterleave(const unsigned char* input,unsigned char* even,unsigned char* odd,const uint64_t& pairs) {
+      uint64_t i = 0;
+      #if defined(__AVX2__)
+      const __m256i mask = _mm256_set1_epi16(0x00FF);
+      for (; i+32<=pairs; i+=32) {
+         const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input+2*i));
+         const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input+2*i+32));
+         // Packing works within 128bit lanes, permute restores the element order:
+         const __m256i e = _mm256_packus_epi16(_mm256_and_si256(a,mask),_mm256_and_si256(b,mask));
+         const __m256i o = _mm256_packus_epi16(_mm256_srli_epi16(a,8),_mm256_srli_epi16(b,8));
+         _mm256_storeu_si256(reinterpret_cast<__m256i*>(even+i),_mm256_permute4x64_epi64(e,0xD8));
+         _mm256_storeu_si256(reinterpret_cast<__m256i*>(odd+i),_mm256_permute4x64_epi64(o,0xD8));
+      }
+      #elif defined(__SSE2__)
+      const __m128i mask = _mm_set1_epi16(0x00FF);
+      for (; i+16<=pairs; i+=16) {
+         const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input+2*i));
+         const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input+2*i+16));
+         _mm_storeu_si128(reinterpret_cast<__m128i*>(even+i),_mm_packus_epi16(_mm_and_si128(a,mask),_mm_and_si128(b,mask)));
+         _mm_storeu_si128(reinterpret_cast<__m128i*>(odd+i),_mm_packus_epi16(_mm_srli_epi16(a,8),_mm_srli_epi16(b,8)));
+      }
+      #endif
+      for (; i<pairs; ++i) {
+         even[i] = input[2*i];
+         odd[i]  = input[2*i+1];
+      }
+   }
+
+   /** Inverse of deinterleave, bytes of arrays even and odd are interleaved to output.
+    * @param even Bytes copied to even output positions.
+    * @param odd Bytes copied to odd output positions.
+    * @param output Output array.
+    * @param pairs Number of bytes in arrays even and odd.*/
+   static void interleave(const unsigned char* even,const unsigned char* odd,unsigned char* output,const uint64_t& pairs) {
+      uint64_t i = 0;
+      #if defined(__AVX2__)
+      for (; i+32<=pairs; i+=32) {
+         const __m256i e = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(even+i));
+         const __m256i o = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(odd+i));
+         const __m256i lo = _mm256_unpacklo_epi8(e,o);
+         const __m256i hi = _mm256_unpackhi_epi8(e,o);
+         _mm256_storeu_si256(reinterpret_cast<__m256i*>(output+2*i),_mm256_permute2x128_si256(lo,hi,0x20));
+         _mm256_storeu_si256(reinterpret_cast<__m256i*>(output+2*i+32),_mm256_permute2x128_si256(lo,hi,0x31));
+      }
+      #elif defined(__SSE2__)
+      for (; i+16<=pairs; i+=16) {
+         const __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(even+i));
+         const __m128i o = _mm_loadu_si128(reinterpret_cast<const __m128i*>(odd+i));
+         _mm_storeu_si128(reinterpret_cast<__m128i*>(output+2*i),_mm_unpacklo_epi8(e,o));
+         _mm_storeu_si128(reinterpret_cast<__m128i*>(output+2*i+16),_mm_unpackhi_epi8(e,o));
+      }
+      #endif
+      for (; i<pairs; ++i) {
+         output[2*i]   = even[i];
+         output[2*i+1] = odd[i];
+      }
+   }
+
+   /** Shuffle bytes of the given values by significance. The output contains the first 
+    * byte of every value, followed by the second byte of every value, and so on. 
+    * Similar bytes are then next to each other, which makes floating point and integer 
+    * arrays considerably more compressible. Power-of-two type sizes are shuffled with 
+    * repeated SIMD byte deinterleaving, other sizes with a scalar loop.
+    * @param input Values that are shuffled.
+    * @param output Output buffer, must not overlap with input.
+    * @param elements Number of values.
+    * @param typeSize Byte size of each value.*/
+   void shuffle(const char* input,char* output,const uint64_t& elements,const uint64_t& typeSize) {
+      const unsigned char* in = reinterpret_cast<const unsigned char*>(input);
+      unsigned char* out = reinterpret_cast<unsigned char*>(output);
+      if (typeSize <= 1) {
+         memcpy(out,in,elements*typeSize);
+         return;
+      }
+      if ((typeSize & (typeSize-1)) != 0) {
+         for (uint64_t i=0; i<elements; ++i) {
+            for (uint64_t b=0; b<typeSize; ++b) out[b*elements+i] = in[i*typeSize+b];
+         }
+         return;
+      }
+
+      // Each pass splits every byte stream into its even and odd bytes, which are written 
+      // to the first and second half of the output. After log2(typeSize) passes the 
+      // streams are the byte planes in order of significance. Passes alternate between 
+      // output and a temporary buffer so that the last pass writes to output:
+      const uint64_t totalBytes = elements*typeSize;
+      uint64_t passes = 0;
+      for (uint64_t size=typeSize; size>1; size/=2) ++passes;
+      vector<unsigned char> tmp(totalBytes);
+      const unsigned char* src = in;
+      unsigned char* dst = (passes % 2 == 1) ? out : tmp.data();
+      for (uint64_t streams=1; streams<typeSize; streams*=2) {
+         const uint64_t half = totalBytes/streams/2;
+         for (uint64_t s=0; s<streams; ++s) {
+            deinterleave(src+2*s*half,dst+s*half,dst+(streams+s)*half,half);
+         }
+         src = dst;
+         dst = (dst == out) ? tmp.data() : out;
+      }
+   }
+
+   /** Inverse of vlsv::shuffle, restores the original byte order of the values.
+    * @param input Shuffled values.
+    * @param output Output buffer, must not overlap with input.
+    * @param elements Number of values.
+    * @param typeSize Byte size of each value.*/
+   void unshuffle(const char* input,char* output,const uint64_t& elements,const uint64_t& typeSize) {
+      const unsigned char* in = reinterpret_cast<const unsigned char*>(input);
+      unsigned char* out = reinterpret_cast<unsigned char*>(output);
+      if (typeSize <= 1) {
+         memcpy(out,in,elements*typeSize);
+         return;
+      }
+      if ((typeSize & (typeSize-1)) != 0) {
+         for (uint64_t i=0; i<elements; ++i) {
+            for (uint64_t b=0; b<typeSize; ++b) out[i*typeSize+b] = in[b*elements+i];
+         }
+         return;
+      }
+
+      const uint64_t totalBytes = elements*typeSize;
+      uint64_t passes = 0;
+      for (uint64_t size=typeSize; size>1; size/=2) ++passes;
+      vector<unsigned char> tmp(totalBytes);
+      const unsigned char* src = in;
+      unsigned char* dst = (passes % 2 == 1) ? out : tmp.data();
+      for (uint64_t streams=typeSize/2; streams>=1; streams/=2) {
+         const uint64_t half = totalBytes/streams/2;
+         for (uint64_t s=0; s<streams; ++s) {
+            interleave(src+s*half,src+(streams+s)*half,dst+2*s*half,half);
+         }
+         src = dst;
+         dst = (dst == out) ? tmp.data() : out;
+      }
+   }
+
+} // namespace vlsv
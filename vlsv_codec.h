@@ -0,0 +1,99 @@
+/** This file is part of VLSV file format.
+ *
+ *  Copyright 2011-2016 Finnish Meteorological Institute
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VLSV_CODEC_H
+#define VLSV_CODEC_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace vlsv {
+
+   /** Compressed arrays are split into chunks that are compressed independently.
+    * The XML tag of a compressed array has attributes 'codec' (name of the codec),
+    * 'chunks' (number of chunks), 'chunktable' (file offset of the chunk table), and 
+    * 'chunksize' (number of array elements in every chunk except the last one).
+    * The chunk table contains an entry for each chunk in the order the chunks
+    * appear in the array. Each entry consists of three 64bit unsigned integers
+    * stored in file endianness. If the tag has attribute filter="shuffle", bytes 
+    * of each chunk were shuffled by significance before compression, see vlsv::shuffle.
+    * @brief Definition of elements in a chunk table entry.*/
+   namespace chunktable {
+      enum elements {
+         OFFSET,       /**< Offset of the compressed chunk relative to file start.*/
+         BYTES,        /**< Byte size of the compressed chunk.*/
+         ELEMENTS,     /**< Number of array elements in the chunk.*/
+         SIZE          /**< Number of values in each chunk table entry.*/
+      };
+   }
+
+   /** Base class for compression codecs. Codecs must be stateless, i.e.,
+    * compress and decompress may be called simultaneously from several threads.*/
+   class Codec {
+    public:
+      virtual ~Codec();
+
+      /** Compress the given data.
+       * @param input Pointer to data that is compressed.
+       * @param inputBytes Byte size of the data.
+       * @param output Vector in which the compressed data is written. Existing contents are replaced.
+       * @return If true, data was compressed successfully.*/
+      virtual bool compress(const char* input,const uint64_t& inputBytes,std::vector<char>& output) const = 0;
+
+      /** Decompress the given data.
+       * @param input Pointer to compressed data.
+       * @param inputBytes Byte size of the compressed data.
+       * @param output Buffer in which decompressed data is written.
+       * @param outputBytes Byte size of the decompressed data.
+       * @return If true, data was decompressed successfully and exactly outputBytes bytes were written.*/
+      virtual bool decompress(const char* input,const uint64_t& inputBytes,char* output,const uint64_t& outputBytes) const = 0;
+
+      /** Get the name of this codec. The name is written to attribute 'codec' in the
+       * XML tag of compressed arrays and it is used to find the codec when reading the array.
+       * @return Name of the codec.*/
+      virtual std::string getName() const = 0;
+   };
+
+   /** Codec that stores chunks without compression. Used to write arrays in 
+    * chunked layout, for example to read parts of them with a single seek.*/
+   class CodecNone: public Codec {
+    public:
+      bool compress(const char* input,const uint64_t& inputBytes,std::vector<char>& output) const;
+      bool decompress(const char* input,const uint64_t& inputBytes,char* output,const uint64_t& outputBytes) const;
+      std::string getName() const;
+   };
+
+   /** Dependency-free LZ77 codec. Repeated byte sequences within 64 kB window are
+    * replaced by references to earlier data. The stream consists of sequences of
+    * a token byte, literal bytes, and a two byte match offset, similar to LZ4 block format.*/
+   class CodecLZ: public Codec {
+    public:
+      bool compress(const char* input,const uint64_t& inputBytes,std::vector<char>& output) const;
+      bool decompress(const char* input,const uint64_t& inputBytes,char* output,const uint64_t& outputBytes) const;
+      std::string getName() const;
+   };
+
+   const Codec* getCodec(const std::string& name);
+   bool registerCodec(Codec* codec);
+   void shuffle(const char* input,char* output,const uint64_t& elements,const uint64_t& typeSize);
+   void unshuffle(const char* input,char* output,const uint64_t& elements,const uint64_t& typeSize);
+
+} // namespace vlsv
+
+#endif
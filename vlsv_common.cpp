@@ -16,9 +16,14 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <sstream>
+#if defined(__SSSE3__) || defined(__AVX2__)
+   #include <immintrin.h>
+#endif
 
 #include "vlsv_common.h"
 
@@ -38,6 +43,82 @@ namespace vlsv {
       return tmp;
    }
    
+   /** Reverse the byte order of an unsigned integer.
+    * @param value Value whose bytes are reversed.
+    * @return Value with reversed byte order.*/
+   static inline uint16_t byteSwap(const uint16_t& value) {
+      return static_cast<uint16_t>((value >> 8) | (value << 8));
+   }
+
+   static inline uint32_t byteSwap(const uint32_t& value) {
+      return ((value & 0x000000FFu) << 24) | ((value & 0x0000FF00u) << 8)
+           | ((value & 0x00FF0000u) >> 8)  | ((value & 0xFF000000u) >> 24);
+   }
+
+   static inline uint64_t byteSwap(const uint64_t& value) {
+      return (static_cast<uint64_t>(byteSwap(static_cast<uint32_t>(value))) << 32)
+           | byteSwap(static_cast<uint32_t>(value >> 32));
+   }
+
+   /** Reverse the byte order of each value in the given buffer in place. Values 
+    * are processed 32 or 16 bytes at a time with a byte shuffle if the library 
+    * was compiled with AVX2 or SSSE3 support, respectively. Remaining values are 
+    * swapped with a scalar loop that compilers recognize as a byte swap.
+    * @tparam T Unsigned integer type whose size equals the byte size of the values.
+    * @param buffer Buffer containing the values, does not need to be aligned.
+    * @param values Number of values in buffer.*/
+   template<typename T> static
+   void swapKernel(char* const buffer,const uint64_t& values) {
+      uint64_t i = 0;
+      #if defined(__SSSE3__) || defined(__AVX2__)
+      char mask[16];
+      for (size_t b=0; b<sizeof(mask); ++b) mask[b] = static_cast<char>((b/sizeof(T))*sizeof(T) + sizeof(T)-1-b%sizeof(T));
+      const __m128i mask128 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask));
+      #ifdef __AVX2__
+      const __m256i mask256 = _mm256_broadcastsi128_si256(mask128);
+      for (; i+32/sizeof(T) <= values; i+=32/sizeof(T)) {
+         __m256i* ptr = reinterpret_cast<__m256i*>(buffer+i*sizeof(T));
+         _mm256_storeu_si256(ptr,_mm256_shuffle_epi8(_mm256_loadu_si256(ptr),mask256));
+      }
+      #endif
+      for (; i+16/sizeof(T) <= values; i+=16/sizeof(T)) {
+         __m128i* ptr = reinterpret_cast<__m128i*>(buffer+i*sizeof(T));
+         _mm_storeu_si128(ptr,_mm_shuffle_epi8(_mm_loadu_si128(ptr),mask128));
+      }
+      #endif
+      for (; i<values; ++i) {
+         T value;
+         memcpy(&value,buffer+i*sizeof(T),sizeof(T));
+         value = byteSwap(value);
+         memcpy(buffer+i*sizeof(T),&value,sizeof(T));
+      }
+   }
+
+   /** Reverse the byte order of each value in the given buffer in place, i.e., 
+    * convert values between little and big endian encodings.
+    * @param buffer Buffer containing the values.
+    * @param values Number of values in buffer.
+    * @param dataSize Byte size of each value.*/
+   void swapByteOrder(char* const buffer,const uint64_t& values,const uint64_t& dataSize) {
+      switch (dataSize) {
+       case 0:
+       case 1:
+         break;
+       case sizeof(uint16_t):
+         swapKernel<uint16_t>(buffer,values);
+         break;
+       case sizeof(uint32_t):
+         swapKernel<uint32_t>(buffer,values);
+         break;
+       case sizeof(uint64_t):
+         swapKernel<uint64_t>(buffer,values);
+         break;
+       default:
+         for (uint64_t i=0; i<values; ++i) std::reverse(buffer+i*dataSize,buffer+(i+1)*dataSize);
+         break;
+      }
+   }
+
    unsigned char detectEndianness() {
       const int number = 1;
       const char* const ptr = reinterpret_cast<const char*>(&number);
@@ -22,8 +22,10 @@
 #define VLSV_COMMON_H
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdint.h>
+#include <type_traits>
 
 namespace vlsv {
 
@@ -61,9 +63,9 @@ namespace vlsv {
     /** Tells whether a datatype stored in a buffer or a file is a signed or unsigned integer, or a floating point number.
     * @brief Datatype description.*/
    namespace datatype {
-      const uint8_t ENDIANNESS_LITTLE = 0;                   /**< Data in a buffer or a file has little endian encoding, only has an effect on integers.
+      const uint8_t ENDIANNESS_LITTLE = 0;                   /**< Data in a buffer or a file has little endian encoding.
                                                               * @brief Little endian encoding.*/
-      const uint8_t ENDIANNESS_BIG    = 1;                   /**< Data in a buffer or a file has big endian encoding, only has an effect on integers.
+      const uint8_t ENDIANNESS_BIG    = 1;                   /**< Data in a buffer or a file has big endian encoding.
                                                               * @brief Big endian encoding.*/
 
       enum type {
@@ -153,6 +155,9 @@ namespace vlsv {
 
    const std::string getErrorString(const vlsv::error::type& errorCode);
    
+   template<typename T> bool convertArray(T* output,const char* const input,const uint64_t& values,
+                                          datatype::type dt,const uint64_t& dataSize,const bool& swapEndianness);
+   template<typename T> bool isStoredAs(const datatype::type& dt,const uint64_t& dataSize);
    template<typename T> T convertFloat(const char* const ptr);
    template<typename T> T convertInteger(const char* const ptr,const bool& swapEndianness=false);
    
@@ -300,6 +305,88 @@ namespace vlsv {
       }
    }
    
+   /** Conversion kernel used by convertArray. Values of type S are converted 
+    * to type T in a tight loop that the compiler can vectorize. If the types 
+    * are identical the data is simply copied.
+    * @tparam T Output datatype.
+    * @tparam S Datatype of the values in input buffer.
+    * @param output Output array.
+    * @param input Input buffer, does not need to be aligned.
+    * @param values Number of values to convert.
+    * @param swapEndianness If true, bytes of each input value are reversed before conversion.*/
+   template<typename T,typename S> inline
+   void convertKernel(T* output,const char* const input,const uint64_t& values,const bool& swapEndianness) {
+      if (swapEndianness == true && sizeof(S) > 1) {
+         for (uint64_t i=0; i<values; ++i) {
+            char tmp[sizeof(S)];
+            for (size_t b=0; b<sizeof(S); ++b) tmp[b] = input[i*sizeof(S)+sizeof(S)-1-b];
+            S value;
+            memcpy(&value,tmp,sizeof(S));
+            output[i] = static_cast<T>(value);
+         }
+         return;
+      }
+      if (std::is_same<T,S>::value == true) {
+         memcpy(output,input,values*sizeof(S));
+         return;
+      }
+      for (uint64_t i=0; i<values; ++i) {
+         S value;
+         memcpy(&value,input+i*sizeof(S),sizeof(S));
+         output[i] = static_cast<T>(value);
+      }
+   }
+
+   /** Convert an array of values stored in the given datatype into datatype T. 
+    * Unlike convertValue, which switches on the datatype for every value, the 
+    * datatype is examined once and the whole array is converted with a single 
+    * conversion kernel, see convertKernel.
+    * @tparam T Basic datatype that the data is converted into.
+    * @param output Output array, must have room for the given number of values.
+    * @param input Buffer containing the values.
+    * @param values Number of values to convert.
+    * @param dt vlsv::datatype of the values in input buffer.
+    * @param dataSize Byte size of each value in input buffer.
+    * @param swapEndianness If true, endianness of integer datatypes is swapped.
+    * @return If true, the values were converted successfully. False is returned 
+    * if the datatype is not supported.*/
+   template<typename T> inline
+   bool convertArray(T* output,const char* const input,const uint64_t& values,
+                     datatype::type dt,const uint64_t& dataSize,const bool& swapEndianness) {
+      switch (dt) {
+         case datatype::UNKNOWN:
+            if (dataSize != sizeof(T)) return false;
+            memcpy(output,input,values*dataSize);
+            return true;
+         case datatype::INT:
+            switch (dataSize) {
+               case sizeof(int8_t):  convertKernel<T,int8_t>(output,input,values,swapEndianness);  return true;
+               case sizeof(int16_t): convertKernel<T,int16_t>(output,input,values,swapEndianness); return true;
+               case sizeof(int32_t): convertKernel<T,int32_t>(output,input,values,swapEndianness); return true;
+               case sizeof(int64_t): convertKernel<T,int64_t>(output,input,values,swapEndianness); return true;
+            }
+            return false;
+         case datatype::UINT:
+            switch (dataSize) {
+               case sizeof(uint8_t):  convertKernel<T,uint8_t>(output,input,values,swapEndianness);  return true;
+               case sizeof(uint16_t): convertKernel<T,uint16_t>(output,input,values,swapEndianness); return true;
+               case sizeof(uint32_t): convertKernel<T,uint32_t>(output,input,values,swapEndianness); return true;
+               case sizeof(uint64_t): convertKernel<T,uint64_t>(output,input,values,swapEndianness); return true;
+            }
+            return false;
+         case datatype::FLOAT:
+            switch (dataSize) {
+               case sizeof(float):  convertKernel<T,float>(output,input,values,false);  return true;
+               case sizeof(double): convertKernel<T,double>(output,input,values,false); return true;
+#ifndef _WINDOWS
+               case sizeof(long double): convertKernel<T,long double>(output,input,values,false); return true;
+#endif
+            }
+            return false;
+      }
+      return false;
+   }
+
    template<typename T> inline std::string getStringDatatype() {return "unknown";}
    template<> inline std::string getStringDatatype<bool>() {return "int";}
    template<> inline std::string getStringDatatype<char>() {return "uint";}
@@ -315,7 +402,21 @@ namespace vlsv {
    template<> inline std::string getStringDatatype<double>() {return "float";}
    template<> inline std::string getStringDatatype<long double>() {return "float";}
 
+   /** Test if values of the given datatype have the same representation as 
+    * values of type T, i.e., they can be used as T without conversion. Endianness 
+    * is not checked here.
+    * @tparam T Basic datatype.
+    * @param dt vlsv::datatype of the values.
+    * @param dataSize Byte size of the values.
+    * @return If true, the values can be used as T without conversion.*/
+   template<typename T> inline
+   bool isStoredAs(const datatype::type& dt,const uint64_t& dataSize) {
+      if (std::is_same<T,bool>::value == true) return false;
+      return getVLSVDatatype(getStringDatatype<T>()) == dt && sizeof(T) == dataSize;
+   }
+
    unsigned char detectEndianness();
+   void swapByteOrder(char* const buffer,const uint64_t& values,const uint64_t& dataSize);
 
    int8_t convInt8(const char* const ptr,const bool& swapEndian=false);
    int16_t convInt16(const char* const ptr,const bool& swapEndian=false);
@@ -20,6 +20,7 @@
 #include <iostream>
 #include <limits>
 #include <cstring>
+#include <vector>
 
 #include "mpiconversion.h"
 #include "vlsv_common.h"
@@ -31,22 +32,127 @@ static const uint64_t MAX_MPI_FILE_IO_BYTES = 2147460000;
 
 namespace vlsv {
 
+   /** Get the number of collective calls that all processes make, when this process 
+    * needs myCalls calls to transfer its data. With large-count MPI I/O data is never 
+    * split, so each process needs at most one call and no reduction is needed.
+    * @param myCalls Number of collective calls needed by this process.
+    * @param comm MPI communicator.
+    * @return Maximum value of myCalls over all processes in communicator comm.*/
+   uint64_t getCollectiveCalls(const uint64_t& myCalls,MPI_Comm comm) {
+      #ifdef VLSV_MPI_LARGE_COUNT
+         return 1;
+      #else
+         uint64_t N_calls;
+         MPI_Allreduce(&myCalls,&N_calls,1,MPI_Type<uint64_t>(),MPI_MAX,comm);
+         return N_calls;
+      #endif
+   }
+
    /** Get maximum number of bytes that can be read from a file using a single collective MPI routine.
-    * This should equal to numeric_limits<MPI_Count>::max() in MPI 3.0+, but in older 
-    * library versions the 'count' parameter is simply an integer.
+    * This equals to numeric_limits<MPI_Count>::max() if the MPI library has large-count 
+    * routines (MPI 4.0+), but in older library versions the 'count' parameter is simply an integer.
     * @return Maximum number of bytes read using a single MPI collective routine.*/
    uint64_t getMaxBytesPerRead() {
-      // For some obscure reason OpenMPI can only write 2147479552 bytes with a single 
-      // collective call. So I'm manually setting the max bytes to bit less than that.
-      return MAX_MPI_FILE_IO_BYTES;
+      #ifdef VLSV_MPI_LARGE_COUNT
+         return numeric_limits<MPI_Count>::max();
+      #else
+         // For some obscure reason OpenMPI can only write 2147479552 bytes with a single 
+         // collective call. So I'm manually setting the max bytes to bit less than that.
+         return MAX_MPI_FILE_IO_BYTES;
+      #endif
    }
    
    /** Get maximum number of bytes that can be written to a file using a single collective MPI routine.
-    * This should equal to numeric_limits<MPI_Count>::max() in MPI 3.0+, but in older 
-    * library versions the 'count' parameter is simply an integer.
+    * This equals to numeric_limits<MPI_Count>::max() if the MPI library has large-count 
+    * routines (MPI 4.0+), but in older library versions the 'count' parameter is simply an integer.
     * @return Maximum number of bytes written using a single MPI collective routine.*/
    uint64_t getMaxBytesPerWrite() {
-      return MAX_MPI_FILE_IO_BYTES;
+      #ifdef VLSV_MPI_LARGE_COUNT
+         return numeric_limits<MPI_Count>::max();
+      #else
+         return MAX_MPI_FILE_IO_BYTES;
+      #endif
+   }
+
+   /** Start a non-blocking collective read, see MPI_File_iread_at_all. Without large-count 
+    * MPI I/O count must not exceed getMaxBytesPerRead() bytes.
+    * @return MPI error code.*/
+   int fileIreadAtAll(MPI_File file,const MPI_Offset& offset,void* buffer,const uint64_t& count,
+                      MPI_Datatype datatype,MPI_Request* request) {
+      #ifdef VLSV_MPI_LARGE_COUNT
+         return MPI_File_iread_at_all_c(file,offset,buffer,count,datatype,request);
+      #else
+         return MPI_File_iread_at_all(file,offset,buffer,count,datatype,request);
+      #endif
+   }
+
+   /** Read data with a collective call, see MPI_File_read_at_all. Without large-count 
+    * MPI I/O count must not exceed getMaxBytesPerRead() bytes.
+    * @return MPI error code.*/
+   int fileReadAtAll(MPI_File file,const MPI_Offset& offset,void* buffer,const uint64_t& count,
+                     MPI_Datatype datatype,MPI_Status* status) {
+      #ifdef VLSV_MPI_LARGE_COUNT
+         return MPI_File_read_at_all_c(file,offset,buffer,count,datatype,status);
+      #else
+         return MPI_File_read_at_all(file,offset,buffer,count,datatype,status);
+      #endif
+   }
+
+   /** Write data with a collective call, see MPI_File_write_at_all. Without large-count 
+    * MPI I/O count must not exceed getMaxBytesPerWrite() bytes.
+    * @return MPI error code.*/
+   int fileWriteAtAll(MPI_File file,const MPI_Offset& offset,const void* buffer,const uint64_t& count,
+                      MPI_Datatype datatype,MPI_Status* status) {
+      #ifdef VLSV_MPI_LARGE_COUNT
+         return MPI_File_write_at_all_c(file,offset,buffer,count,datatype,status);
+      #else
+         return MPI_File_write_at_all(file,offset,buffer,count,datatype,status);
+      #endif
+   }
+
+   /** Get the number of received datatypes, see MPI_Get_count.
+    * @param status Status of a completed read.
+    * @param datatype Datatype used in the read.
+    * @return Number of received datatypes, or MPI_UNDEFINED.*/
+   int64_t getCount(const MPI_Status& status,MPI_Datatype datatype) {
+      #ifdef VLSV_MPI_LARGE_COUNT
+         MPI_Count count;
+         MPI_Get_count_c(&status,datatype,&count);
+      #else
+         int count;
+         MPI_Get_count(&status,datatype,&count);
+      #endif
+      return count;
+   }
+
+   /** Create an hindexed datatype, see MPI_Type_create_hindexed. Without large-count 
+    * MPI I/O block lengths must fit into an int.
+    * @return MPI error code.*/
+   int typeCreateHindexed(const size_t& count,const uint64_t* blockLengths,const MPI_Aint* displacements,
+                          MPI_Datatype oldType,MPI_Datatype* newType) {
+      #ifdef VLSV_MPI_LARGE_COUNT
+         vector<MPI_Count> lengths(blockLengths,blockLengths+count);
+         vector<MPI_Count> offsets(displacements,displacements+count);
+         return MPI_Type_create_hindexed_c(count,lengths.data(),offsets.data(),oldType,newType);
+      #else
+         vector<int> lengths(blockLengths,blockLengths+count);
+         return MPI_Type_create_hindexed(count,lengths.data(),displacements,oldType,newType);
+      #endif
+   }
+
+   /** Create a struct datatype, see MPI_Type_create_struct. Without large-count 
+    * MPI I/O block lengths must fit into an int.
+    * @return MPI error code.*/
+   int typeCreateStruct(const size_t& count,const uint64_t* blockLengths,const MPI_Aint* displacements,
+                        const MPI_Datatype* types,MPI_Datatype* newType) {
+      #ifdef VLSV_MPI_LARGE_COUNT
+         vector<MPI_Count> lengths(blockLengths,blockLengths+count);
+         vector<MPI_Count> offsets(displacements,displacements+count);
+         return MPI_Type_create_struct_c(count,lengths.data(),offsets.data(),types,newType);
+      #else
+         vector<int> lengths(blockLengths,blockLengths+count);
+         return MPI_Type_create_struct(count,lengths.data(),displacements,types,newType);
+      #endif
    }
 
 
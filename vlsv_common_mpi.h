@@ -22,13 +22,33 @@
 #include <mpi.h>
 #include "vlsv_common.h"
 
+// MPI 4.0 added large-count (MPI_Count) versions of file I/O routines and datatype 
+// constructors. With them any amount of data is transferred with a single collective 
+// call, otherwise transfers are split at getMaxBytesPerRead/getMaxBytesPerWrite bytes:
+#if MPI_VERSION >= 4
+   #define VLSV_MPI_LARGE_COUNT
+#endif
+
 namespace vlsv {
+   uint64_t getCollectiveCalls(const uint64_t& myCalls,MPI_Comm comm);
    uint64_t getMaxBytesPerRead();
    uint64_t getMaxBytesPerWrite();
 
    bool broadcast(const std::string& input,std::string& output,MPI_Comm comm,const int& masterRank);
    bool checkSuccess(const bool& myStatus,MPI_Comm comm);
    MPI_Datatype getMPIDatatype(datatype::type dt,uint64_t dataSize);
+
+   int fileIreadAtAll(MPI_File file,const MPI_Offset& offset,void* buffer,const uint64_t& count,
+                      MPI_Datatype datatype,MPI_Request* request);
+   int fileReadAtAll(MPI_File file,const MPI_Offset& offset,void* buffer,const uint64_t& count,
+                     MPI_Datatype datatype,MPI_Status* status);
+   int fileWriteAtAll(MPI_File file,const MPI_Offset& offset,const void* buffer,const uint64_t& count,
+                      MPI_Datatype datatype,MPI_Status* status);
+   int64_t getCount(const MPI_Status& status,MPI_Datatype datatype);
+   int typeCreateHindexed(const size_t& count,const uint64_t* blockLengths,const MPI_Aint* displacements,
+                          MPI_Datatype oldType,MPI_Datatype* newType);
+   int typeCreateStruct(const size_t& count,const uint64_t* blockLengths,const MPI_Aint* displacements,
+                        const MPI_Datatype* types,MPI_Datatype* newType);
 }
 
 #endif
@@ -0,0 +1,235 @@
+/** This file is part of VLSV file format.
+ *
+ *  Copyright 2011-2016 Finnish Meteorological Institute
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+
+#include "vlsv_footer.h"
+
+using namespace std;
+
+namespace vlsv {
+
+   namespace footerindex {
+      const char MAGIC[8] = {'V','L','S','V','B','I','D','X'};
+   }
+
+   static const uint64_t HEADER_VALUES = 4;             /**< Number of 64bit integers in index header.*/
+
+   /** Append raw bytes of the given value to the output buffer.
+    * @param value Value to append.
+    * @param output Output buffer.*/
+   template<typename T> static void append(const T& value,vector<char>& output) {
+      const char* ptr = reinterpret_cast<const char*>(&value);
+      output.insert(output.end(),ptr,ptr+sizeof(T));
+   }
+
+   /** Get the ID of the given string, the string is added to the string table if necessary.
+    * @param s String.
+    * @param stringIDs Map from strings to their IDs.
+    * @param strings String table.
+    * @return ID of the string.*/
+   static uint32_t intern(const string& s,map<string,uint32_t>& stringIDs,vector<const string*>& strings) {
+      map<string,uint32_t>::iterator it = stringIDs.find(s);
+      if (it != stringIDs.end()) return it->second;
+      const uint32_t ID = strings.size();
+      it = stringIDs.insert(make_pair(s,ID)).first;
+      strings.push_back(&(it->first));
+      return ID;
+   }
+
+   /** Parse an unsigned integer that has been written in its shortest decimal
+    * form, i.e., the value can be written back without changing the string.
+    * @param s String to parse.
+    * @param value Variable in which the parsed value is written.
+    * @return If true, the string was parsed successfully.*/
+   static bool parseCanonical(const string& s,uint64_t& value) {
+      if (s.size() == 0 || s.size() > 20) return false;
+      if (s.size() > 1 && s[0] == '0') return false;
+      for (size_t i=0; i<s.size(); ++i) if (s[i] < '0' || s[i] > '9') return false;
+      value = strtoull(s.c_str(),NULL,10);
+      char buffer[32];
+      snprintf(buffer,sizeof(buffer),"%llu",static_cast<unsigned long long>(value));
+      return s == buffer;
+   }
+
+   /** Convert an unsigned integer to its decimal representation.
+    * @param value Value to convert.
+    * @return Value as a string.*/
+   static string toString(const uint64_t& value) {
+      char buffer[32];
+      snprintf(buffer,sizeof(buffer),"%llu",static_cast<unsigned long long>(value));
+      return buffer;
+   }
+
+   /** Rebuild the footer XML tree from a binary footer index.
+    * @param input Pointer to the index, excluding the trailer.
+    * @param inputBytes Byte size of the index, excluding the trailer.
+    * @param xml XML tree in which the footer is written. Existing contents are removed.
+    * @return If true, the index was decoded successfully. If false, contents of xml are undefined.*/
+   bool decodeFooterIndex(const char* input,const uint64_t& inputBytes,muxml::MuXML& xml) {
+      using namespace footerindex;
+      uint64_t header[HEADER_VALUES];
+      if (inputBytes < sizeof(header)) return false;
+      memcpy(header,input,sizeof(header));
+      const uint64_t N_strings    = header[0];
+      const uint64_t N_records    = header[1];
+      const uint64_t N_attributes = header[2];
+      const uint64_t stringBytes  = header[3];
+
+      // Check that the index sizes are consistent:
+      if (stringBytes > inputBytes || N_strings > stringBytes || N_records > inputBytes/sizeof(ArrayRecord)
+          || N_attributes > inputBytes/(2*sizeof(uint32_t))) return false;
+      if (sizeof(header) + stringBytes + N_records*sizeof(ArrayRecord)
+          + N_attributes*2*sizeof(uint32_t) != inputBytes) return false;
+
+      // Read string table:
+      const char* ptr = input + sizeof(header);
+      const char* const stringEnd = ptr + stringBytes;
+      vector<string> strings(N_strings);
+      for (uint64_t i=0; i<N_strings; ++i) {
+         const char* end = reinterpret_cast<const char*>(memchr(ptr,'\0',stringEnd-ptr));
+         if (end == NULL) return false;
+         strings[i].assign(ptr,end);
+         ptr = end+1;
+      }
+      if (ptr != stringEnd) return false;
+
+      const char* const recordPtr = stringEnd;
+      const char* const attributePtr = recordPtr + N_records*sizeof(ArrayRecord);
+
+      // Create a node for each array:
+      xml.clear();
+      muxml::XMLNode* vlsvNode = xml.addNode(xml.getRoot(),"VLSV","");
+      for (uint64_t r=0; r<N_records; ++r) {
+         ArrayRecord record;
+         memcpy(&record,recordPtr+r*sizeof(ArrayRecord),sizeof(ArrayRecord));
+         if (record.tagID >= N_strings) return false;
+         if (record.nameID != NONE && record.nameID >= N_strings) return false;
+         if (record.dataTypeID != NONE && record.dataTypeID >= N_strings) return false;
+         if (record.firstAttribute > N_attributes || record.attributes > N_attributes-record.firstAttribute) return false;
+
+         muxml::XMLNode* node = new muxml::XMLNode(vlsvNode);
+         vlsvNode->children.insert(make_pair(strings[record.tagID],node));
+         node->value = toString(record.offset);
+         if (record.nameID != NONE) node->attributes["name"] = strings[record.nameID];
+         if (record.dataTypeID != NONE) node->attributes["datatype"] = strings[record.dataTypeID];
+         if ((record.flags & ARRAYSIZE) != 0) node->attributes["arraysize"] = toString(record.arraySize);
+         if ((record.flags & VECTORSIZE) != 0) node->attributes["vectorsize"] = toString(record.vectorSize);
+         if ((record.flags & DATASIZE) != 0) node->attributes["datasize"] = toString(record.dataSize);
+
+         for (uint64_t a=record.firstAttribute; a<static_cast<uint64_t>(record.firstAttribute)+record.attributes; ++a) {
+            uint32_t IDs[2];
+            memcpy(IDs,attributePtr+a*sizeof(IDs),sizeof(IDs));
+            if (IDs[0] >= N_strings || IDs[1] >= N_strings) return false;
+            node->attributes[strings[IDs[0]]] = strings[IDs[1]];
+         }
+      }
+      return true;
+   }
+
+   /** Create a binary footer index of the given footer XML tree. The index can
+    * only be created if all arrays are direct children of tag VLSV and their
+    * values are array offsets, which is the case for all footers written by vlsv::Writer.
+    * @param xml Footer XML tree.
+    * @param output Buffer in which the index, including the trailer, is appended.
+    * @return If true, the index was created. If false, output was not modified.*/
+   bool encodeFooterIndex(const muxml::MuXML& xml,std::vector<char>& output) {
+      using namespace footerindex;
+      const muxml::XMLNode* vlsvNode = xml.find("VLSV");
+      if (vlsvNode == NULL) return false;
+
+      map<string,uint32_t> stringIDs;
+      vector<const string*> strings;
+      vector<ArrayRecord> records;
+      vector<uint32_t> attributes;
+      records.reserve(vlsvNode->children.size());
+
+      for (multimap<string,muxml::XMLNode*>::const_iterator it=vlsvNode->children.begin(); it!=vlsvNode->children.end(); ++it) {
+         const muxml::XMLNode* node = it->second;
+         if (node->children.size() > 0) return false;
+
+         ArrayRecord record;
+         memset(&record,0,sizeof(ArrayRecord));
+         if (parseCanonical(node->value,record.offset) == false) return false;
+         record.tagID          = intern(it->first,stringIDs,strings);
+         record.nameID         = NONE;
+         record.dataTypeID     = NONE;
+         record.firstAttribute = attributes.size()/2;
+
+         for (map<string,string>::const_iterator a=node->attributes.begin(); a!=node->attributes.end(); ++a) {
+            if (a->first == "name") {
+               record.nameID = intern(a->second,stringIDs,strings);
+            } else if (a->first == "datatype") {
+               record.dataTypeID = intern(a->second,stringIDs,strings);
+            } else if (a->first == "arraysize" && parseCanonical(a->second,record.arraySize) == true) {
+               record.flags |= ARRAYSIZE;
+            } else if (a->first == "vectorsize" && parseCanonical(a->second,record.vectorSize) == true) {
+               record.flags |= VECTORSIZE;
+            } else if (a->first == "datasize" && parseCanonical(a->second,record.dataSize) == true) {
+               record.flags |= DATASIZE;
+            } else {
+               attributes.push_back(intern(a->first,stringIDs,strings));
+               attributes.push_back(intern(a->second,stringIDs,strings));
+            }
+         }
+         record.attributes = attributes.size()/2 - record.firstAttribute;
+         records.push_back(record);
+      }
+
+      uint64_t stringBytes = 0;
+      for (size_t i=0; i<strings.size(); ++i) stringBytes += strings[i]->size()+1;
+
+      const size_t start = output.size();
+      append<uint64_t>(strings.size(),output);
+      append<uint64_t>(records.size(),output);
+      append<uint64_t>(attributes.size()/2,output);
+      append<uint64_t>(stringBytes,output);
+      for (size_t i=0; i<strings.size(); ++i) {
+         output.insert(output.end(),strings[i]->begin(),strings[i]->end());
+         output.push_back('\0');
+      }
+      if (records.size() > 0) {
+         const char* ptr = reinterpret_cast<const char*>(&(records[0]));
+         output.insert(output.end(),ptr,ptr+records.size()*sizeof(ArrayRecord));
+      }
+      if (attributes.size() > 0) {
+         const char* ptr = reinterpret_cast<const char*>(&(attributes[0]));
+         output.insert(output.end(),ptr,ptr+attributes.size()*sizeof(uint32_t));
+      }
+
+      // Append trailer:
+      append<uint64_t>(output.size()-start,output);
+      output.insert(output.end(),MAGIC,MAGIC+sizeof(MAGIC));
+      return true;
+   }
+
+   /** Check if the given bytes are a binary footer index trailer.
+    * @param trailer Pointer to footerindex::TRAILER_BYTES bytes preceding the XML footer.
+    * @param indexBytes Variable in which the byte size of the index, excluding the trailer, is written.
+    * @return If true, the bytes are an index trailer.*/
+   bool getFooterIndexSize(const char* trailer,uint64_t& indexBytes) {
+      if (memcmp(trailer+sizeof(uint64_t),footerindex::MAGIC,sizeof(footerindex::MAGIC)) != 0) return false;
+      memcpy(&indexBytes,trailer,sizeof(uint64_t));
+      return true;
+   }
+
+} // namespace vlsv
@@ -0,0 +1,79 @@
+/** This file is part of VLSV file format.
+ *
+ *  Copyright 2011-2016 Finnish Meteorological Institute
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VLSV_FOOTER_H
+#define VLSV_FOOTER_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "muxml.h"
+
+namespace vlsv {
+
+   /** A binary footer index is an optional copy of the XML footer that can be
+    * loaded without parsing. It is written immediately before the XML footer,
+    * so tools that only understand the XML footer are not affected by it.
+    * The index is stored in the endianness of the file and consists of:
+    *
+    * - A header of four 64bit unsigned integers: number of strings, number of
+    *   array records, number of attribute records, and byte size of the string table.
+    * - String table. All strings are stored once, each terminated by a null character.
+    * - Array records, see footerindex::ArrayRecord.
+    * - Attribute records, each consisting of two 32bit string IDs (name, value).
+    * - Trailer of 16 bytes: byte size of the index excluding the trailer as a
+    *   64bit unsigned integer, followed by the eight characters in footerindex::MAGIC.
+    *
+    * A reader detects the index by checking the 16 bytes preceding the XML footer.
+    * @brief Definitions of the binary footer index.*/
+   namespace footerindex {
+      const uint32_t NONE = 0xFFFFFFFF;                 /**< String ID of a missing string.*/
+      const uint64_t TRAILER_BYTES = 16;                /**< Byte size of the index trailer.*/
+      extern const char MAGIC[8];                       /**< Characters identifying the index trailer.*/
+
+      /** Flags telling which numeric fields of an array record are valid. Fields
+       * that are not valid are stored as ordinary attributes instead. Field offset 
+       * is always valid, footers with tag values that are not offsets are not indexed.*/
+      enum flags {
+         ARRAYSIZE  = 1,                                /**< Field arraySize contains attribute 'arraysize'.*/
+         VECTORSIZE = 2,                                /**< Field vectorSize contains attribute 'vectorsize'.*/
+         DATASIZE   = 4                                 /**< Field dataSize contains attribute 'datasize'.*/
+      };
+
+      /** Fixed-size record describing one array in the footer.*/
+      struct ArrayRecord {
+         uint64_t offset;                               /**< Offset of the array in the file, i.e., the value of the XML tag.*/
+         uint64_t arraySize;                            /**< Number of array elements.*/
+         uint64_t vectorSize;                           /**< Size of the data vector in each array element.*/
+         uint64_t dataSize;                             /**< Byte size of vector element.*/
+         uint32_t tagID;                                /**< String ID of the XML tag name.*/
+         uint32_t nameID;                               /**< String ID of attribute 'name', or NONE.*/
+         uint32_t dataTypeID;                           /**< String ID of attribute 'datatype', or NONE.*/
+         uint32_t flags;                                /**< Valid numeric fields, see footerindex::flags.*/
+         uint32_t firstAttribute;                       /**< Index of the first attribute record of the array.*/
+         uint32_t attributes;                           /**< Number of attribute records of the array.*/
+      };
+   }
+
+   bool decodeFooterIndex(const char* input,const uint64_t& inputBytes,muxml::MuXML& xml);
+   bool encodeFooterIndex(const muxml::MuXML& xml,std::vector<char>& output);
+   bool getFooterIndexSize(const char* trailer,uint64_t& indexBytes);
+
+} // namespace vlsv
+
+#endif
@@ -20,31 +20,369 @@
 #include <cstdlib>
 #include <iostream>
 #include <string.h>
+#include <sstream>
+#include <algorithm>
 
 #include "portable_file_io.h"
+#include "vlsv_block_cache.h"
+#include "vlsv_footer.h"
 #include "vlsv_reader.h"
 
 using namespace std;
 
 namespace vlsv {
 
+   /** Smallest gap in bytes between the requested components of consecutive array elements 
+    * for which Reader::readArray reads each element's components with a separate request.*/
+   static const uint64_t COMPONENT_GAP_BYTES = 4096;
+
+   /** Parse a comma-separated list of unsigned integers.
+    * @param input String containing the list.
+    * @param output Vector in which the values are written.*/
+   static void parseList(const std::string& input,std::vector<uint64_t>& output) {
+      output.clear();
+      stringstream ss(input);
+      string value;
+      while (getline(ss,value,',')) output.push_back(strtoull(value.c_str(),NULL,10));
+   }
+
+   /** Create a key for the array lookup index.
+    * @param tagName Name of the XML tag.
+    * @param name Value of attribute 'name'.
+    * @param mesh Value of attribute 'mesh', only used if withMesh is true.
+    * @param withMesh If true, the key includes attribute 'mesh'.
+    * @return Key.*/
+   static string arrayKey(const string& tagName,const string& name,const string& mesh,const bool& withMesh) {
+      string key = tagName;
+      key += '\0';
+      key += name;
+      if (withMesh == true) {
+         key += '\0';
+         key += mesh;
+      }
+      return key;
+   }
+
    Reader::Reader() {
+      arrayIndexValid = false;
+      concurrentReads = false;
       endiannessReader = detectEndianness();
+      fileDescriptor = -1;
       fileOpen = false;
+      mappedBytes = 0;
+      mappedData = NULL;
+      maxRangeGap = 1024*1024;
+      memoryMapping = false;
       swapIntEndianness = false;
    }
 
    Reader::~Reader() {
       filein.close();   
+      fileio::closeFile(fileDescriptor);
+      closeSubfiles();
+      fileio::unmapFile(mappedData,mappedBytes);
+   }
+
+   /** Give the operating system a hint about how the data of the given array is 
+    * going to be accessed, for example, fileio::advice::WILLNEED starts reading 
+    * the array in the background. Hints are only given if the file has been 
+    * memory-mapped, see setMemoryMapping.
+    * @param tagName Name of the XML tag.
+    * @param attribs Attributes that uniquely determine the array.
+    * @param hint Access pattern hint.
+    * @return If true, the hint was given successfully.*/
+   bool Reader::adviseArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                            const fileio::advice::type& hint) {
+      if (mappedData == NULL) return false;
+      if (loadArray(tagName,attribs) == false) return false;
+
+      // Compressed arrays are followed by their chunk tables:
+      uint64_t end = arrayOpen.offset + arrayOpen.arraySize*arrayOpen.vectorSize*arrayOpen.dataSize;
+      if (arrayOpen.codec.size() > 0) end = arrayOpen.chunkTableOffset + arrayOpen.chunks*chunktable::SIZE*sizeof(uint64_t);
+      if (arrayOpen.subfiles > 1) return false;
+      if (end > mappedBytes || static_cast<uint64_t>(arrayOpen.offset) > end) return false;
+      return fileio::adviseMapping(mappedData+arrayOpen.offset,end-arrayOpen.offset,hint);
    }
    
+   /** Build the array lookup index from the footer. Arrays are indexed by their 
+    * tag name and attributes 'name' and 'mesh', and the metadata of each array 
+    * is parsed once here. If the footer contains nested tags, lookups fall back 
+    * to searching the XML tree.*/
+   void Reader::buildArrayIndex() {
+      arrayIndex.clear();
+      arraysByName.clear();
+      arraysByMesh.clear();
+      arrayIndexValid = false;
+
+      // The index gives the same result as muxml::MuXML::find only if all 
+      // arrays are children of tag VLSV, which is the only child of root:
+      muxml::XMLNode* root = xmlReader.getRoot();
+      if (root->children.size() != 1 || root->children.begin()->first != "VLSV") return;
+      muxml::XMLNode* vlsvNode = root->children.begin()->second;
+      for (multimap<string,muxml::XMLNode*>::const_iterator it=vlsvNode->children.begin(); it!=vlsvNode->children.end(); ++it) {
+         if (it->second->children.size() > 0) return;
+      }
+
+      arrayIndex.resize(vlsvNode->children.size());
+      size_t index = 0;
+      for (multimap<string,muxml::XMLNode*>::const_iterator it=vlsvNode->children.begin(); it!=vlsvNode->children.end(); ++it) {
+         ArrayIndexEntry& entry = arrayIndex[index];
+         entry.node = it->second;
+         entry.valid = parseArrayInfo(it->second,entry.info);
+         entry.info.tagName = it->first;
+
+         map<string,string>::const_iterator name = it->second->attributes.find("name");
+         map<string,string>::const_iterator mesh = it->second->attributes.find("mesh");
+         if (name != it->second->attributes.end()) {
+            arraysByName[arrayKey(it->first,name->second,"",false)].push_back(index);
+            if (mesh != it->second->attributes.end()) {
+               arraysByMesh[arrayKey(it->first,name->second,mesh->second,true)].push_back(index);
+            }
+         }
+         ++index;
+      }
+      arrayIndexValid = true;
+   }
+
+   /** Build a sorted index of the global IDs of the real cells of the given mesh. 
+    * Global IDs are read from the MESH array. If the mesh has array MESH_DOMAIN_SIZES, 
+    * ghost cells stored after the real cells of each domain are skipped, and 
+    * positions are counted over real cells only, as in variable arrays.
+    * @param meshName Name of the mesh.
+    * @param index Index in which the cell IDs and positions are written.
+    * @return If true, the index was built successfully.*/
+   bool Reader::buildCellIndex(const std::string& meshName,CellIndex& index) {
+      list<pair<string,string> > attribs;
+      attribs.push_back(make_pair("name",meshName));
+      uint64_t N_cells,vectorSize,dataSize;
+      datatype::type dataType;
+      if (Reader::getArrayInfo("MESH",attribs,N_cells,vectorSize,dataType,dataSize) == false) return false;
+      uint64_t* cellIDs = NULL;
+      if (Reader::read("MESH",attribs,0,N_cells,cellIDs) == false) {
+         cerr << "vlsv::Reader ERROR: " << "Failed to read MESH '" + meshName + "'" << endl;
+         return false;
+      }
+
+      // Read domain sizes, if the mesh has them. Otherwise all cells are real:
+      vector<uint64_t> domainSizes;
+      attribs.clear();
+      attribs.push_back(make_pair("mesh",meshName));
+      uint64_t N_domains;
+      if (Reader::getArrayInfo("MESH_DOMAIN_SIZES",attribs,N_domains,vectorSize,dataType,dataSize) == true) {
+         uint64_t* buffer = NULL;
+         if (vectorSize < 2 || Reader::read("MESH_DOMAIN_SIZES",attribs,0,N_domains,buffer) == false) {
+            cerr << "vlsv::Reader ERROR: " << "Failed to read MESH_DOMAIN_SIZES of mesh '" + meshName + "'" << endl;
+            delete [] cellIDs;
+            return false;
+         }
+         for (uint64_t d=0; d<N_domains; ++d) {
+            domainSizes.push_back(buffer[d*vectorSize+ucdgenericmulti::domainsizes::TOTAL_BLOCKS]);
+            domainSizes.push_back(buffer[d*vectorSize+ucdgenericmulti::domainsizes::GHOST_BLOCKS]);
+         }
+         delete [] buffer;
+      } else {
+         domainSizes.push_back(N_cells);
+         domainSizes.push_back(0);
+      }
+
+      vector<pair<uint64_t,uint64_t> > cells;
+      cells.reserve(N_cells);
+      uint64_t meshOffset = 0;
+      for (size_t d=0; d<domainSizes.size(); d+=2) {
+         const uint64_t N_total = domainSizes[d];
+         const uint64_t N_ghosts = domainSizes[d+1];
+         if (N_ghosts > N_total || meshOffset+N_total > N_cells) break;
+         for (uint64_t i=0; i<N_total-N_ghosts; ++i) {
+            cells.push_back(make_pair(cellIDs[meshOffset+i],static_cast<uint64_t>(cells.size())));
+         }
+         meshOffset += N_total;
+      }
+      delete [] cellIDs;
+      if (meshOffset != N_cells) {
+         cerr << "vlsv::Reader ERROR: " << "Domain sizes of mesh '" + meshName + "' do not match the size of MESH" << endl;
+         return false;
+      }
+
+      sort(cells.begin(),cells.end());
+      index.cellIDs.resize(cells.size());
+      index.positions.resize(cells.size());
+      for (size_t i=0; i<cells.size(); ++i) {
+         index.cellIDs[i] = cells[i].first;
+         index.positions[i] = cells[i].second;
+      }
+      return true;
+   }
+
    bool Reader::close() {
       filein.close();
+      fileio::closeFile(fileDescriptor);
+      fileDescriptor = -1;
+      fileIdentity.clear();
+      fileio::unmapFile(mappedData,mappedBytes);
+      mappedData = NULL;
+      mappedBytes = 0;
       xmlReader.clear();
+      arrayIndex.clear();
+      arraysByName.clear();
+      arraysByMesh.clear();
+      arrayIndexValid = false;
+      chunkTables.clear();
+      cellIndices.clear();
+      closeSubfiles();
       fileOpen = false;
+      swapIntEndianness = false;
+      return true;
+   }
+
+   /** Close all subfiles that have been opened.*/
+   void Reader::closeSubfiles() {
+      for (map<uint64_t,fstream*>::iterator it=subfileStreams.begin(); it!=subfileStreams.end(); ++it) {
+         it->second->close();
+         delete it->second;
+      }
+      subfileStreams.clear();
+      for (map<uint64_t,int>::iterator it=subfileDescriptors.begin(); it!=subfileDescriptors.end(); ++it) {
+         fileio::closeFile(it->second);
+      }
+      subfileDescriptors.clear();
+   }
+
+   /** Decompress the requested elements of a compressed array.
+    * @param info Metadata of the array.
+    * @param table Chunk table of the array.
+    * @param begin Index of the first requested array element.
+    * @param amount Number of requested array elements, must be larger than zero.
+    * @param span Compressed data of all chunks that contain requested elements, 
+    * starting from the first such chunk.
+    * @param buffer Buffer in which the requested elements are written.
+    * @return If true, all chunks were decompressed successfully.*/
+   bool Reader::decodeChunks(const ArrayOpen& info,const ChunkTable& table,const uint64_t& begin,const uint64_t& amount,
+                             const char* span,char* buffer) const {
+      const Codec* codec = getCodec(info.codec);
+      if (codec == NULL) {
+         cerr << "vlsv::Reader ERROR: Unknown codec '" << info.codec << "'" << endl;
+         return false;
+      }
+      const bool shuffled = (info.filter == "shuffle");
+      if (info.filter.size() > 0 && shuffled == false) {
+         cerr << "vlsv::Reader ERROR: Unknown filter '" << info.filter << "'" << endl;
+         return false;
+      }
+
+      uint64_t firstChunk,lastChunk;
+      getChunkRange(table,begin,amount,firstChunk,lastChunk);
+      const uint64_t elementBytes = info.vectorSize*info.dataSize;
+      const uint64_t spanStart = table.entries[firstChunk*chunktable::SIZE+chunktable::OFFSET];
+
+      vector<char> chunkBuffer;
+      vector<char> shuffleBuffer;
+      for (uint64_t c=firstChunk; c<=lastChunk; ++c) {
+         const uint64_t* entry = &(table.entries[c*chunktable::SIZE]);
+         const uint64_t chunkBegin = table.firstElement[c];
+         const uint64_t chunkEnd   = table.firstElement[c+1];
+         const uint64_t copyBegin  = max(begin,chunkBegin);
+         const uint64_t copyEnd    = min(begin+amount,chunkEnd);
+         const char* input = span + (entry[chunktable::OFFSET]-spanStart);
+         char* output = buffer + (copyBegin-begin)*elementBytes;
+
+         // Chunks that are completely inside the requested range are decompressed 
+         // directly into output buffer, other chunks via a temporary buffer. 
+         // Shuffled chunks are unshuffled after decompression:
+         const uint64_t chunkBytes = (chunkEnd-chunkBegin)*elementBytes;
+         const bool wholeChunk = (copyBegin == chunkBegin && copyEnd == chunkEnd);
+         bool success;
+         if (wholeChunk == true && shuffled == false) {
+            success = codec->decompress(input,entry[chunktable::BYTES],output,chunkBytes);
+         } else {
+            chunkBuffer.resize(chunkBytes);
+            success = codec->decompress(input,entry[chunktable::BYTES],chunkBuffer.data(),chunkBytes);
+            if (success == true && shuffled == true) {
+               char* target = output;
+               if (wholeChunk == false) {
+                  shuffleBuffer.resize(chunkBytes);
+                  target = shuffleBuffer.data();
+               }
+               unshuffle(chunkBuffer.data(),target,(chunkEnd-chunkBegin)*info.vectorSize,info.dataSize);
+               if (wholeChunk == false) chunkBuffer.swap(shuffleBuffer);
+            }
+            if (success == true && wholeChunk == false) {
+               memcpy(output,&(chunkBuffer[(copyBegin-chunkBegin)*elementBytes]),(copyEnd-copyBegin)*elementBytes);
+            }
+         }
+         if (success == false) {
+            cerr << "vlsv::Reader ERROR: Failed to decompress chunk " << c << " of array '" << info.tagName << "'" << endl;
+            return false;
+         }
+      }
       return true;
    }
 
+   /** Get a pointer to the given elements of an array in the memory-mapped 
+    * file. This is only possible if the array data is stored in the input 
+    * file uncompressed and in native endianness.
+    * @param info Metadata of the array.
+    * @param begin Index of the first array element.
+    * @param amount Number of array elements.
+    * @return Pointer to the data, or NULL if the data can not be accessed directly.*/
+   const char* Reader::getMappedArray(const ArrayOpen& info,const uint64_t& begin,const uint64_t& amount) const {
+      if (mappedData == NULL) return NULL;
+      if (info.codec.size() > 0 || info.subfiles > 1) return NULL;
+      if (swapIntEndianness == true) return NULL;
+
+      const uint64_t start = info.offset + begin*info.vectorSize*info.dataSize;
+      const uint64_t bytes = amount*info.vectorSize*info.dataSize;
+      if (start > mappedBytes || bytes > mappedBytes-start) return NULL;
+      return mappedData + start;
+   }
+
+   /** Find the array matching the given tag name and attributes. Arrays whose 
+    * attributes include 'name' are found from the array lookup index, other 
+    * searches are done on the XML tree. In both cases the first array in the 
+    * order of muxml::MuXML::find is returned.
+    * @param tagName Name of the XML tag.
+    * @param attribs Attributes that the XML tag must have.
+    * @param info Variable in which the metadata of the array is written.
+    * @param infoValid Variable in which true is written if the XML tag contained valid array metadata.
+    * @return Pointer to the XML tag of the array, or NULL if no array matched.*/
+   muxml::XMLNode* Reader::findArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                                     ArrayOpen& info,bool& infoValid) const {
+      const string* name = NULL;
+      const string* mesh = NULL;
+      for (list<pair<string,string> >::const_iterator it=attribs.begin(); it!=attribs.end(); ++it) {
+         if (it->first == "name" && name == NULL) name = &(it->second);
+         else if (it->first == "mesh" && mesh == NULL) mesh = &(it->second);
+      }
+
+      if (arrayIndexValid == false || name == NULL) {
+         muxml::XMLNode* node = xmlReader.find(tagName,attribs);
+         if (node != NULL) infoValid = parseArrayInfo(node,info);
+         return node;
+      }
+
+      const unordered_map<string,vector<size_t> >& arrays = (mesh == NULL) ? arraysByName : arraysByMesh;
+      unordered_map<string,vector<size_t> >::const_iterator candidates 
+        = arrays.find(arrayKey(tagName,*name,(mesh == NULL) ? "" : *mesh,mesh != NULL));
+      if (candidates == arrays.end()) return NULL;
+
+      // Check the remaining attributes of each candidate:
+      for (size_t c=0; c<candidates->second.size(); ++c) {
+         const ArrayIndexEntry& entry = arrayIndex[candidates->second[c]];
+         bool matchFound = true;
+         for (list<pair<string,string> >::const_iterator it=attribs.begin(); it!=attribs.end(); ++it) {
+            map<string,string>::const_iterator tmp = entry.node->attributes.find(it->first);
+            if (tmp == entry.node->attributes.end() || tmp->second != it->second) {
+               matchFound = false;
+               break;
+            }
+         }
+         if (matchFound == false) continue;
+         info = entry.info;
+         infoValid = entry.valid;
+         return entry.node;
+      }
+      return NULL;
+   }
+
    /** Get attributes of the given XML tag.
     * @param tagName Name of the XML tag.
     * @param attribsIn Constraints that limit the search.
@@ -52,7 +390,9 @@ namespace vlsv {
     * @return If true, an XML tag was found that mathes given constraints.*/
    bool Reader::getArrayAttributes(const string& tagName,const list<pair<string,string> >& attribsIn,map<string,string>& attribsOut) const {
       if (fileOpen == false) return false;
-      muxml::XMLNode* node = xmlReader.find(tagName,attribsIn);
+      ArrayOpen info;
+      bool infoValid;
+      muxml::XMLNode* node = findArray(tagName,attribsIn,info,infoValid);
       if (node == NULL) return false;
       attribsOut = node->attributes;   
       return true;
@@ -70,23 +410,81 @@ namespace vlsv {
    bool Reader::getArrayInfo(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
                              uint64_t& arraySize,uint64_t& vectorSize,datatype::type& dataType,uint64_t& dataSize) {
       if (fileOpen == false) return false;
-      muxml::XMLNode* node = xmlReader.find(tagName,attribs);
+      ArrayOpen info;
+      bool infoValid;
+      muxml::XMLNode* node = findArray(tagName,attribs,info,infoValid);
       if (node == NULL) return false;
-   
-      arraySize = atol(node->attributes["arraysize"].c_str());
-      vectorSize = atol(node->attributes["vectorsize"].c_str());
-      dataSize = atol(node->attributes["datasize"].c_str());
-      if (node->attributes["datatype"] == "unknown") dataType = datatype::UNKNOWN;
-      else if (node->attributes["datatype"] == "int") dataType = datatype::INT;
-      else if (node->attributes["datatype"] == "uint") dataType = datatype::UINT;
-      else if (node->attributes["datatype"] == "float") dataType = datatype::FLOAT;
-      else {
+      if (infoValid == false) {
          cerr << "vlsv::Reader ERROR: Unknown datatype '" << node->attributes["datatype"] << "' in tag!" << endl;
          return false;
       }
+   
+      arraySize = info.arraySize;
+      vectorSize = info.vectorSize;
+      dataSize = info.dataSize;
+      dataType = info.dataType;
       return true;
    }
 
+   /** Get the positions of the given cells in variable arrays of a mesh. The 
+    * position of a cell is the index of its values in arrays such as "VARIABLE" 
+    * that contain data on the real cells of the mesh. A sorted index of the cell 
+    * IDs of each mesh is built on the first call and reused afterwards.
+    * @param meshName Name of the mesh.
+    * @param cellIDs Global IDs of the cells.
+    * @param positions Vector in which the positions are written, in the order given in cellIDs.
+    * @return If true, all cells were found from the mesh.*/
+   bool Reader::getCellPositions(const std::string& meshName,const std::vector<uint64_t>& cellIDs,std::vector<uint64_t>& positions) {
+      positions.clear();
+      if (fileOpen == false) return false;
+
+      // The index is built without holding cacheMutex, since the mesh may be 
+      // compressed and reading it requires loadChunkTable:
+      const CellIndex* index = NULL;
+      {
+         lock_guard<mutex> lock(cacheMutex);
+         map<string,CellIndex>::const_iterator it = cellIndices.find(meshName);
+         if (it != cellIndices.end()) index = &(it->second);
+      }
+      if (index == NULL) {
+         CellIndex newIndex;
+         if (buildCellIndex(meshName,newIndex) == false) return false;
+         lock_guard<mutex> lock(cacheMutex);
+         index = &(cellIndices.insert(make_pair(meshName,newIndex)).first->second);
+      }
+
+      positions.resize(cellIDs.size());
+      for (size_t i=0; i<cellIDs.size(); ++i) {
+         vector<uint64_t>::const_iterator it = lower_bound(index->cellIDs.begin(),index->cellIDs.end(),cellIDs[i]);
+         if (it == index->cellIDs.end() || *it != cellIDs[i]) {
+            cerr << "vlsv::Reader ERROR: Cell " << cellIDs[i] << " does not exist in mesh '" << meshName << "'" << endl;
+            positions.clear();
+            return false;
+         }
+         positions[i] = index->positions[it-index->cellIDs.begin()];
+      }
+      return true;
+   }
+
+   /** Find the chunks of a compressed array that contain the given array elements. 
+    * If all chunks have the same size the chunk indices are calculated directly, 
+    * otherwise they are searched from the chunk table.
+    * @param table Chunk table of the array.
+    * @param begin Index of the first requested array element.
+    * @param amount Number of requested array elements, must be larger than zero.
+    * @param firstChunk Variable in which the index of the first chunk is written.
+    * @param lastChunk Variable in which the index of the last chunk is written.*/
+   void Reader::getChunkRange(const ChunkTable& table,const uint64_t& begin,const uint64_t& amount,
+                              uint64_t& firstChunk,uint64_t& lastChunk) const {
+      if (table.chunkSize > 0) {
+         firstChunk = begin / table.chunkSize;
+         lastChunk  = (begin+amount-1) / table.chunkSize;
+         return;
+      }
+      firstChunk = upper_bound(table.firstElement.begin(),table.firstElement.end(),begin) - table.firstElement.begin() - 1;
+      lastChunk  = upper_bound(table.firstElement.begin(),table.firstElement.end(),begin+amount-1) - table.firstElement.begin() - 1;
+   }
+
    const std::string Reader::getErrorString() const {
       return vlsv::getErrorString(lastErrorCode);
    }
@@ -122,24 +520,14 @@ namespace vlsv {
    bool Reader::loadArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs) {
       if (fileOpen == false) return false;
    
-      // Find tag corresponding to given array:
-      muxml::XMLNode* node = xmlReader.find(tagName,attribs);
-      if (node == NULL) return false;
-
-      // Copy array information from tag:
-      arrayOpen.offset = atol(node->value.c_str());
-      arrayOpen.tagName = tagName;
-      arrayOpen.arraySize = atol(node->attributes["arraysize"].c_str());
-      arrayOpen.vectorSize = atol(node->attributes["vectorsize"].c_str());
-      arrayOpen.dataSize = atol(node->attributes["datasize"].c_str());
-      if (node->attributes["datatype"] == "unknown") arrayOpen.dataType = datatype::UNKNOWN;
-      else if (node->attributes["datatype"] == "int") arrayOpen.dataType = datatype::INT;
-      else if (node->attributes["datatype"] == "uint") arrayOpen.dataType = datatype::UINT;
-      else if (node->attributes["datatype"] == "float") arrayOpen.dataType = datatype::FLOAT;
-      else {
+      // Find tag corresponding to given array and copy array information from it:
+      bool infoValid;
+      if (findArray(tagName,attribs,arrayOpen,infoValid) == NULL) return false;
+      if (infoValid == false) {
          cerr << "vlsv::Reader ERROR: Unknown datatype in tag!" << endl;
          return false;
-      }   
+      }
+      arrayOpen.tagName = tagName;
       //if (arrayOpen.arraySize == 0) return false;
       if (arrayOpen.vectorSize == 0) return false;
       if (arrayOpen.dataSize == 0) return false;
@@ -147,6 +535,41 @@ namespace vlsv {
       return true;
    }
 
+   /** Read the chunk table of a compressed array. Chunk tables are cached 
+    * until the file is closed.
+    * @param info Metadata of the array.
+    * @param table Variable in which a pointer to the chunk table is written.
+    * @return If true, the chunk table was read successfully.*/
+   bool Reader::loadChunkTable(const ArrayOpen& info,ChunkTable*& table) {
+      lock_guard<mutex> lock(cacheMutex);
+      map<uint64_t,ChunkTable>::iterator it = chunkTables.find(info.chunkTableOffset);
+      if (it != chunkTables.end()) {
+         table = &(it->second);
+         return true;
+      }
+
+      const streamsize tableBytes = info.chunks*chunktable::SIZE*sizeof(uint64_t);
+      vector<char> buffer(tableBytes);
+      if (readBytes(info.chunkTableOffset,tableBytes,buffer.data()) == false) {
+         cerr << "vlsv::Reader ERROR: Failed to read chunk table of array '" << info.tagName << "'" << endl;
+         return false;
+      }
+
+      ChunkTable& newTable = chunkTables[info.chunkTableOffset];
+      newTable.chunkSize = info.chunkSize;
+      newTable.entries.resize(info.chunks*chunktable::SIZE);
+      for (size_t i=0; i<newTable.entries.size(); ++i) {
+         newTable.entries[i] = convUInt64(&(buffer[i*sizeof(uint64_t)]),swapIntEndianness);
+      }
+      newTable.firstElement.resize(info.chunks+1);
+      newTable.firstElement[0] = 0;
+      for (uint64_t c=0; c<info.chunks; ++c) {
+         newTable.firstElement[c+1] = newTable.firstElement[c] + newTable.entries[c*chunktable::SIZE+chunktable::ELEMENTS];
+      }
+      table = &newTable;
+      return true;
+   }
+
    /** Open a VLSV file for reading. This function fails if a 
     * file is already open. 
     * @param fname File name.
@@ -187,6 +610,7 @@ namespace vlsv {
 
       if (filein.good() == true) {
          fileName = fnameWithoutPath;
+         filePath = fname;
          fileOpen = true;
       } else {
          filein.close();
@@ -196,6 +620,17 @@ namespace vlsv {
 
       if (success == false) return success;
 
+      // Map the input file into memory if requested. If mapping fails,
+      // data is read through the file stream:
+      if (memoryMapping == true) mappedData = fileio::mapFile(fname.c_str(),mappedBytes);
+
+      // Open a file descriptor for positional reads. If this is not possible, 
+      // data is read through the file stream:
+      fileDescriptor = fileio::openFile(fname.c_str());
+
+      // Identify the file so that cached data is shared with other readers of the same file:
+      if (fileio::getFileIdentity(fname.c_str(),fileIdentity) == false) fileIdentity.clear();
+
       // Detect file endianness:
       char* ptr = reinterpret_cast<char*>(&endiannessFile);
       filein.read(ptr,1);
@@ -204,7 +639,7 @@ namespace vlsv {
          lastErrorCode = error::READ_FILE_ENDIANNESS;
          return success;
       }
-      if (endiannessFile != endiannessReader) swapIntEndianness = true;
+      swapIntEndianness = (endiannessFile != endiannessReader);
 
       // Read footer offset:
       uint64_t footerOffset;
@@ -218,7 +653,16 @@ namespace vlsv {
       }
       footerOffset = convUInt64(buffer,swapIntEndianness);
 
+      // Use binary footer index if the file has one:
+      if (readFooterIndex(footerOffset) == true) {
+         filein.clear();
+         filein.seekg(16);
+         buildArrayIndex();
+         return success;
+      }
+
       // Read footer XML tree:
+      filein.clear();
       filein.seekg(footerOffset);
       if (filein.tellg() != footerOffset) {
          lastErrorCode = error::READ_NO_FOOTER;
@@ -231,10 +675,360 @@ namespace vlsv {
       }
       filein.clear();
       filein.seekg(16);
+      if (success == true) buildArrayIndex();
+
+      return success;
+   }
+
+   /** Load the footer from a binary footer index, see vlsv::encodeFooterIndex. 
+    * The index is only used if it was written in the endianness of this computer.
+    * @param footerOffset Offset of the XML footer in the input file.
+    * @return If true, the footer was loaded from the index. If false, the file 
+    * does not have an index and the XML footer must be parsed.*/
+   bool Reader::readFooterIndex(const uint64_t& footerOffset) {
+      if (swapIntEndianness == true) return false;
+      if (footerOffset < 16 + footerindex::TRAILER_BYTES) return false;
+
+      char trailer[footerindex::TRAILER_BYTES];
+      filein.seekg(footerOffset-footerindex::TRAILER_BYTES);
+      filein.read(trailer,footerindex::TRAILER_BYTES);
+      uint64_t indexBytes;
+      if (filein.good() == false || getFooterIndexSize(trailer,indexBytes) == false) return false;
+      if (indexBytes > footerOffset - 16 - footerindex::TRAILER_BYTES) return false;
+
+      vector<char> index(indexBytes);
+      filein.seekg(footerOffset-footerindex::TRAILER_BYTES-indexBytes);
+      filein.read(index.data(),indexBytes);
+      if (filein.good() == false) return false;
+      if (decodeFooterIndex(index.data(),indexBytes,xmlReader) == false) {
+         xmlReader.clear();
+         return false;
+      }
+      return true;
+   }
+
+   /** Copy array metadata from the given XML tag.
+    * @param node XML tag of the array.
+    * @param info Struct in which array metadata is written. Tag name is not modified.
+    * @return If true, the XML tag contained valid array metadata.*/
+   bool Reader::parseArrayInfo(muxml::XMLNode* node,ArrayOpen& info) const {
+      info.offset = atol(node->value.c_str());
+      info.arraySize = atol(xmlReader.getAttributeValue(node,"arraysize").c_str());
+      info.vectorSize = atol(xmlReader.getAttributeValue(node,"vectorsize").c_str());
+      info.dataSize = atol(xmlReader.getAttributeValue(node,"datasize").c_str());
+      info.dataType = getVLSVDatatype(xmlReader.getAttributeValue(node,"datatype"));
+      if (info.dataType == datatype::UNKNOWN && xmlReader.getAttributeValue(node,"datatype") != "unknown") return false;
+      info.codec = xmlReader.getAttributeValue(node,"codec");
+      info.chunks = atol(xmlReader.getAttributeValue(node,"chunks").c_str());
+      info.chunkTableOffset = atol(xmlReader.getAttributeValue(node,"chunktable").c_str());
+      info.chunkSize = atol(xmlReader.getAttributeValue(node,"chunksize").c_str());
+      info.filter = xmlReader.getAttributeValue(node,"filter");
+
+      // Arrays stored in subfiles list the offset and number of elements in each subfile:
+      info.subfiles = atol(xmlReader.getAttributeValue(node,"subfiles").c_str());
+      info.subfileOffsets.clear();
+      info.subfileElements.clear();
+      if (info.subfiles > 1) {
+         parseList(xmlReader.getAttributeValue(node,"subfile_offsets"),info.subfileOffsets);
+         parseList(xmlReader.getAttributeValue(node,"subfile_elements"),info.subfileElements);
+         if (info.subfileOffsets.size() != info.subfiles || info.subfileElements.size() != info.subfiles) {
+            cerr << "vlsv::Reader ERROR: Invalid subfile attributes in tag!" << endl;
+            return false;
+         }
+      }
+      return true;
+   }
+
+   /** Read the given components of array elements by reading whole elements 
+    * in blocks to a temporary buffer, from which the components are copied to output.
+    * Used for arrays that can not be read with strided reads.
+    * @param info Metadata of the array.
+    * @param begin Index of the first read array element.
+    * @param amount How many array elements are read.
+    * @param firstComponent Index of the first read vector component.
+    * @param components Number of read vector components.
+    * @param buffer Buffer in which data is copied.
+    * @return If true, requested components were read to buffer.*/
+   bool Reader::readBlockComponents(const ArrayOpen& info,const uint64_t& begin,const uint64_t& amount,
+                                    const uint64_t& firstComponent,const uint64_t& components,char* buffer) {
+      const uint64_t elementBytes   = info.vectorSize*info.dataSize;
+      const uint64_t componentBytes = components*info.dataSize;
+      const uint64_t blockElements  = max(static_cast<uint64_t>(1),(1 << 22)/elementBytes);
+      vector<char> block(min(amount,blockElements)*elementBytes);
+      for (uint64_t b=0; b<amount; b+=blockElements) {
+         const uint64_t N = min(blockElements,amount-b);
+         bool success;
+         if (info.codec.size() > 0) success = readChunkedArray(info,begin+b,N,block.data());
+         else if (info.subfiles > 1) success = readSubfiledArray(info,begin+b,N,block.data());
+         else success = readBytes(info.offset+(begin+b)*elementBytes,N*elementBytes,block.data());
+         if (success == false) return false;
+         for (uint64_t i=0; i<N; ++i) {
+            memcpy(buffer+(b+i)*componentBytes,&(block[i*elementBytes+firstComponent*info.dataSize]),componentBytes);
+         }
+      }
+      return true;
+   }
+
+   /** Read the given elements of a compressed array.
+    * @param info Metadata of the array.
+    * @param begin Index of the first read array element.
+    * @param amount How many array elements are read, must be larger than zero.
+    * @param buffer Buffer in which data is copied.
+    * @return If true, requested part of the array was decompressed to buffer.*/
+   bool Reader::readChunkedArray(const ArrayOpen& info,const uint64_t& begin,const uint64_t& amount,char* buffer) {
+      ChunkTable* table = NULL;
+      if (loadChunkTable(info,table) == false) return false;
 
+      // Read compressed data of all chunks that contain requested elements with a single read:
+      uint64_t firstChunk,lastChunk;
+      getChunkRange(*table,begin,amount,firstChunk,lastChunk);
+      const uint64_t* first = &(table->entries[firstChunk*chunktable::SIZE]);
+      const uint64_t* last  = &(table->entries[lastChunk*chunktable::SIZE]);
+      const streamsize spanBytes = last[chunktable::OFFSET] + last[chunktable::BYTES] - first[chunktable::OFFSET];
+      vector<char> span(spanBytes);
+      if (readBytes(first[chunktable::OFFSET],spanBytes,span.data()) == false) {
+         cerr << "vlsv::Reader ERROR: Failed to read compressed data of array '" << info.tagName << "'" << endl;
+         return false;
+      }
+      return decodeChunks(info,*table,begin,amount,span.data(),buffer);
+   }
+
+   /** Read several parts of an array with as few file reads as possible. Ranges 
+    * are sorted by file position, and ranges that are separated by at most 
+    * setMaxRangeGap bytes are read with a single vectored read that scatters 
+    * the data directly to the output buffers. Ranges may be given in any order 
+    * and may overlap. Compressed arrays and arrays stored in subfiles are read 
+    * range by range.
+    * @param tagName Name of the XML tag.
+    * @param attribs List of attributes that uniquely determine the array.
+    * @param ranges Index of the first array element and number of array elements in each range.
+    * @param buffers Buffer in which each range is copied.
+    * @return If true, array was found and all ranges were copied to buffers.*/
+   bool Reader::readRanges(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                           const std::vector<std::pair<uint64_t,uint64_t> >& ranges,const std::vector<char*>& buffers) {
+      if (fileOpen == false) {
+         cerr << "vlsv::Reader ERROR: readRanges called but a file is not open!" << endl;
+         return false;
+      }
+      if (ranges.size() != buffers.size()) {
+         cerr << "vlsv::Reader ERROR: Number of ranges and buffers differ in readRanges!" << endl;
+         return false;
+      }
+      if (ranges.size() == 0) return true;
+
+      ArrayOpen localInfo;
+      ArrayOpen& info = (concurrentReads == true) ? localInfo : arrayOpen;
+      muxml::XMLNode* node = findReadableArray(tagName,attribs,info);
+      if (node == NULL) return false;
+
+      for (size_t r=0; r<ranges.size(); ++r) {
+         if (ranges[r].first + ranges[r].second > info.arraySize) {
+            cerr << "vlsv::Reader ERROR: Requested range exceeds array size. begin: " << ranges[r].first;
+            cerr << " amount: " << ranges[r].second << " size: " << info.arraySize << endl;
+            return false;
+         }
+      }
+
+      bool success = true;
+      const uint64_t elementBytes = info.vectorSize*info.dataSize;
+      const char* mapped = getMappedArray(info,0,info.arraySize);
+      if (info.codec.size() > 0 || info.subfiles > 1 || mapped != NULL) {
+         for (size_t r=0; r<ranges.size() && success == true; ++r) {
+            if (ranges[r].second == 0) continue;
+            if (info.codec.size() > 0) success = readChunkedArray(info,ranges[r].first,ranges[r].second,buffers[r]);
+            else if (info.subfiles > 1) success = readSubfiledArray(info,ranges[r].first,ranges[r].second,buffers[r]);
+            else memcpy(buffers[r],mapped+ranges[r].first*elementBytes,ranges[r].second*elementBytes);
+         }
+      } else {
+         // Sort ranges by their position in the file:
+         vector<size_t> order;
+         order.reserve(ranges.size());
+         for (size_t r=0; r<ranges.size(); ++r) if (ranges[r].second > 0) order.push_back(r);
+         sort(order.begin(),order.end(),[&ranges](const size_t& a,const size_t& b) {return ranges[a].first < ranges[b].first;});
+
+         vector<char> gap;
+         vector<char*> pieceBuffers;
+         vector<uint64_t> pieceBytes;
+         size_t first = 0;
+         while (first < order.size() && success == true) {
+            // Add ranges to this read until there is an overlap or a too large gap. 
+            // Gaps are marked with NULL buffers:
+            const uint64_t groupBegin = ranges[order[first]].first*elementBytes;
+            uint64_t groupEnd = groupBegin;
+            pieceBuffers.clear();
+            pieceBytes.clear();
+            size_t last = first;
+            while (last < order.size()) {
+               const uint64_t rangeBegin = ranges[order[last]].first*elementBytes;
+               if (rangeBegin < groupEnd || rangeBegin - groupEnd > maxRangeGap) break;
+               if (rangeBegin > groupEnd) {
+                  pieceBuffers.push_back(NULL);
+                  pieceBytes.push_back(rangeBegin-groupEnd);
+                  if (gap.size() < rangeBegin-groupEnd) gap.resize(rangeBegin-groupEnd);
+               }
+               pieceBuffers.push_back(buffers[order[last]]);
+               pieceBytes.push_back(ranges[order[last]].second*elementBytes);
+               groupEnd = rangeBegin + pieceBytes.back();
+               ++last;
+            }
+
+            if (fileDescriptor >= 0) {
+               // Bytes in gaps are read to a scratch buffer:
+               for (size_t p=0; p<pieceBuffers.size(); ++p) if (pieceBuffers[p] == NULL) pieceBuffers[p] = gap.data();
+               success = fileio::readAtVectored(fileDescriptor,pieceBuffers.data(),pieceBytes.data(),
+                                                pieceBuffers.size(),info.offset+groupBegin);
+            } else {
+               vector<char> span(groupEnd-groupBegin);
+               success = readBytes(info.offset+groupBegin,span.size(),span.data());
+               uint64_t position = 0;
+               for (size_t p=0; p<pieceBuffers.size() && success == true; ++p) {
+                  if (pieceBuffers[p] != NULL) memcpy(pieceBuffers[p],&(span[position]),pieceBytes[p]);
+                  position += pieceBytes[p];
+               }
+            }
+            first = last;
+         }
+         if (success == false) {
+            cerr << "vlsv::Reader ERROR: Failed to read ranges of array '" << tagName << "'" << endl;
+         }
+      }
+
+      // Convert data to native endianness:
+      if (success == true && swapIntEndianness == true) {
+         for (size_t r=0; r<ranges.size(); ++r) swapByteOrder(buffers[r],ranges[r].second*info.vectorSize,info.dataSize);
+      }
       return success;
    }
 
+   /** Read the given elements of an array that is stored in subfiles. Subfiles 
+    * are named after the input file, i.e., fname.0, fname.1, etc. They are 
+    * opened when first needed and kept open until the input file is closed.
+    * @param info Metadata of the array.
+    * @param begin Index of the first read array element.
+    * @param amount How many array elements are read.
+    * @param buffer Buffer in which data is copied.
+    * @return If true, requested part of the array was read to buffer.*/
+   bool Reader::readSubfiledArray(const ArrayOpen& info,const uint64_t& begin,const uint64_t& amount,char* buffer) {
+      const uint64_t elementBytes = info.vectorSize*info.dataSize;
+      uint64_t subfileBegin = 0;
+      for (uint64_t s=0; s<info.subfiles; ++s) {
+         const uint64_t subfileEnd = subfileBegin + info.subfileElements[s];
+         const uint64_t readBegin  = max(begin,subfileBegin);
+         const uint64_t readEnd    = min(begin+amount,subfileEnd);
+         if (readEnd > readBegin) {
+            const uint64_t readOffset = info.subfileOffsets[s] + (readBegin-subfileBegin)*elementBytes;
+            const uint64_t readBytes  = (readEnd-readBegin)*elementBytes;
+            char* readBuffer = buffer + (readBegin-begin)*elementBytes;
+            bool success;
+
+            // Subfile handles are only looked up or opened while holding the lock. Data 
+            // is read with positional reads, which may run concurrently:
+            int descriptor = -1;
+            fstream* stream = NULL;
+            {
+               lock_guard<mutex> lock(cacheMutex);
+               if (openSubfile(s,descriptor,stream) == false) return false;
+            }
+            if (descriptor >= 0) {
+               success = fileio::readAt(descriptor,readBuffer,readBytes,readOffset);
+            } else {
+               // Positional reads are not available, reads through the stream are serialized:
+               lock_guard<mutex> lock(cacheMutex);
+               stream->clear();
+               stream->seekg(readOffset);
+               stream->read(readBuffer,readBytes);
+               success = (stream->gcount() == static_cast<streamsize>(readBytes));
+            }
+            if (success == false) {
+               cerr << "vlsv::Reader ERROR: Failed to read array '" << info.tagName << "' from subfile " << s << endl;
+               return false;
+            }
+         }
+         subfileBegin = subfileEnd;
+      }
+      return true;
+   }
+
+   /** Get the handle of the given subfile, opening the subfile if it has not been opened yet. 
+    * The subfile is opened for positional reads if they are available, otherwise as a file stream.
+    * The caller must hold cacheMutex.
+    * @param subfile Number of the subfile.
+    * @param descriptor Variable in which the file descriptor of the subfile is written, -1 if not available.
+    * @param stream Variable in which the file stream of the subfile is written if descriptor is not available.
+    * @return If true, the subfile is open.*/
+   bool Reader::openSubfile(const uint64_t& subfile,int& descriptor,std::fstream*& stream) {
+      map<uint64_t,int>::const_iterator fd = subfileDescriptors.find(subfile);
+      if (fd != subfileDescriptors.end()) {
+         descriptor = fd->second;
+         return true;
+      }
+      map<uint64_t,fstream*>::const_iterator it = subfileStreams.find(subfile);
+      if (it != subfileStreams.end()) {
+         stream = it->second;
+         return true;
+      }
+
+      stringstream ss;
+      ss << filePath << '.' << subfile;
+      descriptor = fileio::openFile(ss.str().c_str());
+      if (descriptor >= 0) {
+         subfileDescriptors[subfile] = descriptor;
+         return true;
+      }
+      stream = new fstream(ss.str().c_str(),fstream::in | fstream::binary);
+      if (stream->good() == false) {
+         cerr << "vlsv::Reader ERROR: Failed to open subfile '" << ss.str() << "'" << endl;
+         delete stream;
+         stream = NULL;
+         return false;
+      }
+      subfileStreams[subfile] = stream;
+      return true;
+   }
+
+   /** Get a string that identifies an array within the input file. The 
+    * identity consists of the tag name and all attributes of the array.
+    * @param tagName Name of the XML tag.
+    * @param node XML tag of the array.
+    * @return Identity of the array.*/
+   std::string Reader::getArrayIdentity(const std::string& tagName,const muxml::XMLNode* node) const {
+      string identity = tagName;
+      for (map<string,string>::const_iterator it=node->attributes.begin(); it!=node->attributes.end(); ++it) {
+         identity += '\0' + it->first + '=' + it->second;
+      }
+      return identity;
+   }
+
+   /** Find the array matching the given tag name and attributes, and check 
+    * that its metadata is valid for reading.
+    * @param tagName Name of the XML tag.
+    * @param attribs List of attributes that uniquely determine the array.
+    * @param info Variable in which metadata of the array is written.
+    * @return XML tag of the array, or NULL if the array was not found or can not be read.*/
+   muxml::XMLNode* Reader::findReadableArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                                             ArrayOpen& info) const {
+      bool infoValid;
+      muxml::XMLNode* node = findArray(tagName,attribs,info,infoValid);
+      if (node == NULL) {
+         cerr << "vlsv::Reader ERROR: Failed to find tag='" << tagName << "' attribs:" << endl;
+         for (list<pair<string,string> >::const_iterator it=attribs.begin(); it!=attribs.end(); ++it) {
+            cerr << '\t' << it->first << " = '" << it->second << "'" << endl;
+         }
+         return NULL;
+      }
+      
+      info.tagName = tagName;
+      if (infoValid == false || info.dataType == datatype::UNKNOWN) {
+         cerr << "vlsv::Reader ERROR: Unknown datatype in tag!" << endl;
+         return NULL;
+      }
+   
+      if (info.arraySize == 0) return NULL;
+      if (info.vectorSize == 0) return NULL;
+      if (info.dataSize == 0) return NULL;
+      return node;
+   }
+
    /** Read given part of a given array from file.
     * @param tagName Name of the XML tag.
     * @param attribs List of attributes that uniquely determine the array.
@@ -252,62 +1046,222 @@ namespace vlsv {
       // If zero-length read was requested, exit immediately:
       if (amount == 0) return true;
       
-      // Find tag corresponding to given array:
-      muxml::XMLNode* node = xmlReader.find(tagName,attribs);
-      if (node == NULL) {
-         cerr << "vlsv::Reader ERROR: Failed to find tag='" << tagName << "' attribs:" << endl;
-         for (list<pair<string,string> >::const_iterator it=attribs.begin(); it!=attribs.end(); ++it) {
-            cerr << '\t' << it->first << " = '" << it->second << "'" << endl;
-         }
+      // Find tag corresponding to given array and copy array information from it. 
+      // In concurrent mode the information is kept local to this call:
+      ArrayOpen localInfo;
+      ArrayOpen& info = (concurrentReads == true) ? localInfo : arrayOpen;
+      muxml::XMLNode* node = findReadableArray(tagName,attribs,info);
+      if (node == NULL) return false;
+      
+      // Sanity check on values:
+      if (begin + amount > info.arraySize) {
+         cerr << "vlsv::Reader ERROR: Requested read exceeds array size. begin: " << begin;
+         cerr << " amount: " << amount << " size: " << info.arraySize << endl;
          return false;
       }
-      
-      // Copy array information from tag:
-      arrayOpen.offset = atol(node->value.c_str());
-      arrayOpen.tagName = tagName;
-      arrayOpen.arraySize = atol(node->attributes["arraysize"].c_str());
-      arrayOpen.vectorSize = atol(node->attributes["vectorsize"].c_str());
-      arrayOpen.dataSize = atol(node->attributes["datasize"].c_str());
-      if (node->attributes["datatype"] == "int") arrayOpen.dataType = datatype::INT;
-      else if (node->attributes["datatype"] == "uint") arrayOpen.dataType = datatype::UINT;
-      else if (node->attributes["datatype"] == "float") arrayOpen.dataType = datatype::FLOAT;
-      else {
-         cerr << "vlsv::Reader ERROR: Unknown datatype in tag!" << endl;
+
+      // Copy data from the block cache if possible. Data of memory-mapped 
+      // arrays is already in memory and is not cached:
+      BlockCache& cache = BlockCache::global();
+      const uint64_t elementBytes = info.vectorSize*info.dataSize;
+      string arrayIdentity;
+      bool useCache = false;
+      if (fileIdentity.size() > 0 && cache.getByteLimit() > 0 && getMappedArray(info,begin,amount) == NULL) {
+         useCache = true;
+         arrayIdentity = getArrayIdentity(info.tagName,node);
+         if (cache.find(fileIdentity,arrayIdentity,elementBytes,begin,amount,buffer) == true) return true;
+      }
+
+      // Compressed arrays are read chunk by chunk:
+      bool success = true;
+      if (info.codec.size() > 0) success = readChunkedArray(info,begin,amount,buffer);
+      else if (info.subfiles > 1) success = readSubfiledArray(info,begin,amount,buffer);
+      else success = readContiguousArray(info,node,begin,amount,buffer);
+
+      // Convert data to native endianness:
+      if (success == true && swapIntEndianness == true) {
+         swapByteOrder(buffer,amount*info.vectorSize,info.dataSize);
+      }
+      if (success == true && useCache == true) {
+         cache.insert(fileIdentity,arrayIdentity,elementBytes,begin,amount,buffer);
+      }
+      return success;
+   }
+
+   /** Read the given components of the given elements of an array. If the array is stored 
+    * uncompressed and the unwanted components of each element take at least COMPONENT_GAP_BYTES 
+    * bytes, only the requested components are read from the file with one positional read per 
+    * element. Otherwise whole elements are read and the unwanted components are discarded, 
+    * since a separate read request per element costs more than reading a small gap. Arrays 
+    * mapped to memory only copy the requested components.
+    * @param tagName Name of the XML tag.
+    * @param attribs List of attributes that uniquely determine the array.
+    * @param begin Index of the first read array element.
+    * @param amount How many array elements are read.
+    * @param firstComponent Index of the first read vector component.
+    * @param components Number of read vector components.
+    * @param buffer Buffer in which data is copied, contains amount*components values.
+    * @return If true, array was found and requested components were copied to buffer.*/
+   bool Reader::readArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                          const uint64_t& begin,const uint64_t& amount,const uint64_t& firstComponent,
+                          const uint64_t& components,char* buffer) {
+      if (fileOpen == false) {
+         cerr << "vlsv::Reader ERROR: readArray called but a file is not open!" << endl;
          return false;
       }
-   
-      if (arrayOpen.arraySize == 0) return false;
-      if (arrayOpen.vectorSize == 0) return false;
-      if (arrayOpen.dataSize == 0) return false;
-      
-      // Sanity check on values:
-      if (begin + amount > arrayOpen.arraySize) {
+      if (amount == 0) return true;
+
+      ArrayOpen localInfo;
+      ArrayOpen& info = (concurrentReads == true) ? localInfo : arrayOpen;
+      muxml::XMLNode* node = findReadableArray(tagName,attribs,info);
+      if (node == NULL) return false;
+      if (begin + amount > info.arraySize) {
          cerr << "vlsv::Reader ERROR: Requested read exceeds array size. begin: " << begin;
-         cerr << " amount: " << amount << " size: " << arrayOpen.arraySize << endl;
+         cerr << " amount: " << amount << " size: " << info.arraySize << endl;
          return false;
       }
+      if (components == 0 || firstComponent + components > info.vectorSize) {
+         cerr << "vlsv::Reader ERROR: Requested components exceed vector size. first: " << firstComponent;
+         cerr << " components: " << components << " vectorsize: " << info.vectorSize << endl;
+         return false;
+      }
+
+      bool success = true;
+      const uint64_t elementBytes   = info.vectorSize*info.dataSize;
+      const uint64_t componentBytes = components*info.dataSize;
+      const uint64_t skipBytes      = firstComponent*info.dataSize;
+      const char* mapped = getMappedArray(info,begin,amount);
+      if (info.codec.size() > 0 || info.subfiles > 1) {
+         // Whole elements need to be decompressed or read from subfiles:
+         success = readBlockComponents(info,begin,amount,firstComponent,components,buffer);
+      } else if (mapped != NULL) {
+         for (uint64_t i=0; i<amount; ++i) memcpy(buffer+i*componentBytes,mapped+i*elementBytes+skipBytes,componentBytes);
+      } else if (fileDescriptor >= 0 && elementBytes-componentBytes < COMPONENT_GAP_BYTES) {
+         // Gaps between requested components are small, so whole elements are read with 
+         // vectored reads. Requested components are scattered to output and the rest 
+         // of each element to a scratch buffer:
+         const uint64_t BATCH = 4096;
+         vector<char> gap(elementBytes-componentBytes);
+         vector<char*> pieceBuffers;
+         vector<uint64_t> pieceBytes;
+         for (uint64_t b=0; b<amount && success == true; b+=BATCH) {
+            const uint64_t N = min(BATCH,amount-b);
+            pieceBuffers.clear();
+            pieceBytes.clear();
+            for (uint64_t i=0; i<N; ++i) {
+               pieceBuffers.push_back(buffer+(b+i)*componentBytes);
+               pieceBytes.push_back(componentBytes);
+               if (gap.size() > 0 && i+1 < N) {
+                  pieceBuffers.push_back(gap.data());
+                  pieceBytes.push_back(gap.size());
+               }
+            }
+            success = fileio::readAtVectored(fileDescriptor,pieceBuffers.data(),pieceBytes.data(),pieceBuffers.size(),
+                                             info.offset+(begin+b)*elementBytes+skipBytes);
+         }
+      } else if (fileDescriptor >= 0) {
+         // Only the requested components are read, with one positional read per element:
+         for (uint64_t i=0; i<amount && success == true; ++i) {
+            success = fileio::readAt(fileDescriptor,buffer+i*componentBytes,componentBytes,
+                                     info.offset+(begin+i)*elementBytes+skipBytes);
+         }
+      } else {
+         success = readBlockComponents(info,begin,amount,firstComponent,components,buffer);
+      }
+      if (success == false) {
+         cerr << "vlsv::Reader ERROR: Failed to read components of array '" << tagName << "'" << endl;
+         return false;
+      }
+
+      // Convert data to native endianness:
+      if (swapIntEndianness == true) swapByteOrder(buffer,amount*components,info.dataSize);
+      return true;
+   }
+
+   /** Read bytes from the given position of the input file. Positional reads 
+    * are used if available, otherwise data is read through the input file stream.
+    * @param offset Position of the first byte relative to file start.
+    * @param bytes Number of bytes to read.
+    * @param buffer Buffer in which the data is read.
+    * @return If true, all requested bytes were read.*/
+   bool Reader::readBytes(const uint64_t& offset,const uint64_t& bytes,char* buffer) {
+      if (fileDescriptor >= 0) return fileio::readAt(fileDescriptor,buffer,bytes,offset);
 
-      // Read data from file:
-      streamoff start = arrayOpen.offset + begin*arrayOpen.vectorSize*arrayOpen.dataSize;
-      streamsize readBytes = amount*arrayOpen.vectorSize*arrayOpen.dataSize;
+      unique_lock<mutex> lock(streamMutex,defer_lock);
+      if (concurrentReads == true) lock.lock();
       filein.clear();
-      filein.seekg(start);
-      filein.read(buffer,readBytes);
-      
-      // Check that we were able to read the requested amount of data:
-      if (filein.gcount() != readBytes) {
+      filein.seekg(offset);
+      filein.read(buffer,bytes);
+      return filein.gcount() == static_cast<streamsize>(bytes);
+   }
+
+   /** Read the given elements of an array that is stored uncompressed in the 
+    * input file. Data is copied from the memory-mapped file if possible.
+    * @param info Metadata of the array.
+    * @param node XML tag of the array.
+    * @param begin Index of the first read array element.
+    * @param amount How many array elements are read.
+    * @param buffer Buffer in which data is copied.
+    * @return If true, requested part of the array was read to buffer.*/
+   bool Reader::readContiguousArray(const ArrayOpen& info,const muxml::XMLNode* node,const uint64_t& begin,
+                                    const uint64_t& amount,char* buffer) {
+      const char* mapped = getMappedArray(info,begin,amount);
+      if (mapped != NULL) {
+         memcpy(buffer,mapped,amount*info.vectorSize*info.dataSize);
+         return true;
+      }
+
+      // Read data from file and check that we were able to read the requested amount of data:
+      const uint64_t start = info.offset + begin*info.vectorSize*info.dataSize;
+      const uint64_t bytes = amount*info.vectorSize*info.dataSize;
+      if (readBytes(start,bytes,buffer) == false) {
          cerr << "vlsv::Reader ERROR: Failed to read requested amount of bytes!" << endl;      
-         cerr << "tag name='" << tagName << "'" << endl;
+         cerr << "tag name='" << info.tagName << "'" << endl;
          cerr << "attributes:" << endl;
          for (map<string,string>::const_iterator it=node->attributes.begin(); it!=node->attributes.end(); ++it) {
             cerr << '\t' << it->first << " = " << it->second << endl;
          }
          cerr << "array offset string '" << node->value.c_str() << "'" << endl;
-         cerr << "start=" << start << " readBytes=" << readBytes << endl;
-         cerr << "offset=" << arrayOpen.offset << " vectorsize=" << arrayOpen.vectorSize << " dataSize=" << arrayOpen.dataSize << endl;
+         cerr << "start=" << start << " readBytes=" << bytes << endl;
+         cerr << "offset=" << info.offset << " vectorsize=" << info.vectorSize << " dataSize=" << info.dataSize << endl;
          return false;
       }
       return true;
    }
 
+   /** Enable or disable concurrent reads. Array data is read with positional reads 
+    * that do not move a shared file position, and in concurrent mode metadata of 
+    * the read array is also kept local to each call. Functions readArray, read, readParameter, 
+    * getArrayInfo, and getArrayAttributes may then be called by several threads 
+    * simultaneously. Other member functions, including open, close, and view, must not 
+    * be called while reads are in progress. If positional reads are not available 
+    * on this platform, reads are serialized.
+    * @param concurrentReads If true, concurrent reads are enabled.
+    * @return If true, the setting was changed successfully.*/
+   bool Reader::setConcurrentReads(const bool& concurrentReads) {
+      this->concurrentReads = concurrentReads;
+      return true;
+   }
+
+   /** Set the largest gap between two array ranges that readRanges reads 
+    * with a single file read. Data in the gap is read and discarded, which 
+    * is usually faster than a separate read request, especially on parallel file systems.
+    * @param maxGapBytes Largest gap in bytes, zero means only adjacent ranges are combined.
+    * @return If true, the setting was changed successfully.*/
+   bool Reader::setMaxRangeGap(const uint64_t& maxGapBytes) {
+      maxRangeGap = maxGapBytes;
+      return true;
+   }
+
+   /** Enable or disable memory mapping of input files. If enabled, files opened 
+    * after this call are mapped into memory, uncompressed arrays are copied from 
+    * the mapping in readArray, and Reader::view can return data without copying it. 
+    * Mapping is not available on all platforms, in which case files are read normally.
+    * @param memoryMapping If true, input files are memory-mapped.
+    * @return If true, the setting was changed successfully.*/
+   bool Reader::setMemoryMapping(const bool& memoryMapping) {
+      this->memoryMapping = memoryMapping;
+      return true;
+   }
+
 } // namespace vlsv
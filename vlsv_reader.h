@@ -20,25 +20,88 @@
 #define VLSV_READER_H
 
 #include <stdint.h>
+#include <algorithm>
 #include <list>
 #include <set>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <fstream>
 
 #include "muxml.h"
+#include "portable_file_io.h"
+#include "vlsv_codec.h"
 #include "vlsv_common.h"
 
 namespace vlsv {
 
+   /** Read-only view to array data returned by vlsv::Reader::view. If the file is 
+    * memory-mapped and the data is stored in the requested type, the view points 
+    * directly into the mapped file and remains valid until the file is closed. 
+    * Otherwise the view owns a converted copy of the data.*/
+   template<typename T>
+   class ArrayView {
+    public:
+      ArrayView(): ptr(NULL),elements(0) { }
+      ArrayView(const ArrayView& other): ptr(other.ptr),elements(other.elements),storage(other.storage) {repoint();}
+      ArrayView(ArrayView&& other): ptr(other.ptr),elements(other.elements),storage(std::move(other.storage)) {
+         repoint();
+         other.clear();
+      }
+
+      ArrayView& operator=(const ArrayView& other) {
+         if (this == &other) return *this;
+         ptr = other.ptr;
+         elements = other.elements;
+         storage = other.storage;
+         repoint();
+         return *this;
+      }
+      ArrayView& operator=(ArrayView&& other) {
+         if (this == &other) return *this;
+         ptr = other.ptr;
+         elements = other.elements;
+         storage = std::move(other.storage);
+         repoint();
+         other.clear();
+         return *this;
+      }
+
+      const T* begin() const {return ptr;}
+      void clear() {ptr = NULL; elements = 0; storage.clear();}
+      const T* data() const {return ptr;}
+      const T* end() const {return ptr+elements;}
+      bool isZeroCopy() const {return elements > 0 && storage.size() == 0;}
+      uint64_t size() const {return elements;}
+      const T& operator[](const uint64_t& i) const {return ptr[i];}
+
+    private:
+      friend class Reader;
+
+      /** Point the view to its own copy of the data, if it has one. Copies and 
+       * moves must not point to the data owned by the source view.*/
+      void repoint() {if (storage.size() > 0) ptr = storage.data();}
+
+      const T* ptr;                   /**< Pointer to the first value.*/
+      uint64_t elements;              /**< Number of values in the view.*/
+      std::vector<T> storage;         /**< Converted copy of the data, empty if the view points to the mapped file.*/
+   };
+
    class Reader {
     public:
       Reader();
       virtual ~Reader();
    
+      bool adviseArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                       const fileio::advice::type& hint);
       virtual bool close();
       virtual bool getArrayAttributes(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribsIn,
                                       std::map<std::string,std::string>& attribsOut) const;
       virtual bool getArrayInfo(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
                                 uint64_t& arraySize,uint64_t& vectorSize,datatype::type& dataType,uint64_t& byteSize);
+      bool getCellPositions(const std::string& meshName,const std::vector<uint64_t>& cellIDs,std::vector<uint64_t>& positions);
       virtual const std::string getErrorString() const;
       virtual bool getFileName(std::string& openFile) const;
       virtual bool getUniqueAttributeValues(const std::string& tagName,const std::string& attribName,std::set<std::string>& output) const;
@@ -46,21 +109,45 @@ namespace vlsv {
       virtual bool open(const std::string& fname);
       virtual bool readArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
                              const uint64_t& begin,const uint64_t& amount,char* buffer);
+      virtual bool readArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                             const uint64_t& begin,const uint64_t& amount,const uint64_t& firstComponent,
+                             const uint64_t& components,char* buffer);
+      virtual bool readRanges(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                              const std::vector<std::pair<uint64_t,uint64_t> >& ranges,const std::vector<char*>& buffers);
+      bool setConcurrentReads(const bool& concurrentReads);
+      bool setMaxRangeGap(const uint64_t& maxGapBytes);
+      bool setMemoryMapping(const bool& memoryMapping);
 
       template<typename T>
       bool read(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
                 const uint64_t& begin,const uint64_t& amount,T*& buffer,bool allocateMemory=true);
       template<typename T>
+      bool readCells(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                     const std::vector<uint64_t>& cellIDs,T*& buffer,bool allocateMemory=true);
+      template<typename T>
       bool readParameter(const std::string& parameterName,T& value);
+      template<typename T>
+      bool view(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                const uint64_t& begin,const uint64_t& amount,ArrayView<T>& output);
    
     protected:
+      std::mutex cacheMutex;          /**< Protects chunk table cache and subfiles in concurrent reads.*/
+      bool concurrentReads;           /**< If true, readArray may be called by several threads simultaneously.*/
       unsigned char endiannessFile;   /**< Endianness in VLSV file.*/
       unsigned char endiannessReader; /**< Endianness of computer which reads the data.*/
       error::type lastErrorCode;      /**< Code indicating last error that has occurred, if any.*/
+      int fileDescriptor;             /**< Descriptor of the input file used for positional reads, negative if not open.*/
+      std::string fileIdentity;       /**< Identity of the input file in BlockCache, empty if caching is not possible.*/
       std::fstream filein;            /**< Input file stream.*/
       std::string fileName;           /**< Name of the input file.*/
+      std::string filePath;           /**< Name of the input file including path, as given to open.*/
       bool fileOpen;                  /**< If true, a file is currently open.*/
-      bool swapIntEndianness;         /**< If true, endianness should be swapped on read data (not implemented yet).*/
+      uint64_t mappedBytes;           /**< Byte size of the memory-mapped input file.*/
+      const char* mappedData;         /**< Pointer to the memory-mapped input file, NULL if the file is not mapped.*/
+      uint64_t maxRangeGap;           /**< Largest gap in bytes between array ranges that readRanges reads with a single read.*/
+      bool memoryMapping;             /**< If true, input files are memory-mapped when opened.*/
+      std::mutex streamMutex;         /**< Protects input file stream in concurrent reads if positional reads are not available.*/
+      bool swapIntEndianness;         /**< If true, file endianness differs from native endianness and read data is byte-swapped.*/
       muxml::MuXML xmlReader;         /**< XML reader used to parse VLSV footer.*/
    
       /** Struct used to store information on the currently open array.*/
@@ -72,7 +159,75 @@ namespace vlsv {
          uint64_t arraySize;
          uint64_t vectorSize;
          uint64_t dataSize;
+         std::string codec;           /**< Name of the codec used to compress the array, empty if not compressed.*/
+         uint64_t chunks;             /**< Number of compressed chunks in the array.*/
+         uint64_t chunkSize;          /**< Number of array elements in each chunk except the last one, 
+                                       * zero if chunks may have different sizes.*/
+         uint64_t chunkTableOffset;   /**< Offset of the chunk table relative to file start.*/
+         std::string filter;          /**< Name of the filter applied to chunks before compression, empty if none.*/
+         uint64_t subfiles;           /**< Number of subfiles the array is stored in, zero or one if 
+                                       * the array is stored in the input file.*/
+         std::vector<uint64_t> subfileOffsets;  /**< Offset of the array in each subfile.*/
+         std::vector<uint64_t> subfileElements; /**< Number of array elements in each subfile.*/
       } arrayOpen;
+
+      /** Chunk table of a compressed array.*/
+      struct ChunkTable {
+         uint64_t chunkSize;                  /**< Number of array elements in each chunk except the last one, 
+                                               * zero if chunks may have different sizes.*/
+         std::vector<uint64_t> entries;       /**< Chunk table entries, see vlsv::chunktable.*/
+         std::vector<uint64_t> firstElement;  /**< Index of the first array element in each chunk. Contains 
+                                               * an extra entry that is equal to the array size.*/
+      };
+
+      /** Entry of the array lookup index, see buildArrayIndex.*/
+      struct ArrayIndexEntry {
+         muxml::XMLNode* node;                /**< XML tag of the array.*/
+         ArrayOpen info;                      /**< Pre-parsed metadata of the array.*/
+         bool valid;                          /**< If false, the XML tag did not contain valid array metadata.*/
+      };
+      std::vector<ArrayIndexEntry> arrayIndex;  /**< Index entry of each array, in the order muxml::MuXML::find visits them.*/
+      bool arrayIndexValid;                     /**< If false, footer could not be indexed and arrays are searched from the XML tree.*/
+      std::unordered_map<std::string,std::vector<size_t> > arraysByName; /**< Indices of arrays in arrayIndex, 
+                                                                          * keyed by tag name and attribute 'name'.*/
+      std::unordered_map<std::string,std::vector<size_t> > arraysByMesh; /**< Indices of arrays in arrayIndex, keyed by 
+                                                                          * tag name and attributes 'name' and 'mesh'.*/
+      /** Global cell IDs of a mesh sorted in ascending order, see getCellPositions.*/
+      struct CellIndex {
+         std::vector<uint64_t> cellIDs;       /**< Global IDs of the real (non-ghost) cells of the mesh, sorted.*/
+         std::vector<uint64_t> positions;     /**< Position of each cell in variable arrays of the mesh.*/
+      };
+      std::map<std::string,CellIndex> cellIndices; /**< Cell indices that have been built, indexed by mesh name.*/
+      std::map<uint64_t,ChunkTable> chunkTables; /**< Chunk tables that have been read, indexed by table offset.*/
+      std::map<uint64_t,int> subfileDescriptors; /**< File descriptors of subfiles opened for positional reads, indexed by subfile number.*/
+      std::map<uint64_t,std::fstream*> subfileStreams; /**< Subfiles opened as streams if positional reads are not available, 
+                                                        * indexed by subfile number.*/
+
+      void buildArrayIndex();
+      bool buildCellIndex(const std::string& meshName,CellIndex& index);
+      void closeSubfiles();
+
+      bool decodeChunks(const ArrayOpen& info,const ChunkTable& table,const uint64_t& begin,const uint64_t& amount,
+                        const char* span,char* buffer) const;
+      void getChunkRange(const ChunkTable& table,const uint64_t& begin,const uint64_t& amount,
+                         uint64_t& firstChunk,uint64_t& lastChunk) const;
+      const char* getMappedArray(const ArrayOpen& info,const uint64_t& begin,const uint64_t& amount) const;
+      muxml::XMLNode* findArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                                ArrayOpen& info,bool& infoValid) const;
+      std::string getArrayIdentity(const std::string& tagName,const muxml::XMLNode* node) const;
+      muxml::XMLNode* findReadableArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                                        ArrayOpen& info) const;
+      virtual bool loadChunkTable(const ArrayOpen& info,ChunkTable*& table);
+      bool parseArrayInfo(muxml::XMLNode* node,ArrayOpen& info) const;
+      bool readBytes(const uint64_t& offset,const uint64_t& bytes,char* buffer);
+      bool readBlockComponents(const ArrayOpen& info,const uint64_t& begin,const uint64_t& amount,
+                               const uint64_t& firstComponent,const uint64_t& components,char* buffer);
+      bool readChunkedArray(const ArrayOpen& info,const uint64_t& begin,const uint64_t& amount,char* buffer);
+      bool readContiguousArray(const ArrayOpen& info,const muxml::XMLNode* node,const uint64_t& begin,
+                               const uint64_t& amount,char* buffer);
+      bool readFooterIndex(const uint64_t& footerOffset);
+      bool openSubfile(const uint64_t& subfile,int& descriptor,std::fstream*& stream);
+      bool readSubfiledArray(const ArrayOpen& info,const uint64_t& begin,const uint64_t& amount,char* buffer);
    };
 
    template<typename T> inline
@@ -95,25 +250,27 @@ namespace vlsv {
       // Check that requested read is inside the array:
       if (begin > arraySize || (begin+amount) > arraySize) return false;
 
-      // Read data into temporary buffer:
-      char* buffer = new char[amount*vectorSize*dataSize];
-      if (Reader::readArray(tagName,attribs,begin,amount,buffer) == false) {
-         delete [] buffer; buffer = NULL;
+      // If data is stored as T, read it directly to output:
+      if (allocateMemory == true) outBuffer = new T[amount*vectorSize];
+      if (isStoredAs<T>(datatype,dataSize) == true) {
+         if (Reader::readArray(tagName,attribs,begin,amount,reinterpret_cast<char*>(outBuffer)) == true) return true;
+         if (allocateMemory == true) {delete [] outBuffer; outBuffer = NULL;}
          return false;
       }
 
-      // Copy data from temporary buffer to output:
-      if (allocateMemory == true) outBuffer = new T[amount*vectorSize];
-      char* ptr = buffer;
-      for (uint64_t i=0; i<amount; ++i) {
-         for (uint64_t j=0; j<vectorSize; ++j) {
-            convertValue<T>(outBuffer[i*vectorSize+j],ptr,datatype,dataSize,false);	 
-            ptr += dataSize;
-         }
+      // Read data into temporary buffer:
+      char* buffer = new char[amount*vectorSize*dataSize];
+      bool success = Reader::readArray(tagName,attribs,begin,amount,buffer);
+
+      // Convert data from temporary buffer to output:
+      if (success == true && convertArray<T>(outBuffer,buffer,amount*vectorSize,datatype,dataSize,false) == false) {
+         std::cerr << "vlsv::Reader ERROR: Unsupported datatype in read" << std::endl;
+         success = false;
       }
+      if (success == false && allocateMemory == true) {delete [] outBuffer; outBuffer = NULL;}
 
       delete [] buffer; buffer = NULL;
-      return true;
+      return success;
    }
 
    template<typename T> inline
@@ -146,6 +303,118 @@ namespace vlsv {
       return success;
    }
 
+
+   /** Read the values of a variable in the given cells only. Global IDs of the 
+    * cells are converted to positions in the variable array with getCellPositions, 
+    * after which the values are read with readRanges so that nearby cells are 
+    * read with a single file read.
+    * @param tagName Name of the XML tag of the variable, usually "VARIABLE".
+    * @param attribs List of attributes that uniquely determine the variable. Must 
+    * contain attribute 'mesh' that gives the name of the mesh.
+    * @param cellIDs Global IDs of the cells, in any order.
+    * @param outBuffer Buffer in which the values are written, vectorsize values per cell in the order given in cellIDs.
+    * @param allocateMemory If true, outBuffer is allocated here and must be deallocated by the caller.
+    * @return If true, values of all cells were read successfully.*/
+   template<typename T> inline
+   bool Reader::readCells(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                          const std::vector<uint64_t>& cellIDs,T*& outBuffer,bool allocateMemory) {
+      if (allocateMemory == true) outBuffer = NULL;
+      if (cellIDs.size() == 0) return true;
+      const std::string* meshName = NULL;
+      for (std::list<std::pair<std::string,std::string> >::const_iterator it=attribs.begin(); it!=attribs.end(); ++it) {
+         if (it->first == "mesh") meshName = &(it->second);
+      }
+      if (meshName == NULL) {
+         std::cerr << "vlsv::Reader ERROR: Attribute 'mesh' is required in readCells" << std::endl;
+         return false;
+      }
+
+      uint64_t arraySize,vectorSize,dataSize;
+      datatype::type dataType;
+      if (Reader::getArrayInfo(tagName,attribs,arraySize,vectorSize,dataType,dataSize) == false) return false;
+      std::vector<uint64_t> positions;
+      if (getCellPositions(*meshName,cellIDs,positions) == false) return false;
+
+      // Sort cells by their positions and combine consecutive cells into ranges. 
+      // Each distinct cell is read once to a packed buffer:
+      std::vector<size_t> order(positions.size());
+      for (size_t i=0; i<order.size(); ++i) order[i] = i;
+      std::sort(order.begin(),order.end(),[&positions](const size_t& a,const size_t& b) {return positions[a] < positions[b];});
+      std::vector<std::pair<uint64_t,uint64_t> > ranges;
+      std::vector<uint64_t> packedIndex(positions.size());
+      uint64_t N_packed = 0;
+      for (size_t i=0; i<order.size(); ++i) {
+         const uint64_t position = positions[order[i]];
+         if (i > 0 && position == positions[order[i-1]]) {
+            packedIndex[order[i]] = N_packed-1;
+            continue;
+         }
+         if (i > 0 && position == positions[order[i-1]]+1) ++(ranges.back().second);
+         else ranges.push_back(std::make_pair(position,static_cast<uint64_t>(1)));
+         packedIndex[order[i]] = N_packed++;
+      }
+
+      std::vector<char> packed(N_packed*vectorSize*dataSize);
+      std::vector<char*> buffers(ranges.size());
+      uint64_t offset = 0;
+      for (size_t r=0; r<ranges.size(); ++r) {
+         buffers[r] = packed.data() + offset;
+         offset += ranges[r].second*vectorSize*dataSize;
+      }
+      if (Reader::readRanges(tagName,attribs,ranges,buffers) == false) return false;
+
+      // Convert data and copy values of each cell to output:
+      std::vector<T> converted(N_packed*vectorSize);
+      if (convertArray<T>(converted.data(),packed.data(),converted.size(),dataType,dataSize,false) == false) {
+         std::cerr << "vlsv::Reader ERROR: Unsupported datatype in readCells" << std::endl;
+         return false;
+      }
+      if (allocateMemory == true) outBuffer = new T[cellIDs.size()*vectorSize];
+      for (size_t i=0; i<cellIDs.size(); ++i) {
+         for (uint64_t j=0; j<vectorSize; ++j) outBuffer[i*vectorSize+j] = converted[packedIndex[i]*vectorSize+j];
+      }
+      return true;
+   }
+
+   /** Get a read-only view to array data. If the file has been memory-mapped, 
+    * see setMemoryMapping, the array is neither compressed nor stored in subfiles, 
+    * and the data is stored in native endianness as type T, the view points 
+    * directly into the mapped file and no data is copied. Otherwise the data is 
+    * read and converted into a buffer owned by the view, as in Reader::read.
+    * @param tagName Name of the XML tag.
+    * @param attribs Attributes that uniquely determine the array.
+    * @param begin Index of the first array element in the view.
+    * @param amount Number of array elements in the view.
+    * @param output View in which the data is written. The view contains amount*vectorsize values.
+    * @return If true, the view was created successfully.*/
+   template<typename T> inline
+   bool Reader::view(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                     const uint64_t& begin,const uint64_t& amount,ArrayView<T>& output) {
+      output.clear();
+      if (loadArray(tagName,attribs) == false) return false;
+      if (begin > arrayOpen.arraySize || begin+amount > arrayOpen.arraySize) return false;
+      if (amount == 0) return true;
+
+      // Point directly into the mapped file if possible:
+      const char* ptr = NULL;
+      if (isStoredAs<T>(arrayOpen.dataType,arrayOpen.dataSize) == true) ptr = getMappedArray(arrayOpen,begin,amount);
+      if (ptr != NULL && reinterpret_cast<uintptr_t>(ptr) % alignof(T) == 0) {
+         output.ptr = reinterpret_cast<const T*>(ptr);
+         output.elements = amount*arrayOpen.vectorSize;
+         return true;
+      }
+
+      // Fall back to reading and converting the data:
+      output.storage.resize(amount*arrayOpen.vectorSize);
+      T* buffer = output.storage.data();
+      if (read(tagName,attribs,begin,amount,buffer,false) == false) {
+         output.clear();
+         return false;
+      }
+      output.ptr = output.storage.data();
+      output.elements = output.storage.size();
+      return true;
+   }
 } // namespace vlsv
    
 #endif
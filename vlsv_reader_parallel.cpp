@@ -17,20 +17,35 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
+#include <limits>
+#include <sstream>
 #include <string.h>
 
 #include "vlsv_common_mpi.h"
+#include "vlsv_footer.h"
 #include "vlsv_reader_parallel.h"
 
+// Non-blocking collective reads (MPI_File_iread_at_all) were added in MPI 3.1. 
+// With older MPI libraries ireadArray and iendMultiread read with blocking calls:
+#if MPI_VERSION > 3 || (MPI_VERSION == 3 && MPI_SUBVERSION >= 1)
+   #define VLSV_NONBLOCKING_COLLECTIVE_READS
+#endif
+
 using namespace std;
 
 namespace vlsv {
 
+   /** Default constructor for struct ReadRequest.*/
+   ReadRequest::ReadRequest(): active(false),dataSize(0),success(true) { }
+
    /** Default constructor for class ParallelReader.*/
    ParallelReader::ParallelReader(): Reader() {
       multireadStarted = false;
+      nodeComm = MPI_COMM_NULL;
+      nodeLeaderComm = MPI_COMM_NULL;
    }
    
    /** Destructor for class ParallelReader. It closes the input file (if still open).*/
@@ -99,10 +114,45 @@ namespace vlsv {
     * @see startMultiread.
     * @see addMultireadUnit.*/
    bool ParallelReader::endMultiread(const uint64_t& arrayOffset) {
+      return finishMultiread(arrayOffset,NULL);
+   }
+
+   /** End multi-read mode and read the multiread units, or start a non-blocking 
+    * read of them if request is not NULL.
+    * @param arrayOffset Offset into input array relative to array start on file, in units of array elements.
+    * @param request If not NULL, reads are started with non-blocking collectives that 
+    * are added to this request, and byte order swaps are deferred to wait.
+    * @return If true, all processes read (or started to read) their data successfully.*/
+   bool ParallelReader::finishMultiread(const uint64_t& arrayOffset,ReadRequest* request) {
       bool success = true;
       if (multireadStarted == false) success = false;
       if (checkSuccess(success,comm) == false) return false;
 
+      // Compressed arrays and arrays stored in subfiles are read to 
+      // a temporary buffer and then copied to multiread units:
+      if (arrayOpen.codec.size() > 0 || arrayOpen.subfiles > 1) {
+         uint64_t unitBytes = 0;
+         for (auto it=multiReadUnits.begin(); it!=multiReadUnits.end(); ++it) unitBytes += it->amount*arrayOpen.dataSize;
+         vector<char> buffer(unitBytes);
+         const uint64_t amount = unitBytes/(arrayOpen.vectorSize*arrayOpen.dataSize);
+         if (arrayOpen.codec.size() > 0) {
+            if (readChunkedArray(arrayOffset,amount,buffer.data()) == false) success = false;
+         } else {
+            if (readSubfiledArray(arrayOffset,amount,buffer.data()) == false) success = false;
+         }
+
+         if (success == true && swapIntEndianness == true) {
+            swapByteOrder(buffer.data(),unitBytes/arrayOpen.dataSize,arrayOpen.dataSize);
+         }
+         char* ptr = buffer.data();
+         for (auto it=multiReadUnits.begin(); it!=multiReadUnits.end(); ++it) {
+            memcpy(it->array,ptr,it->amount*arrayOpen.dataSize);
+            ptr += it->amount*arrayOpen.dataSize;
+         }
+         multireadStarted = false;
+         return success;
+      }
+
       // Calculate how many collective MPI calls are needed to 
       // read all the data from input file:
       size_t inputBytesize    = 0;
@@ -126,8 +176,7 @@ namespace vlsv {
       multireadList.push_back(make_pair(first,last));
       
       // Reduce the maximum number of needed collective reads to all processes:
-      size_t N_collectiveCalls;
-      MPI_Allreduce(&myCollectiveCalls,&N_collectiveCalls,1,MPI_Type<size_t>(),MPI_MAX,comm);
+      const size_t N_collectiveCalls = getCollectiveCalls(myCollectiveCalls,comm);
 
       // If more collective calls are made than what this process needs, 
       // insert dummy reads to the end of multireadList:
@@ -144,16 +193,76 @@ namespace vlsv {
                                                                          // this process starts to read data from.
 
       for (size_t i=0; i<multireadList.size(); ++i) {
-         if (flushMultiread(i,unitOffset,multireadList[i].first,multireadList[i].second) == false) success = false;
+         if (flushMultiread(i,unitOffset,multireadList[i].first,multireadList[i].second,request) == false) success = false;
          for (auto it=multireadList[i].first; it!=multireadList[i].second; ++it) {
             unitOffset += it->amount*arrayOpen.dataSize;
          }
       }
 
+      // Convert data in multiread units to native endianness. For 
+      // non-blocking reads the conversion is done in wait:
+      if (swapIntEndianness == true) {
+         for (auto it=multiReadUnits.begin(); it!=multiReadUnits.end(); ++it) {
+            if (request == NULL) swapByteOrder(it->array,it->amount,arrayOpen.dataSize);
+            else request->swaps.push_back(make_pair(it->array,it->amount));
+         }
+      }
+
       multireadStarted = false;
       return checkSuccess(success,comm);
    }
 
+   /** Broadcast the file footer from master process to all other processes. 
+    * Master process serializes the footer as a binary footer index, or as XML 
+    * if the footer can not be written as an index, and the other processes 
+    * rebuild the footer and the array index from it.
+    * @return If true, all processes have the footer. All processes return the same value.*/
+   bool ParallelReader::broadcastFooter() {
+      bool success = true;
+      
+      // Master serializes the footer. The first header entry tells the format, 
+      // zero for binary footer index and one for XML:
+      uint64_t header[2] = {0,0};
+      vector<char> footer;
+      if (myRank == masterRank) {
+         if (encodeFooterIndex(xmlReader,footer) == false) {
+            stringstream ss;
+            xmlReader.print(ss);
+            const string xml = ss.str();
+            footer.assign(xml.begin(),xml.end());
+            header[0] = 1;
+         }
+         header[1] = footer.size();
+      }
+      MPI_Bcast(header,2,MPI_Type<uint64_t>(),masterRank,comm);
+      
+      // Broadcast the footer in pieces whose size fits into an int:
+      footer.resize(header[1]);
+      const uint64_t maxBytes = numeric_limits<int>::max();
+      for (uint64_t offset=0; offset<footer.size(); offset+=maxBytes) {
+         const int bytes = min(maxBytes,footer.size()-offset);
+         MPI_Bcast(footer.data()+offset,bytes,MPI_Type<char>(),masterRank,comm);
+      }
+
+      if (myRank != masterRank) {
+         xmlReader.clear();
+         if (header[0] == 0) {
+            if (footer.size() < footerindex::TRAILER_BYTES) success = false;
+            else success = decodeFooterIndex(footer.data(),footer.size()-footerindex::TRAILER_BYTES,xmlReader);
+         } else {
+            istringstream in(string(footer.begin(),footer.end()));
+            success = xmlReader.read(in);
+         }
+         if (success == true) {
+            buildArrayIndex();
+            fileOpen = true;
+         } else {
+            cerr << "ERROR in vlsv::ParallelReader! Failed to rebuild file footer on process #" << myRank << endl;
+         }
+      }
+      return checkSuccess(success,comm);
+   }
+
    /** Close the input file.
     * @return If true, the input file was closed successfully.
     * @see vlsv::ParallelReader::open().*/
@@ -164,62 +273,25 @@ namespace vlsv {
          parallelFileOpen = false;
       }
 
-      if (myRank == masterRank) filein.close();
+      // Free arrays read with readReplicated:
+      for (list<MPI_Win>::iterator it=replicatedWindows.begin(); it!=replicatedWindows.end(); ++it) MPI_Win_free(&(*it));
+      replicatedWindows.clear();
+      if (nodeComm != MPI_COMM_NULL) MPI_Comm_free(&nodeComm);
+      if (nodeLeaderComm != MPI_COMM_NULL) MPI_Comm_free(&nodeLeaderComm);
+
+      Reader::close();
       return true;
    }
 
-   /** Get the XML attributes for the given array on all processes. The file 
-    * footer is read by master process only, who then broadcasts the contents 
-    * to all processes. This function returns the same value on all processes.
-    * @param tagName Name of the array's XML tag. Only significant on master process.
-    * @param attribsIn XML tag attributes that uniquely define the array. Only significant on master process.
-    * @param attribsOut XML tag attributes read from the input file. The contents of attribsOut will be the same on all processes.
-    * @return If true, array attributes were read successfully. All processes return the same value.*/
+   /** Get the XML attributes for the given array. The file footer has been 
+    * broadcast to all processes in open, so this function does not communicate.
+    * @param tagName Name of the array's XML tag.
+    * @param attribsIn XML tag attributes that uniquely define the array.
+    * @param attribsOut XML tag attributes read from the input file.
+    * @return If true, array attributes were read successfully.*/
    bool ParallelReader::getArrayAttributes(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribsIn,
                                            std::map<std::string,std::string>& attribsOut) const {
-      bool success = true;
-   
-      // Master process reads footer:
-      if (myRank == masterRank) {
-         success = Reader::getArrayAttributes(tagName,attribsIn,attribsOut);
-      }
-
-      // Check that master process read array attributes correctly:
-      int globalSuccess = 0;
-      if (success == true) globalSuccess = 1;
-      MPI_Bcast(&globalSuccess,1,MPI_Type<int>(),masterRank,comm);
-      if (globalSuccess == 0) return false;
-
-      // Master process distributes contents of map attribsOut to all processes:
-      // Broadcast number of entries in attribsOut:
-      size_t N_attribs = 0;
-      if (myRank == masterRank) N_attribs = attribsOut.size();
-      MPI_Bcast(&N_attribs,1,MPI_Type<size_t>(),masterRank,comm);
-      
-      const unsigned int maxLength = 512;
-      char attribName[maxLength];
-      char attribValue[maxLength];
-      if (myRank == masterRank) {
-         for (auto& it: attribsOut) {
-            #ifdef WINDOWS
-               strncpy_s(attribName ,maxLength,it.first.c_str() ,it.first.size() );
-               strncpy_s(attribValue,maxLength,it.second.c_str(),it.second.size());
-            #else
-               strncpy(attribName ,it.first.c_str() ,maxLength-1);
-               strncpy(attribValue,it.second.c_str(),maxLength-1);
-            #endif
-            MPI_Bcast(attribName,maxLength,MPI_Type<char>(),masterRank,comm);
-            MPI_Bcast(attribValue,maxLength,MPI_Type<char>(),masterRank,comm);
-         }
-      } else {
-         for (size_t i=0; i<N_attribs; ++i) {
-            MPI_Bcast(attribName,maxLength,MPI_Type<char>(),masterRank,comm);
-            MPI_Bcast(attribValue,maxLength,MPI_Type<char>(),masterRank,comm);
-            attribsOut[attribName] = attribValue;
-         }
-      }
-   
-      return success;
+      return Reader::getArrayAttributes(tagName,attribsIn,attribsOut);
    }
 
    bool ParallelReader::getArrayInfoMaster(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
@@ -231,41 +303,26 @@ namespace vlsv {
       return Reader::getArrayInfo(tagName,attribs,arraySize,vectorSize,dataType,dataSize);
    }
 
-   /** Read array metadata to all processes.
-    * @param tagName Name of the XML tag corresponding to the array. Only significant on master process.
-    * @param attribs A list of attribute,value pairs that uniquely identify the array. Only significant on master process.
-    * @return If true, array metadata was read successfully. All processes return the same value.*/
+   /** Get array metadata. The file footer has been broadcast to all processes 
+    * in open, so each process finds the array in its own copy of the footer 
+    * without communication. Functions that read array data call this function 
+    * on all processes with the same tagName and attribs, so all processes get 
+    * the same metadata.
+    * @param tagName Name of the XML tag corresponding to the array.
+    * @param attribs A list of attribute,value pairs that uniquely identify the array.
+    * @return If true, array metadata was found.*/
    bool ParallelReader::getArrayInfo(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs) {
-      bool success = true;
-      if (myRank == masterRank) {
-         success = Reader::loadArray(tagName,attribs);
-      }
-
-      // Check that master read array info correctly:
-      int globalSuccess = 0;
-      if (success == true) globalSuccess = 1;
-      MPI_Bcast(&globalSuccess,1,MPI_Type<int>(),masterRank,comm);
-      if (globalSuccess == 0) success = false;
-      if (success == false) return false;
-
-      // Master broadcasts array info to all processes:
-      MPI_Bcast(&arrayOpen.offset,    1,MPI_Type<streamoff>(),masterRank,comm);
-      MPI_Bcast(&arrayOpen.arraySize, 1,MPI_Type<uint64_t>(), masterRank,comm);
-      MPI_Bcast(&arrayOpen.vectorSize,1,MPI_Type<uint64_t>(), masterRank,comm);
-      MPI_Bcast(&arrayOpen.dataType,  1,MPI_Type<int>(),      masterRank,comm);
-      MPI_Bcast(&arrayOpen.dataSize,  1,MPI_Type<uint64_t>(), masterRank,comm);
-      return success;
+      return Reader::loadArray(tagName,attribs);
    }
 
-   /** Read array metadata to all processes.
-    * @param Name of the array's XML tag. Only significant on master process.
-    * @param attribs A list of attribute,value pairs that uniquely identify the array. Only significant on master process.
-    * @param arraySize Total number of elements in array. Same value on all processes upon successful exit.
-    * @param vectorSize Size of the data vector in array. Same value on all processes upon successful exit.
-    * @param dataType Datatype of each vector element. Same value on all processes upon successful exit.
-    * @param byteSize Byte size of the datatype. Same value on all processes upon successful exit.
-    * @return If true, array metadata was successfully read and output variables contain meaningful values.
-    * Same return value is returned on all processes.*/
+   /** Get array metadata. This function does not communicate, see getArrayInfo above.
+    * @param tagName Name of the array's XML tag.
+    * @param attribs A list of attribute,value pairs that uniquely identify the array.
+    * @param arraySize Total number of elements in array.
+    * @param vectorSize Size of the data vector in array.
+    * @param dataType Datatype of each vector element.
+    * @param byteSize Byte size of the datatype.
+    * @return If true, array metadata was successfully read and output variables contain meaningful values.*/
    bool ParallelReader::getArrayInfo(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
                                      uint64_t& arraySize,uint64_t& vectorSize,datatype::type& dataType,uint64_t& byteSize) {
       if (getArrayInfo(tagName,attribs) == false) return false;
@@ -297,57 +354,86 @@ namespace vlsv {
       return readTime;
    }
 
-   /** Get unique XML attribute values for given tag name. This function 
-    * must be called by all processes simultaneously.
-    * @param tagName Name of the XML tag. Only significant on master process.
-    * @param attribName Name of the attribute. Only significant on master process.
-    * @param output Unique attribute values are inserted here. The content will be the same on all processes.
-    * @return If true, attribute values were read successfully. All processes return the same value.*/
+   /** Get unique XML attribute values for given tag name. The file footer has 
+    * been broadcast to all processes in open, so this function does not communicate.
+    * @param tagName Name of the XML tag.
+    * @param attribName Name of the attribute.
+    * @param output Unique attribute values are inserted here.
+    * @return If true, attribute values were read successfully.*/
    bool ParallelReader::getUniqueAttributeValues(const std::string& tagName,const std::string& attribName,
                                                  std::set<std::string>& output) const {
-      bool success = true;
+      return Reader::getUniqueAttributeValues(tagName,attribName,output);
+   }
 
-      // First the master process reads unique attribute values:                                              
-      if (myRank == masterRank) {
-         success = Reader::getUniqueAttributeValues(tagName,attribName,output);
+   /** End multi-read mode and start non-blocking collective reads of the multiread units. 
+    * This function is otherwise identical to endMultiread, but the data is only valid 
+    * after wait has been called for the request. Multiread units of compressed arrays and 
+    * arrays stored in subfiles are read before this function returns.
+    * @param arrayOffset Offset into input array relative to array start on file, in units of array elements.
+    * @param request Request that is completed with wait. Must not be active.
+    * @return If true, all processes started to read their data successfully. All processes return the same value.
+    * If false is returned, the request does not need to be completed.
+    * @see endMultiread.
+    * @see wait.*/
+   bool ParallelReader::iendMultiread(const uint64_t& arrayOffset,ReadRequest& request) {
+      if (startRequest(request) == false) return false;
+      request.dataSize = arrayOpen.dataSize;
+      if (finishMultiread(arrayOffset,&request) == false) {
+         wait(request);
+         return false;
       }
+      return true;
+   }
 
-      // Check that master read array info correctly:
-      uint8_t masterSuccess = 0;
-      if (success == true) masterSuccess = 1;
-      MPI_Bcast(&masterSuccess,1,MPI_Type<uint8_t>(),masterRank,comm);
-      if (masterSuccess == 0) success = false;
-      if (success == false) return false;
-
-      // Master broadcasts number of entries in set 'output':
-      size_t N_entries = output.size();
-      MPI_Bcast(&N_entries,1,MPI_Type<size_t>(),masterRank,comm);
+   /** Start a non-blocking collective read of an array. All processes in the communicator 
+    * must call this function, and non-blocking reads must be started in the same order on 
+    * all processes. Data in buffer is valid only after wait has been called for the request, 
+    * which allows, e.g., unpacking the previous variable while the next one is being read.
+    * Compressed arrays and arrays stored in subfiles are read before this function returns.
+    * Pending requests must be completed before calling functions that change the file 
+    * view, i.e., readRanges or readArray for a subset of vector components.
+    * @param tagName Array XML tag name in VLSV file. Must be the same on all processes.
+    * @param attribs Additional attributes that uniquely define the array in file. Must be the same on all processes.
+    * @param begin Index of first array element this process reads.
+    * @param amount Number of array elements this process reads.
+    * @param buffer Buffer in which data is read, must not be accessed before wait.
+    * @param request Request that is completed with wait. Must not be active.
+    * @return If true, all processes started to read their data successfully. All processes return the same value.
+    * If false is returned, the request does not need to be completed.
+    * @see wait.*/
+   bool ParallelReader::ireadArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                                   const uint64_t& begin,const uint64_t& amount,char* buffer,ReadRequest& request) {
+      if (startRequest(request) == false) return false;
+      if (getArrayInfo(tagName,attribs) == false) {
+         request.active = false;
+         return false;
+      }
+      request.dataSize = arrayOpen.dataSize;
 
-      // Master broadcasts values in set 'output' to all other processes
-      // who insert the received values to set 'output':
-      const unsigned int maxLength = 512;
-      char attribValue[maxLength];
-      if (myRank == masterRank) {
-         for (auto& it: output) {
-            #ifdef WINDOWS
-               strncpy_s(attribValue,maxLength,it.c_str(),it.size());
-            #else
-               strncpy(attribValue,it.c_str(),maxLength-1);
-            #endif
-            MPI_Bcast(attribValue,maxLength,MPI_Type<char>(),masterRank,comm);
-         }
+      bool success = true;
+      if (arrayOpen.codec.size() > 0 || arrayOpen.subfiles > 1) {
+         if (arrayOpen.codec.size() > 0) success = readChunkedArray(begin,amount,buffer);
+         else success = readSubfiledArray(begin,amount,buffer);
       } else {
-         for (size_t i=0; i<N_entries; ++i) {
-            MPI_Bcast(attribValue,maxLength,MPI_Type<char>(),masterRank,comm);
-            output.insert(attribValue);
-         }
+         const MPI_Offset start = arrayOpen.offset + begin*arrayOpen.vectorSize*arrayOpen.dataSize;
+         const uint64_t readBytes = amount*arrayOpen.vectorSize*arrayOpen.dataSize;
+         if (readCollective(start,readBytes,buffer,&request) == false) success = false;
+         success = checkSuccess(success,comm);
       }
 
-      return success;
+      // Convert data to native endianness after the read has completed:
+      if (swapIntEndianness == true) request.swaps.push_back(make_pair(buffer,amount*arrayOpen.vectorSize));
+
+      if (success == false) {
+         wait(request);
+         return false;
+      }
+      return true;
    }
 
    bool ParallelReader::flushMultiread(const size_t& unit,const MPI_Offset& fileOffset,
-                                       std::list<Multi_IO_Unit>::iterator& start,std::list<Multi_IO_Unit>::iterator& stop) {
+                                       std::list<Multi_IO_Unit>::iterator& start,std::list<Multi_IO_Unit>::iterator& stop,
+                                       ReadRequest* request) {
       bool success = true;
 
       // Count the number of multi-read units read:
@@ -357,7 +443,7 @@ namespace vlsv {
       }
 
       // Create an MPI datatype for reading all units with a single collective call:
-      int* blockLengths       = new int[N_multiReadUnits];
+      uint64_t* blockLengths  = new uint64_t[N_multiReadUnits];
       MPI_Aint* displacements = new MPI_Aint[N_multiReadUnits];
       MPI_Datatype* datatypes = new MPI_Datatype[N_multiReadUnits];
 
@@ -383,12 +469,13 @@ namespace vlsv {
       if (N_multiReadUnits > 0) {
          // Create an MPI struct containing the multiread units:
          MPI_Datatype inputType;
-         MPI_Type_create_struct(N_multiReadUnits,blockLengths,displacements,datatypes,&inputType);
+         typeCreateStruct(N_multiReadUnits,blockLengths,displacements,datatypes,&inputType);
          MPI_Type_commit(&inputType);
 
-         // Read data from output file with a single collective call:
+         // Read data from output file with a single collective call. The datatype 
+         // can be freed before a non-blocking read completes:
          const auto t_start = MPI_Wtime();
-         MPI_File_read_at_all(filePtr,fileOffset,multireadOffsetPointer,1,inputType,MPI_STATUS_IGNORE);
+         if (readAtAll(fileOffset,multireadOffsetPointer,1,inputType,-1,request) == false) success = false;
          readTime += (MPI_Wtime() - t_start);
          MPI_Type_free(&inputType);
          
@@ -396,7 +483,7 @@ namespace vlsv {
       } else {
          // Process has no data to read but needs to participate in the collective call to prevent deadlock:
          const auto t_start = MPI_Wtime();
-         MPI_File_read_at_all(filePtr,fileOffset,NULL,0,MPI_BYTE,MPI_STATUS_IGNORE);
+         if (readAtAll(fileOffset,NULL,0,MPI_BYTE,-1,request) == false) success = false;
          readTime += (MPI_Wtime() - t_start);
       }
 
@@ -406,6 +493,34 @@ namespace vlsv {
       return success;
    }
 
+   /** Read the chunk table of a compressed array to all processes. Master process 
+    * reads the table and broadcasts it to all other processes.
+    * @param info Metadata of the array, must have the same value on all processes.
+    * @param table Variable in which a pointer to the chunk table is written.
+    * @return If true, the chunk table was read successfully. All processes return the same value.*/
+   bool ParallelReader::loadChunkTable(const ArrayOpen& info,ChunkTable*& table) {
+      bool success = true;
+      if (myRank == masterRank) {
+         if (Reader::loadChunkTable(info,table) == false) success = false;
+      } else {
+         table = &(chunkTables[info.chunkTableOffset]);
+      }
+
+      uint8_t masterSuccess = 0;
+      if (success == true) masterSuccess = 1;
+      MPI_Bcast(&masterSuccess,1,MPI_Type<uint8_t>(),masterRank,comm);
+      if (masterSuccess == 0) return false;
+
+      table->chunkSize = info.chunkSize;
+      table->entries.resize(info.chunks*chunktable::SIZE);
+      table->firstElement.resize(info.chunks+1);
+      if (info.chunks > 0) {
+         MPI_Bcast(table->entries.data(),table->entries.size(),MPI_Type<uint64_t>(),masterRank,comm);
+         MPI_Bcast(table->firstElement.data(),table->firstElement.size(),MPI_Type<uint64_t>(),masterRank,comm);
+      }
+      return true;
+   }
+
    /** Open a VLSV file for parallel reading.
     * @param fname Name of the VLSV file. Only significant on master process.
     * @param comm MPI communicator used in collective MPI operations.
@@ -425,6 +540,7 @@ namespace vlsv {
 
       // Attempt to open the given input file using MPI:
       fileName = fname;
+      filePath = fname;
       int accessMode = MPI_MODE_RDONLY;
       if (MPI_File_open(comm,const_cast<char*>(fileName.c_str()),accessMode,mpiInfo,&filePtr) != MPI_SUCCESS) success = false;
       else parallelFileOpen = true;
@@ -440,9 +556,12 @@ namespace vlsv {
 
       // Broadcast file endianness to all processes:
       MPI_Bcast(&endiannessFile,1,MPI_Type<unsigned char>(),masterRank,comm);
+      swapIntEndianness = (endiannessFile != endiannessReader);
 
+      // Broadcast file footer so that all processes can look up array metadata locally:
       bytesRead = 0;
-      return checkSuccess(success,this->comm);
+      if (checkSuccess(success,this->comm) == false) return false;
+      return broadcastFooter();
    }
 
    bool ParallelReader::readArrayMaster(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
@@ -457,8 +576,8 @@ namespace vlsv {
 
    /** Read data from an array in VLSV file using collective MPI file I/O operations.
     * XML tag name and contents of list 'attribs' need to uniquely define the array.
-    * @param tagName Array XML tag name. Only significant on master process.
-    * @param attribs Additional attributes limiting array search. Only significant on master process.
+    * @param tagName Array XML tag name. Must be the same on all processes.
+    * @param attribs Additional attributes limiting array search. Must be the same on all processes.
     * @param begin First array element read, i.e. this process' offset into the array.
     * @param amount Number of array elements to read.
     * @param buffer Buffer in which data is read from VLSV file.
@@ -469,9 +588,659 @@ namespace vlsv {
 
       // Fetch array info to all processes:
       if (getArrayInfo(tagName,attribs) == false) return false;
-      const MPI_Offset start = arrayOpen.offset + begin*arrayOpen.vectorSize*arrayOpen.dataSize;
-      const uint64_t readBytes = amount*arrayOpen.vectorSize*arrayOpen.dataSize;
+      if (arrayOpen.codec.size() > 0) {
+         success = readChunkedArray(begin,amount,buffer);
+      } else if (arrayOpen.subfiles > 1) {
+         success = readSubfiledArray(begin,amount,buffer);
+      } else {
+         const MPI_Offset start = arrayOpen.offset + begin*arrayOpen.vectorSize*arrayOpen.dataSize;
+         const uint64_t readBytes = amount*arrayOpen.vectorSize*arrayOpen.dataSize;
+         if (readCollective(start,readBytes,buffer) == false) success = false;
+         success = checkSuccess(success,comm);
+      }
+
+      // Convert data to native endianness:
+      if (success == true && swapIntEndianness == true) {
+         swapByteOrder(buffer,amount*arrayOpen.vectorSize,arrayOpen.dataSize);
+      }
+      return success;
+   }
+
+   /** Read the given components of the given elements of an array using collective 
+    * MPI file I/O. Uncompressed arrays are read through a strided file view, so that 
+    * only the requested components are read from the file. Compressed arrays and arrays 
+    * stored in subfiles are read as whole elements and the components are copied to output. 
+    * All processes must call this function simultaneously.
+    * @param tagName Array XML tag name. Must be the same on all processes.
+    * @param attribs Additional attributes limiting array search. Must be the same on all processes.
+    * @param begin First array element read, i.e. this process' offset into the array.
+    * @param amount Number of array elements to read.
+    * @param firstComponent Index of the first read vector component.
+    * @param components Number of read vector components, must be the same on all processes.
+    * @param buffer Buffer in which data is read, contains amount*components values.
+    * @return If true, array contents were successfully read. All processes return the same value.*/
+   bool ParallelReader::readArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                                  const uint64_t& begin,const uint64_t& amount,const uint64_t& firstComponent,
+                                  const uint64_t& components,char* buffer) {
+      bool success = true;
+      if (getArrayInfo(tagName,attribs) == false) return false;
+      if (components == 0 || firstComponent + components > arrayOpen.vectorSize) {
+         cerr << "ERROR in vlsv::ParallelReader! Requested components exceed vector size" << endl;
+         success = false;
+      }
+      if (begin + amount > arrayOpen.arraySize) {
+         cerr << "ERROR in vlsv::ParallelReader! Requested read exceeds array size" << endl;
+         success = false;
+      }
+      if (checkSuccess(success,comm) == false) return false;
+
+      const uint64_t elementBytes   = arrayOpen.vectorSize*arrayOpen.dataSize;
+      const uint64_t componentBytes = components*arrayOpen.dataSize;
+      if (arrayOpen.codec.size() > 0 || arrayOpen.subfiles > 1) {
+         vector<char> elements(amount*elementBytes);
+         if (arrayOpen.codec.size() > 0) success = readChunkedArray(begin,amount,elements.data());
+         else success = readSubfiledArray(begin,amount,elements.data());
+         for (uint64_t i=0; i<amount && success == true; ++i) {
+            memcpy(buffer+i*componentBytes,&(elements[i*elementBytes+firstComponent*arrayOpen.dataSize]),componentBytes);
+         }
+      } else {
+         // Each element of the file view contains the requested components of one array element:
+         MPI_Datatype components_t,fileType;
+         MPI_Type_contiguous(componentBytes,MPI_BYTE,&components_t);
+         MPI_Type_create_resized(components_t,0,elementBytes,&fileType);
+         MPI_Type_commit(&fileType);
+         MPI_Type_free(&components_t);
+         const MPI_Offset displacement = arrayOpen.offset + begin*elementBytes + firstComponent*arrayOpen.dataSize;
+         if (MPI_File_set_view(filePtr,displacement,MPI_BYTE,fileType,const_cast<char*>("native"),MPI_INFO_NULL) != MPI_SUCCESS) {
+            success = false;
+         }
+
+         // Read data, each collective call reads at most getMaxBytesPerRead() bytes:
+         const uint64_t maxBytes = getMaxBytesPerRead() / componentBytes * componentBytes;
+         const uint64_t bytes = amount*componentBytes;
+         const uint64_t myCalls = max(static_cast<uint64_t>(1),(bytes+maxBytes-1)/maxBytes);
+         const uint64_t N_calls = getCollectiveCalls(myCalls,comm);
+         const double t_start = MPI_Wtime();
+         for (uint64_t c=0; c<N_calls; ++c) {
+            const uint64_t position = min(c*maxBytes,bytes);
+            const uint64_t readSize = min(maxBytes,bytes-position);
+            char* pos = (readSize > 0) ? buffer+position : NULL;
+            MPI_Status status;
+            if (fileReadAtAll(filePtr,position,pos,readSize,MPI_BYTE,&status) != MPI_SUCCESS) success = false;
+            const int64_t bytesReceived = getCount(status,MPI_BYTE);
+            if (bytesReceived != static_cast<int64_t>(readSize)) {
+               cerr << "ERROR in vlsv::ParallelReader! I only got " << bytesReceived << "/" << readSize << " bytes of array '";
+               cerr << arrayOpen.tagName << "' components" << endl;
+               success = false;
+            }
+         }
+         readTime  += (MPI_Wtime() - t_start);
+         bytesRead += bytes;
+
+         // Restore the default file view:
+         MPI_File_set_view(filePtr,0,MPI_BYTE,MPI_BYTE,const_cast<char*>("native"),MPI_INFO_NULL);
+         MPI_Type_free(&fileType);
+      }
+      success = checkSuccess(success,comm);
+
+      // Convert data to native endianness:
+      if (success == true && swapIntEndianness == true) {
+         swapByteOrder(buffer,amount*components,arrayOpen.dataSize);
+      }
+      return success;
+   }
+
+   /** Read several parts of an array using collective MPI file I/O. Each process 
+    * gives its own ranges, which are read with a single file view so that the 
+    * MPI library can combine nearby ranges of all processes into large file 
+    * accesses. Data is scattered directly to the output buffers. Ranges may be 
+    * given in any order and may overlap. Compressed arrays 
+    * and arrays stored in subfiles are read range by range. All processes must 
+    * call this function simultaneously.
+    * @param tagName Array XML tag name. Must be the same on all processes.
+    * @param attribs Additional attributes limiting array search. Must be the same on all processes.
+    * @param ranges Index of the first array element and number of array elements in each range.
+    * @param buffers Buffer in which each range is copied.
+    * @return If true, all ranges were successfully read. All processes return the same value.*/
+   bool ParallelReader::readRanges(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                                   const std::vector<std::pair<uint64_t,uint64_t> >& ranges,const std::vector<char*>& buffers) {
+      bool success = true;
+      if (getArrayInfo(tagName,attribs) == false) return false;
+
+      if (ranges.size() != buffers.size()) {
+         cerr << "ERROR in vlsv::ParallelReader! Number of ranges and buffers differ in readRanges" << endl;
+         success = false;
+      }
+      for (size_t r=0; r<ranges.size() && success == true; ++r) {
+         if (ranges[r].first + ranges[r].second > arrayOpen.arraySize) {
+            cerr << "ERROR in vlsv::ParallelReader! Requested range exceeds array size" << endl;
+            success = false;
+         }
+      }
+      if (checkSuccess(success,comm) == false) return false;
 
+      if (arrayOpen.codec.size() > 0 || arrayOpen.subfiles > 1) {
+         // Each range is read with a separate collective call:
+         uint64_t myRanges = ranges.size();
+         uint64_t N_ranges;
+         MPI_Allreduce(&myRanges,&N_ranges,1,MPI_Type<uint64_t>(),MPI_MAX,comm);
+         for (uint64_t r=0; r<N_ranges; ++r) {
+            const uint64_t begin  = (r < myRanges) ? ranges[r].first : 0;
+            const uint64_t amount = (r < myRanges) ? ranges[r].second : 0;
+            char* buffer          = (r < myRanges) ? buffers[r] : NULL;
+            if (arrayOpen.codec.size() > 0) {
+               if (readChunkedArray(begin,amount,buffer) == false) success = false;
+            } else {
+               if (readSubfiledArray(begin,amount,buffer) == false) success = false;
+            }
+         }
+      } else {
+         // Sort ranges by their position in the file:
+         const uint64_t elementBytes = arrayOpen.vectorSize*arrayOpen.dataSize;
+         const uint64_t maxBytes = getMaxBytesPerRead();
+         vector<size_t> order;
+         for (size_t r=0; r<ranges.size(); ++r) if (ranges[r].second > 0) order.push_back(r);
+         sort(order.begin(),order.end(),[&ranges](const size_t& a,const size_t& b) {return ranges[a].first < ranges[b].first;});
+
+         // File view may not contain overlapping regions. Overlapping ranges are 
+         // read to a temporary buffer and copied to output buffers afterwards. 
+         // Ranges that are too large to be read with a single collective call are split:
+         vector<uint64_t> lengths;
+         vector<MPI_Aint> displacements;
+         vector<char*> addresses;
+         list<vector<char> > overlapBuffers;
+         vector<pair<size_t,const char*> > overlapCopies;
+         size_t first = 0;
+         while (first < order.size()) {
+            const uint64_t begin = ranges[order[first]].first;
+            uint64_t end = begin + ranges[order[first]].second;
+            size_t last = first+1;
+            while (last < order.size() && ranges[order[last]].first < end) {
+               end = max(end,ranges[order[last]].first + ranges[order[last]].second);
+               ++last;
+            }
+            char* target = buffers[order[first]];
+            if (last > first+1) {
+               overlapBuffers.push_back(vector<char>((end-begin)*elementBytes));
+               target = overlapBuffers.back().data();
+               for (size_t i=first; i<last; ++i) {
+                  overlapCopies.push_back(make_pair(order[i],target + (ranges[order[i]].first-begin)*elementBytes));
+               }
+            }
+
+            const uint64_t bytes = (end-begin)*elementBytes;
+            for (uint64_t b=0; b<bytes; b+=maxBytes) {
+               lengths.push_back(min(maxBytes,bytes-b));
+               displacements.push_back(begin*elementBytes + b);
+               addresses.push_back(target + b);
+            }
+            first = last;
+         }
+
+         // Divide the blocks between collective calls so that each call reads at most maxBytes bytes:
+         vector<size_t> callBlocks(1,0);
+         uint64_t callBytes = 0;
+         for (size_t i=0; i<lengths.size(); ++i) {
+            if (callBytes + lengths[i] > maxBytes) {
+               callBlocks.push_back(i);
+               callBytes = 0;
+            }
+            callBytes += lengths[i];
+         }
+         callBlocks.push_back(lengths.size());
+         const uint64_t myCalls = callBlocks.size()-1;
+         const uint64_t N_calls = getCollectiveCalls(myCalls,comm);
+
+         // Create a file view containing this process' ranges:
+         MPI_Datatype fileType = MPI_BYTE;
+         if (lengths.size() > 0) {
+            typeCreateHindexed(lengths.size(),lengths.data(),displacements.data(),MPI_BYTE,&fileType);
+            MPI_Type_commit(&fileType);
+         }
+         if (MPI_File_set_view(filePtr,arrayOpen.offset,MPI_BYTE,fileType,const_cast<char*>("native"),MPI_INFO_NULL) != MPI_SUCCESS) {
+            success = false;
+         }
+
+         // Read data, each call scatters data to several output buffers:
+         const double t_start = MPI_Wtime();
+         MPI_Offset viewOffset = 0;
+         for (uint64_t c=0; c<N_calls; ++c) {
+            if (c >= myCalls || lengths.size() == 0) {
+               if (MPI_File_read_at_all(filePtr,viewOffset,NULL,0,MPI_BYTE,MPI_STATUS_IGNORE) != MPI_SUCCESS) success = false;
+               continue;
+            }
+            const size_t N_blocks = callBlocks[c+1]-callBlocks[c];
+            vector<MPI_Aint> memAddresses(N_blocks);
+            uint64_t bytes = 0;
+            for (size_t i=0; i<N_blocks; ++i) {
+               MPI_Get_address(addresses[callBlocks[c]+i],&(memAddresses[i]));
+               bytes += lengths[callBlocks[c]+i];
+            }
+            MPI_Datatype memType;
+            typeCreateHindexed(N_blocks,&(lengths[callBlocks[c]]),memAddresses.data(),MPI_BYTE,&memType);
+            MPI_Type_commit(&memType);
+            MPI_Status status;
+            if (MPI_File_read_at_all(filePtr,viewOffset,MPI_BOTTOM,1,memType,&status) != MPI_SUCCESS) success = false;
+            if (getCount(status,memType) != 1) {
+               cerr << "ERROR in vlsv::ParallelReader! Failed to read ranges of array '" << arrayOpen.tagName << "'" << endl;
+               success = false;
+            }
+            MPI_Type_free(&memType);
+            viewOffset += bytes;
+            bytesRead  += bytes;
+         }
+         readTime += (MPI_Wtime() - t_start);
+
+         // Restore the default file view:
+         MPI_File_set_view(filePtr,0,MPI_BYTE,MPI_BYTE,const_cast<char*>("native"),MPI_INFO_NULL);
+         if (lengths.size() > 0) MPI_Type_free(&fileType);
+         success = checkSuccess(success,comm);
+
+         for (size_t i=0; i<overlapCopies.size() && success == true; ++i) {
+            const size_t r = overlapCopies[i].first;
+            memcpy(buffers[r],overlapCopies[i].second,ranges[r].second*elementBytes);
+         }
+      }
+
+      // Convert data to native endianness:
+      if (success == true && swapIntEndianness == true) {
+         for (size_t r=0; r<ranges.size(); ++r) swapByteOrder(buffers[r],ranges[r].second*arrayOpen.vectorSize,arrayOpen.dataSize);
+      }
+      return success;
+   }
+
+   /** Read a mesh and variables defined on it, and redistribute the cells to the 
+    * processes that own them. Each process reads an equal contiguous slice of the 
+    * real (non-ghost) cells of the mesh, computes the owner of each cell with the 
+    * given function, and the cells are sent to their owners with MPI_Alltoallv. 
+    * Ghost cells of multi-domain meshes, see MESH_DOMAIN_SIZES, are skipped. The 
+    * slices are processed in rounds so that each process reads and sends at most 
+    * maxRoundBytes bytes per round, which allows redistributing meshes that do not 
+    * fit into memory twice. All processes must call this function simultaneously.
+    * @param meshName Name of the mesh.
+    * @param variableNames Names of the variables, i.e., attribute 'name' of tags VARIABLE of the mesh.
+    * @param owner Function that returns the rank of the process that owns the cell with the given global ID.
+    * @param cellIDs Global IDs of the cells received by this process are written here.
+    * @param variables Data of each variable is written here, in the order given in variableNames. 
+    * The values of each cell are in the same order as in cellIDs, in native byte order 
+    * and in the datatype the variable is stored in the file, see getArrayInfo.
+    * @param maxRoundBytes Maximum number of bytes read and sent by a process per round.
+    * @return If true, the mesh and variables were read and redistributed successfully. 
+    * All processes return the same value.*/
+   bool ParallelReader::readRedistributed(const std::string& meshName,const std::vector<std::string>& variableNames,
+                                          const std::function<int(const uint64_t&)>& owner,std::vector<uint64_t>& cellIDs,
+                                          std::vector<std::vector<char> >& variables,const uint64_t& maxRoundBytes) {
+      bool success = true;
+      cellIDs.clear();
+      variables.assign(variableNames.size(),vector<char>());
+
+      // Get metadata of the mesh. Array metadata is the same on all processes:
+      list<pair<string,string> > meshAttribs;
+      meshAttribs.push_back(make_pair("name",meshName));
+      if (getArrayInfo("MESH",meshAttribs) == false) {
+         cerr << "ERROR in vlsv::ParallelReader! Failed to find MESH '" << meshName << "'" << endl;
+         return false;
+      }
+      const ArrayOpen meshInfo = arrayOpen;
+      if (meshInfo.vectorSize != 1) {
+         cerr << "ERROR in vlsv::ParallelReader! MESH '" << meshName << "' has vectorsize " << meshInfo.vectorSize << endl;
+         return false;
+      }
+
+      // Real cells of each domain are stored first in MESH, followed by ghost cells. 
+      // Variables only contain real cells:
+      vector<uint64_t> domainMeshOffsets;
+      vector<uint64_t> domainOffsets(1,0);
+      list<pair<string,string> > domainAttribs;
+      domainAttribs.push_back(make_pair("mesh",meshName));
+      uint64_t N_domains,vectorSize,dataSize;
+      datatype::type dataType;
+      uint64_t meshOffset = 0;
+      if (ParallelReader::getArrayInfo("MESH_DOMAIN_SIZES",domainAttribs,N_domains,vectorSize,dataType,dataSize) == true) {
+         uint64_t* domainSizes = NULL;
+         if (vectorSize < 2 || read("MESH_DOMAIN_SIZES",domainAttribs,0,N_domains,domainSizes) == false) {
+            cerr << "ERROR in vlsv::ParallelReader! Failed to read MESH_DOMAIN_SIZES of mesh '" << meshName << "'" << endl;
+            delete [] domainSizes;
+            return false;
+         }
+         for (uint64_t d=0; d<N_domains; ++d) {
+            const uint64_t N_total  = domainSizes[d*vectorSize+ucdgenericmulti::domainsizes::TOTAL_BLOCKS];
+            const uint64_t N_ghosts = domainSizes[d*vectorSize+ucdgenericmulti::domainsizes::GHOST_BLOCKS];
+            if (N_ghosts > N_total) success = false;
+            domainMeshOffsets.push_back(meshOffset);
+            domainOffsets.push_back(domainOffsets.back() + N_total - N_ghosts);
+            meshOffset += N_total;
+         }
+         delete [] domainSizes;
+      } else {
+         domainMeshOffsets.push_back(0);
+         domainOffsets.push_back(meshInfo.arraySize);
+         meshOffset = meshInfo.arraySize;
+      }
+      if (success == false || meshOffset != meshInfo.arraySize) {
+         cerr << "ERROR in vlsv::ParallelReader! Domain sizes of mesh '" << meshName << "' do not match the size of MESH" << endl;
+         return false;
+      }
+      const uint64_t N_cells = domainOffsets.back();
+
+      // Get metadata of the variables:
+      vector<list<pair<string,string> > > variableAttribs(variableNames.size());
+      vector<uint64_t> recordBytes(variableNames.size());
+      uint64_t cellBytes = sizeof(uint64_t);
+      for (size_t v=0; v<variableNames.size(); ++v) {
+         variableAttribs[v].push_back(make_pair("name",variableNames[v]));
+         variableAttribs[v].push_back(make_pair("mesh",meshName));
+         if (getArrayInfo("VARIABLE",variableAttribs[v]) == false) {
+            cerr << "ERROR in vlsv::ParallelReader! Failed to find variable '" << variableNames[v] << "' of mesh '" << meshName << "'" << endl;
+            return false;
+         }
+         if (arrayOpen.arraySize != N_cells) {
+            cerr << "ERROR in vlsv::ParallelReader! Size of variable '" << variableNames[v] << "' does not match mesh '" << meshName << "'" << endl;
+            return false;
+         }
+         recordBytes[v] = arrayOpen.vectorSize*arrayOpen.dataSize;
+         cellBytes += recordBytes[v];
+      }
+
+      // Each process reads an equal slice of cells, divided into rounds:
+      const uint64_t sliceBegin = N_cells*myRank/processes;
+      const uint64_t sliceEnd   = N_cells*(myRank+1)/processes;
+      const uint64_t roundCells = max(static_cast<uint64_t>(1),min(maxRoundBytes/cellBytes,static_cast<uint64_t>(numeric_limits<int>::max())));
+      const uint64_t myRounds = (sliceEnd-sliceBegin+roundCells-1) / roundCells;
+      uint64_t N_rounds;
+      MPI_Allreduce(&myRounds,&N_rounds,1,MPI_Type<uint64_t>(),MPI_MAX,comm);
+
+      vector<MPI_Datatype> recordTypes(variableNames.size());
+      for (size_t v=0; v<variableNames.size(); ++v) {
+         MPI_Type_contiguous(recordBytes[v],MPI_BYTE,&(recordTypes[v]));
+         MPI_Type_commit(&(recordTypes[v]));
+      }
+
+      vector<int> sendCounts(processes),sendDisplacements(processes);
+      vector<int> recvCounts(processes),recvDisplacements(processes);
+      for (uint64_t round=0; round<N_rounds; ++round) {
+         const uint64_t begin  = min(sliceBegin + round*roundCells,sliceEnd);
+         const uint64_t amount = min(roundCells,sliceEnd-begin);
+
+         // Read global IDs of the cells, skipping ghost cells in MESH:
+         vector<pair<uint64_t,uint64_t> > ranges;
+         vector<char*> buffers;
+         vector<char> meshData(amount*meshInfo.dataSize);
+         size_t d = upper_bound(domainOffsets.begin(),domainOffsets.end(),begin) - domainOffsets.begin() - 1;
+         for (uint64_t i=begin; i<begin+amount; ++d) {
+            const uint64_t N = min(begin+amount,domainOffsets[d+1]) - i;
+            if (N == 0) continue;
+            ranges.push_back(make_pair(domainMeshOffsets[d] + i - domainOffsets[d],N));
+            buffers.push_back(meshData.data() + (i-begin)*meshInfo.dataSize);
+            i += N;
+         }
+         if (readRanges("MESH",meshAttribs,ranges,buffers) == false) success = false;
+         vector<uint64_t> IDs(amount);
+         if (success == true && convertArray<uint64_t>(IDs.data(),meshData.data(),amount,meshInfo.dataType,meshInfo.dataSize,false) == false) {
+            cerr << "ERROR in vlsv::ParallelReader! Unsupported datatype in MESH '" << meshName << "'" << endl;
+            success = false;
+         }
+         vector<char>().swap(meshData);
+
+         // Sort cells by their owners:
+         vector<int> owners(amount);
+         fill(sendCounts.begin(),sendCounts.end(),0);
+         for (uint64_t i=0; i<amount; ++i) {
+            owners[i] = owner(IDs[i]);
+            if (owners[i] < 0 || owners[i] >= processes) {
+               cerr << "ERROR in vlsv::ParallelReader! Invalid owner " << owners[i] << " for cell " << IDs[i] << endl;
+               success = false;
+               owners[i] = -1;
+               continue;
+            }
+            ++sendCounts[owners[i]];
+         }
+         sendDisplacements[0] = 0;
+         for (int p=1; p<processes; ++p) sendDisplacements[p] = sendDisplacements[p-1] + sendCounts[p-1];
+         vector<uint64_t> order(amount);
+         vector<int> position(sendDisplacements);
+         uint64_t N_send = 0;
+         for (uint64_t i=0; i<amount; ++i) {
+            if (owners[i] < 0) continue;
+            order[position[owners[i]]++] = i;
+            ++N_send;
+         }
+         order.resize(N_send);
+
+         MPI_Alltoall(sendCounts.data(),1,MPI_Type<int>(),recvCounts.data(),1,MPI_Type<int>(),comm);
+         recvDisplacements[0] = 0;
+         for (int p=1; p<processes; ++p) recvDisplacements[p] = recvDisplacements[p-1] + recvCounts[p-1];
+         const uint64_t N_recv = recvDisplacements[processes-1] + recvCounts[processes-1];
+
+         // Send global IDs:
+         vector<uint64_t> sendIDs(N_send);
+         for (uint64_t i=0; i<N_send; ++i) sendIDs[i] = IDs[order[i]];
+         const size_t oldCells = cellIDs.size();
+         cellIDs.resize(oldCells + N_recv);
+         MPI_Alltoallv(sendIDs.data(),sendCounts.data(),sendDisplacements.data(),MPI_Type<uint64_t>(),
+                       cellIDs.data()+oldCells,recvCounts.data(),recvDisplacements.data(),MPI_Type<uint64_t>(),comm);
+
+         // Read and send variables one at a time:
+         for (size_t v=0; v<variableNames.size(); ++v) {
+            vector<char> data(amount*recordBytes[v]);
+            if (ParallelReader::readArray("VARIABLE",variableAttribs[v],begin,amount,data.data()) == false) success = false;
+            vector<char> sendData(N_send*recordBytes[v]);
+            for (uint64_t i=0; i<N_send; ++i) {
+               memcpy(&(sendData[i*recordBytes[v]]),&(data[order[i]*recordBytes[v]]),recordBytes[v]);
+            }
+            vector<char>().swap(data);
+            variables[v].resize((oldCells + N_recv)*recordBytes[v]);
+            MPI_Alltoallv(sendData.data(),sendCounts.data(),sendDisplacements.data(),recordTypes[v],
+                          variables[v].data()+oldCells*recordBytes[v],recvCounts.data(),recvDisplacements.data(),recordTypes[v],comm);
+         }
+      }
+
+      for (size_t v=0; v<recordTypes.size(); ++v) MPI_Type_free(&(recordTypes[v]));
+      return checkSuccess(success,comm);
+   }
+
+   /** Read an array that every process needs to a memory segment shared by the 
+    * processes on each node. The array is divided between the first processes 
+    * of each node, which read their parts with a collective read and exchange 
+    * them, so the file is read once and each node stores one copy of the array. 
+    * The data remains valid until the file is closed. All processes must call 
+    * this function simultaneously.
+    * @param tagName Array XML tag name.
+    * @param attribs Additional attributes that uniquely define the array.
+    * @param data Pointer to read-only array contents in native byte order is written here.
+    * @param arraySize Variable in which array size is written.
+    * @param vectorSize Variable in which array vector size is written.
+    * @param dataType Variable in which array datatype is written.
+    * @param dataSize Variable in which byte size of array datatype is written.
+    * @return If true, the array was read successfully. All processes return the same value.*/
+   bool ParallelReader::readReplicated(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                                       const char*& data,uint64_t& arraySize,uint64_t& vectorSize,datatype::type& dataType,uint64_t& dataSize) {
+      data = NULL;
+      if (getArrayInfo(tagName,attribs) == false) return false;
+      arraySize  = arrayOpen.arraySize;
+      vectorSize = arrayOpen.vectorSize;
+      dataType   = arrayOpen.dataType;
+      dataSize   = arrayOpen.dataSize;
+      const uint64_t elementBytes = vectorSize*dataSize;
+      if (arraySize > static_cast<uint64_t>(numeric_limits<int>::max())) {
+         cerr << "ERROR in vlsv::ParallelReader! Array '" << tagName << "' is too large for readReplicated" << endl;
+         return false;
+      }
+      
+      // Create communicators of the processes on each node, and of the first processes on each node:
+      if (nodeComm == MPI_COMM_NULL) {
+         MPI_Comm_split_type(comm,MPI_COMM_TYPE_SHARED,myRank,MPI_INFO_NULL,&nodeComm);
+         int nodeRank;
+         MPI_Comm_rank(nodeComm,&nodeRank);
+         MPI_Comm_split(comm,(nodeRank == 0) ? 0 : MPI_UNDEFINED,myRank,&nodeLeaderComm);
+      }
+
+      // First process on each node allocates the shared memory segment:
+      const bool isLeader = (nodeLeaderComm != MPI_COMM_NULL);
+      MPI_Win window;
+      char* segment = NULL;
+      const MPI_Aint segmentBytes = isLeader ? arraySize*elementBytes : 0;
+      if (MPI_Win_allocate_shared(segmentBytes,1,MPI_INFO_NULL,nodeComm,&segment,&window) != MPI_SUCCESS) {
+         cerr << "ERROR in vlsv::ParallelReader! Failed to allocate shared memory for array '" << tagName << "'" << endl;
+         return false;
+      }
+      MPI_Aint querySize;
+      int displacementUnit;
+      MPI_Win_shared_query(window,0,&querySize,&displacementUnit,&segment);
+      MPI_Win_fence(0,window);
+
+      // Node leaders read equal parts of the array, other processes read nothing:
+      bool success = true;
+      int leaders = 0;
+      int leaderRank = 0;
+      if (isLeader == true) {
+         MPI_Comm_size(nodeLeaderComm,&leaders);
+         MPI_Comm_rank(nodeLeaderComm,&leaderRank);
+      }
+      const uint64_t begin  = isLeader ? arraySize*leaderRank/leaders : 0;
+      const uint64_t amount = isLeader ? arraySize*(leaderRank+1)/leaders - begin : 0;
+      if (readArray(tagName,attribs,begin,amount,segment+begin*elementBytes) == false) success = false;
+
+      // Node leaders exchange their parts:
+      if (success == true && isLeader == true && leaders > 1) {
+         vector<int> counts(leaders);
+         vector<int> displacements(leaders);
+         for (int l=0; l<leaders; ++l) {
+            displacements[l] = arraySize*l/leaders;
+            counts[l] = arraySize*(l+1)/leaders - displacements[l];
+         }
+         MPI_Datatype element;
+         MPI_Type_contiguous(elementBytes,MPI_BYTE,&element);
+         MPI_Type_commit(&element);
+         if (MPI_Allgatherv(MPI_IN_PLACE,0,element,segment,counts.data(),displacements.data(),element,nodeLeaderComm) != MPI_SUCCESS) {
+            success = false;
+         }
+         MPI_Type_free(&element);
+      }
+      MPI_Win_fence(0,window);
+
+      success = checkSuccess(success,comm);
+      if (success == false) {
+         MPI_Win_free(&window);
+         return false;
+      }
+      replicatedWindows.push_back(window);
+      data = segment;
+      return true;
+   }
+
+   /** Read the given elements of a compressed array using collective MPI file I/O. 
+    * Each process reads the compressed chunks that contain its requested elements, 
+    * and decompresses them into the output buffer. Metadata of the array must have 
+    * been read with getArrayInfo.
+    * @param begin First array element read by this process.
+    * @param amount Number of array elements read by this process.
+    * @param buffer Buffer in which data is read.
+    * @return If true, array contents were successfully read. All processes return the same value.*/
+   bool ParallelReader::readChunkedArray(const uint64_t& begin,const uint64_t& amount,char* buffer) {
+      bool success = true;
+      ChunkTable* table = NULL;
+      if (loadChunkTable(arrayOpen,table) == false) return false;
+
+      if (begin + amount > arrayOpen.arraySize) {
+         cerr << "ERROR in vlsv::ParallelReader! Requested read exceeds array size" << endl;
+         success = false;
+      }
+
+      // Read compressed data of all chunks that contain requested elements:
+      MPI_Offset spanStart = 0;
+      vector<char> span;
+      uint64_t firstChunk,lastChunk;
+      if (amount > 0 && success == true) {
+         getChunkRange(*table,begin,amount,firstChunk,lastChunk);
+         const uint64_t* first = &(table->entries[firstChunk*chunktable::SIZE]);
+         const uint64_t* last  = &(table->entries[lastChunk*chunktable::SIZE]);
+         spanStart = first[chunktable::OFFSET];
+         span.resize(last[chunktable::OFFSET] + last[chunktable::BYTES] - first[chunktable::OFFSET]);
+      }
+      if (readCollective(spanStart,span.size(),span.data()) == false) success = false;
+
+      if (amount > 0 && success == true) {
+         if (decodeChunks(arrayOpen,*table,begin,amount,span.data(),buffer) == false) success = false;
+      }
+      return checkSuccess(success,comm);
+   }
+
+   /** Read the given elements of an array stored in subfiles. Each process reads 
+    * its elements independently from the subfiles that contain them. Metadata 
+    * of the array must have been read with getArrayInfo.
+    * @param begin First array element read by this process.
+    * @param amount Number of array elements read by this process.
+    * @param buffer Buffer in which data is read.
+    * @return If true, array contents were successfully read. All processes return the same value.*/
+   bool ParallelReader::readSubfiledArray(const uint64_t& begin,const uint64_t& amount,char* buffer) {
+      bool success = true;
+      if (begin + amount > arrayOpen.arraySize) {
+         cerr << "ERROR in vlsv::ParallelReader! Requested read exceeds array size" << endl;
+         success = false;
+      }
+
+      const double t_start = MPI_Wtime();
+      if (success == true && amount > 0) {
+         if (Reader::readSubfiledArray(arrayOpen,begin,amount,buffer) == false) success = false;
+      }
+      readTime  += (MPI_Wtime() - t_start);
+      bytesRead += amount*arrayOpen.vectorSize*arrayOpen.dataSize;
+      return checkSuccess(success,comm);
+   }
+
+   /** Read data from input file with a single collective MPI call, or start a 
+    * non-blocking collective read if request is not NULL.
+    * @param offset Offset relative to file start where this process reads.
+    * @param buffer Buffer in which data is read.
+    * @param count Number of datatypes read.
+    * @param datatype MPI datatype of the data in buffer.
+    * @param expectedBytes Number of bytes this process should get, or -1 if not checked.
+    * @param request If not NULL, the read is added to this request and completed in wait.
+    * @return If true, this process read (or started to read) its data successfully.*/
+   bool ParallelReader::readAtAll(const MPI_Offset& offset,char* buffer,const uint64_t& count,const MPI_Datatype& datatype,
+                                  const int64_t& expectedBytes,ReadRequest* request) {
+      #ifdef VLSV_NONBLOCKING_COLLECTIVE_READS
+      if (request != NULL) {
+         MPI_Request mpiRequest;
+         if (fileIreadAtAll(filePtr,offset,buffer,count,datatype,&mpiRequest) != MPI_SUCCESS) return false;
+         request->requests.push_back(mpiRequest);
+         request->expectedBytes.push_back(expectedBytes);
+         return true;
+      }
+      #endif
+
+      bool success = true;
+      MPI_Status status;
+      if (fileReadAtAll(filePtr,offset,buffer,count,datatype,&status) != MPI_SUCCESS) {
+         success = false;
+      }
+
+      // Check that we got everything we requested:
+      if (expectedBytes >= 0) {
+         const int64_t bytesReceived = getCount(status,MPI_BYTE);
+         if (bytesReceived != expectedBytes) {
+            stringstream ss;
+            ss << "ERROR in vlsv::ParallelReader! I only got " << bytesReceived << "/" << expectedBytes;
+            ss << " bytes in " << __FILE__ << ":" << __LINE__ << endl;
+            cerr << ss.str();
+            success = false;
+         }
+      }
+      return success;
+   }
+
+   /** Read a contiguous region from input file using collective MPI file I/O. 
+    * If the region is larger than what can be read with a single collective call, 
+    * all processes make the same number of collective calls.
+    * @param start Offset relative to file start where this process starts to read.
+    * @param readBytes Number of bytes read by this process.
+    * @param buffer Buffer in which data is read.
+    * @param request If not NULL, reads are started with non-blocking collectives 
+    * that are added to this request.
+    * @return If true, this process read (or started to read) its data successfully.*/
+   bool ParallelReader::readCollective(const MPI_Offset& start,const uint64_t& readBytes,char* buffer,ReadRequest* request) {
+      bool success = true;
       // If readBytes is larger than getMaxBytesPerRead() this process needs 
       // more than one collective call to read in all the data.
       const uint64_t maxBytes = getMaxBytesPerRead();
@@ -482,8 +1251,7 @@ namespace vlsv {
 
       // Reduce the max number of required collective calls to all 
       // processes to prevent deadlock:
-      uint64_t globalExtraCollectiveReads;
-      MPI_Allreduce(&myExtraCollectiveReads,&globalExtraCollectiveReads,1,MPI_Type<uint64_t>(),MPI_MAX,comm);
+      const uint64_t globalExtraCollectiveReads = getCollectiveCalls(myExtraCollectiveReads,comm);
 
       // Read data:
       const auto t_start = MPI_Wtime();
@@ -505,28 +1273,13 @@ namespace vlsv {
             readSize = 0;
          }
 
-         MPI_Status status;
-         if (MPI_File_read_at_all(filePtr,start+counter*maxBytes,pos,readSize,MPI_BYTE,&status) != MPI_SUCCESS) {
-            success = false;
-         }
-
-         // Check that we got everything we requested:
-         int bytesReceived;
-         MPI_Get_count(&status,MPI_BYTE,&bytesReceived);
-         if (bytesReceived != readSize) {
-            stringstream ss;
-            ss << "ERROR in vlsv::ParallelReader! I only got " << bytesReceived << "/" << readSize;
-            ss << " bytes in " << __FILE__ << ":" << __LINE__ << endl;
-            cerr << ss.str();
-            success = false;
-         }
+         if (readAtAll(start+counter*maxBytes,pos,readSize,MPI_BYTE,readSize,request) == false) success = false;
 
          offset += readSize;
       }
       readTime  += (MPI_Wtime() - t_start);
-      bytesRead += amount*arrayOpen.vectorSize*arrayOpen.dataSize;
-
-      return checkSuccess(success,comm);
+      bytesRead += readBytes;
+      return success;
    }
 
    /** Start multi-read mode. In multi-read mode processes add zero or more file I/O units 
@@ -534,8 +1287,8 @@ namespace vlsv {
     * File I/O units are defined by calling addMultireadUnit. Data is not actually read until 
     * endMultiread is called. XML tag name and contents of list 'attribs' need to uniquely 
     * define the array.
-    * @param tagName Array XML tag name in VLSV file. Only significant on master process.
-    * @param attribs Additional attributes that uniquely define the array in file. Only significant on master process.
+    * @param tagName Array XML tag name in VLSV file. Must be the same on all processes.
+    * @param attribs Additional attributes that uniquely define the array in file. Must be the same on all processes.
     * @return If true, multi-read mode was started successfully. All processes return the same value.
     * @see addMultireadUnit.
     * @see endMultiread.*/
@@ -550,4 +1303,68 @@ namespace vlsv {
       return success;
    }
 
+   /** Prepare a request for a new non-blocking read.
+    * @param request The request. Must not be active.
+    * @return If true, the request was prepared successfully. All processes return the same value.*/
+   bool ParallelReader::startRequest(ReadRequest& request) {
+      bool success = true;
+      if (parallelFileOpen == false) success = false;
+      if (request.active == true) {
+         cerr << "ERROR in vlsv::ParallelReader! Request is still active, call wait before reusing it" << endl;
+         success = false;
+      }
+      if (checkSuccess(success,comm) == false) return false;
+
+      request.active = true;
+      request.dataSize = 0;
+      request.expectedBytes.clear();
+      request.requests.clear();
+      request.success = true;
+      request.swaps.clear();
+      return true;
+   }
+
+   /** Complete a non-blocking read started with ireadArray or iendMultiread. All processes 
+    * in the communicator must call this function, and requests must be completed in the 
+    * same order on all processes. After this function returns the data in the read buffers 
+    * is in native byte order and the request can be reused.
+    * @param request The request.
+    * @return If true, all processes read their data successfully. All processes return the same value.*/
+   bool ParallelReader::wait(ReadRequest& request) {
+      bool success = request.success;
+      if (request.active == false) success = false;
+
+      // Wait for the reads to complete and check that we got everything we requested:
+      const auto t_start = MPI_Wtime();
+      vector<MPI_Status> statuses(request.requests.size());
+      if (request.requests.size() > 0) {
+         if (MPI_Waitall(request.requests.size(),request.requests.data(),statuses.data()) != MPI_SUCCESS) success = false;
+      }
+      readTime += (MPI_Wtime() - t_start);
+      for (size_t i=0; i<statuses.size(); ++i) {
+         if (request.expectedBytes[i] < 0) continue;
+         const int64_t bytesReceived = getCount(statuses[i],MPI_BYTE);
+         if (bytesReceived != request.expectedBytes[i]) {
+            stringstream ss;
+            ss << "ERROR in vlsv::ParallelReader! I only got " << bytesReceived << "/" << request.expectedBytes[i];
+            ss << " bytes in " << __FILE__ << ":" << __LINE__ << endl;
+            cerr << ss.str();
+            success = false;
+         }
+      }
+
+      // Convert data to native endianness:
+      if (success == true) {
+         for (size_t i=0; i<request.swaps.size(); ++i) {
+            swapByteOrder(request.swaps[i].first,request.swaps[i].second,request.dataSize);
+         }
+      }
+
+      request.active = false;
+      request.expectedBytes.clear();
+      request.requests.clear();
+      request.swaps.clear();
+      return checkSuccess(success,comm);
+   }
+
 } // namespace vlsv
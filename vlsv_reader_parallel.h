@@ -19,6 +19,7 @@
 #ifndef VLSV_READER_PARALLEL_H
 #define VLSV_READER_PARALLEL_H
 
+#include <functional>
 #include <mpi.h>
 
 #include "vlsv_reader.h"
@@ -27,6 +28,20 @@
 
 namespace vlsv {
 
+   /** Handle of a non-blocking collective read started with ParallelReader::ireadArray 
+    * or ParallelReader::iendMultiread. The read is completed with ParallelReader::wait, 
+    * after which the handle can be reused.*/
+   struct ReadRequest {
+      ReadRequest();
+
+      bool active;                                    /**< If true, the read has been started but not completed.*/
+      uint64_t dataSize;                              /**< Byte size of values that need a byte order swap.*/
+      std::vector<int64_t> expectedBytes;             /**< Number of bytes each request should read, or -1 if not checked.*/
+      std::vector<MPI_Request> requests;              /**< MPI requests of the pending collective reads.*/
+      bool success;                                   /**< If false, starting the read failed on this process.*/
+      std::vector<std::pair<char*,uint64_t> > swaps;  /**< Buffers and value counts whose byte order is swapped after completion.*/
+   };
+
    class ParallelReader: public Reader {
     public:
       ParallelReader();
@@ -42,14 +57,28 @@ namespace vlsv {
       uint64_t getBytesRead();
       double getReadTime() const;
       bool getUniqueAttributeValues(const std::string& tagName,const std::string& attribName,std::set<std::string>& output) const;
+      bool ireadArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                      const uint64_t& begin,const uint64_t& amount,char* buffer,ReadRequest& request);
       bool open(const std::string& fname,MPI_Comm comm,const int& masterRank,MPI_Info mpiInfo=MPI_INFO_NULL);
       bool readArrayMaster(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
                            const uint64_t& begin,const uint64_t& amount,char* buffer);
       bool readArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
                      const uint64_t& begin,const uint64_t& amount,char* buffer);
+      bool readArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                     const uint64_t& begin,const uint64_t& amount,const uint64_t& firstComponent,
+                     const uint64_t& components,char* buffer);
+      bool readRanges(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                      const std::vector<std::pair<uint64_t,uint64_t> >& ranges,const std::vector<char*>& buffers);
+      bool readRedistributed(const std::string& meshName,const std::vector<std::string>& variableNames,
+                             const std::function<int(const uint64_t&)>& owner,std::vector<uint64_t>& cellIDs,
+                             std::vector<std::vector<char> >& variables,const uint64_t& maxRoundBytes=64*1024*1024);
+      bool readReplicated(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                          const char*& data,uint64_t& arraySize,uint64_t& vectorSize,datatype::type& dataType,uint64_t& dataSize);
+      bool wait(ReadRequest& request);
 
       bool addMultireadUnit(char* buffer,const uint64_t& amount);
       bool endMultiread(const uint64_t& arrayOffset);
+      bool iendMultiread(const uint64_t& arrayOffset,ReadRequest& request);
       bool startMultiread(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs);
 
       template<typename T>
@@ -65,14 +94,27 @@ namespace vlsv {
       int masterRank;                 /**< MPI rank of master process.*/
       bool multireadStarted;          /**< If true, multiread mode has been initialized successfully.*/
       int myRank;                     /**< MPI rank of this process in communicator comm.*/
+      MPI_Comm nodeComm;              /**< Communicator of the processes on this node, created by readReplicated.*/
+      MPI_Comm nodeLeaderComm;        /**< Communicator of the first processes on each node, MPI_COMM_NULL on other processes.*/
       bool parallelFileOpen;          /**< If true, all processes have opened input file successfully.*/
       int processes;                  /**< Number of MPI processes in communicator comm.*/
       double readTime;                /**< Time spent in seconds to read bytesRead bytes by this process.*/
+      std::list<MPI_Win> replicatedWindows; /**< Shared memory windows containing arrays read with readReplicated.*/
 
       std::list<Multi_IO_Unit> multiReadUnits;
 
+      bool broadcastFooter();
+      bool finishMultiread(const uint64_t& arrayOffset,ReadRequest* request);
       bool getArrayInfo(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs);
-      bool flushMultiread(const size_t& unit,const MPI_Offset& currentOffset,std::list<Multi_IO_Unit>::iterator& start,std::list<Multi_IO_Unit>::iterator& stop);
+      bool loadChunkTable(const ArrayOpen& info,ChunkTable*& table);
+      bool readAtAll(const MPI_Offset& offset,char* buffer,const uint64_t& count,const MPI_Datatype& datatype,
+                     const int64_t& expectedBytes,ReadRequest* request);
+      bool readChunkedArray(const uint64_t& begin,const uint64_t& amount,char* buffer);
+      bool readCollective(const MPI_Offset& start,const uint64_t& readBytes,char* buffer,ReadRequest* request=NULL);
+      bool readSubfiledArray(const uint64_t& begin,const uint64_t& amount,char* buffer);
+      bool startRequest(ReadRequest& request);
+      bool flushMultiread(const size_t& unit,const MPI_Offset& currentOffset,std::list<Multi_IO_Unit>::iterator& start,
+                          std::list<Multi_IO_Unit>::iterator& stop,ReadRequest* request=NULL);
    };
 
    template<typename T>
@@ -86,23 +128,29 @@ namespace vlsv {
       // Check that requested read is inside the array:
       if (begin > arrayOpen.arraySize || (begin+amount) > arrayOpen.arraySize) return false;
 
-      char* buffer = new char[amount*arrayOpen.vectorSize*arrayOpen.dataSize];
-      if (ParallelReader::readArray(tagName,attribs,begin,amount,buffer) == false) {
-         delete [] buffer; buffer = NULL;
+      // If data is stored as T, read it directly to output. All processes 
+      // have the same array metadata, so they all take the same branch:
+      const datatype::type dataType = arrayOpen.dataType;
+      const uint64_t dataSize = arrayOpen.dataSize;
+      const uint64_t values = amount*arrayOpen.vectorSize;
+      if (allocateMemory == true) outBuffer = new T[values];
+      if (isStoredAs<T>(dataType,dataSize) == true) {
+         if (ParallelReader::readArray(tagName,attribs,begin,amount,reinterpret_cast<char*>(outBuffer)) == true) return true;
+         if (allocateMemory == true) {delete [] outBuffer; outBuffer = NULL;}
          return false;
       }
 
-      // Copy data from temporary buffer to output array:
-      if (allocateMemory == true) outBuffer = new T[amount*arrayOpen.vectorSize];
-      char* ptr = buffer;
-      for (uint64_t i=0; i<amount; ++i) {
-         for (uint64_t j=0; j<arrayOpen.vectorSize; ++j) {
-            convertValue<T>(outBuffer[i*arrayOpen.vectorSize+j],ptr,arrayOpen.dataType,arrayOpen.dataSize,false);
-            ptr += arrayOpen.dataSize;
-         }
+      char* buffer = new char[values*dataSize];
+      bool success = ParallelReader::readArray(tagName,attribs,begin,amount,buffer);
+
+      // Convert data from temporary buffer to output array:
+      if (success == true && convertArray<T>(outBuffer,buffer,values,dataType,dataSize,false) == false) {
+         std::cerr << "ERROR in vlsv::ParallelReader! Unsupported datatype in read" << std::endl;
+         success = false;
       }
+      if (success == false && allocateMemory == true) {delete [] outBuffer; outBuffer = NULL;}
       delete [] buffer; buffer = NULL;
-      return true;
+      return success;
    }
 
    /** Read the value of a parameter. All processes must call this function simultaneously.
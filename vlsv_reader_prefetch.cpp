@@ -0,0 +1,237 @@
+/** This file is part of VLSV file format.
+ * 
+ *  Copyright 2011-2016 Finnish Meteorological Institute
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <iostream>
+
+#include "vlsv_reader_prefetch.h"
+
+using namespace std;
+
+namespace vlsv {
+
+   /** Constructor for class PrefetchReader.*/
+   PrefetchReader::PrefetchReader() {
+      bufferedBytes = 0;
+      current = NULL;
+      memoryBudget = 0;
+      nextFile = 0;
+      stopRequested = false;
+   }
+
+   /** Destructor for class PrefetchReader. Stops the background thread 
+    * and deallocates all prefetched data.*/
+   PrefetchReader::~PrefetchReader() {
+      close();
+   }
+
+   /** Add an array that is read from every file. All arrays must be added before start is called.
+    * @param tagName Name of the XML tag.
+    * @param attribs List of attributes that uniquely determine the array.
+    * @return If true, the array was added successfully.*/
+   bool PrefetchReader::addArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs) {
+      if (worker.joinable() == true) {
+         cerr << "vlsv::PrefetchReader ERROR: Arrays must be added before prefetching is started" << endl;
+         return false;
+      }
+      ArrayRequest request;
+      request.tagName = tagName;
+      request.attribs = attribs;
+      requests.push_back(request);
+      return true;
+   }
+
+   /** Stop prefetching and close all files. Prefetched data that has not 
+    * been passed to the caller is discarded. Arrays added with addArray are kept.
+    * @return If true, the reader was closed successfully.*/
+   bool PrefetchReader::close() {
+      {
+         lock_guard<mutex> lock(queueMutex);
+         stopRequested = true;
+      }
+      budgetChanged.notify_all();
+      if (worker.joinable() == true) worker.join();
+
+      release(current);
+      for (deque<PrefetchedFile*>::iterator it=queue.begin(); it!=queue.end(); ++it) release(*it);
+      queue.clear();
+      fileNames.clear();
+      bufferedBytes = 0;
+      nextFile = 0;
+      stopRequested = false;
+      return true;
+   }
+
+   /** Find the index of the given array in the list of arrays read from every file.
+    * @param tagName Name of the XML tag.
+    * @param attribs List of attributes that determine the array.
+    * @return Index of the array, or -1 if it was not added with addArray.*/
+   int PrefetchReader::findRequest(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs) const {
+      for (size_t i=0; i<requests.size(); ++i) {
+         if (requests[i].tagName == tagName && requests[i].attribs == attribs) return i;
+      }
+      return -1;
+   }
+
+   /** Get the prefetched contents of an array in the current file. Data is in 
+    * native byte order and remains valid until next or close is called.
+    * @param tagName Name of the XML tag.
+    * @param attribs List of attributes that determine the array, as given to addArray.
+    * @param data Pointer to array contents is written here.
+    * @param arraySize Variable in which array size is written.
+    * @param vectorSize Variable in which array vector size is written.
+    * @param dataType Variable in which array datatype is written.
+    * @param dataSize Variable in which byte size of array datatype is written.
+    * @return If true, the array was prefetched from the current file.*/
+   bool PrefetchReader::getArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                                 const char*& data,uint64_t& arraySize,uint64_t& vectorSize,datatype::type& dataType,uint64_t& dataSize) const {
+      if (current == NULL) return false;
+      const int index = findRequest(tagName,attribs);
+      if (index < 0 || current->arrays[index].found == false) return false;
+      
+      const ArrayData& array = current->arrays[index];
+      data       = array.data.data();
+      arraySize  = array.arraySize;
+      vectorSize = array.vectorSize;
+      dataType   = array.dataType;
+      dataSize   = array.dataSize;
+      return true;
+   }
+
+   /** Get the reader that has opened the current file. It can be used to 
+    * read parameters and arrays that were not prefetched.
+    * @return Reader of the current file, or NULL if the file could not be opened.*/
+   Reader* PrefetchReader::getReader() {
+      if (current == NULL) return NULL;
+      return current->reader;
+   }
+
+   /** Move to the next file in the scan. Blocks until the background thread has 
+    * read the file. The previous file is closed and its data is deallocated.
+    * @param fileName Name of the file is written here.
+    * @return If true, there was a next file. If opening the file failed, 
+    * getReader returns NULL and reads from the file fail.*/
+   bool PrefetchReader::next(std::string& fileName) {
+      release(current);
+      {
+         unique_lock<mutex> lock(queueMutex);
+         if (nextFile >= fileNames.size()) return false;
+         queueChanged.wait(lock,[this]() {return queue.empty() == false;});
+         current = queue.front();
+         queue.pop_front();
+         bufferedBytes -= current->bytes;
+         ++nextFile;
+      }
+      budgetChanged.notify_all();
+      fileName = current->fileName;
+      return true;
+   }
+
+   /** Open files and read the requested arrays in scan order until all files 
+    * have been read or stop is requested. Called by the background thread.*/
+   void PrefetchReader::prefetch() {
+      for (size_t f=0; f<fileNames.size(); ++f) {
+         PrefetchedFile* file = new PrefetchedFile();
+         file->fileName = fileNames[f];
+         file->bytes = 0;
+         file->arrays.resize(requests.size());
+         file->reader = new Reader();
+         if (file->reader->open(fileNames[f]) == false) {
+            cerr << "vlsv::PrefetchReader ERROR: Failed to open file '" << fileNames[f] << "'" << endl;
+            delete file->reader;
+            file->reader = NULL;
+         }
+
+         // Get sizes of requested arrays from the footer:
+         for (size_t i=0; i<requests.size(); ++i) {
+            ArrayData& array = file->arrays[i];
+            array.found = false;
+            if (file->reader == NULL) continue;
+            if (file->reader->getArrayInfo(requests[i].tagName,requests[i].attribs,array.arraySize,
+                                           array.vectorSize,array.dataType,array.dataSize) == false) continue;
+            array.found = true;
+            file->bytes += array.arraySize*array.vectorSize*array.dataSize;
+         }
+
+         // Wait until the file fits into the memory budget. A file is always 
+         // read if the queue is empty, otherwise a file that is larger than 
+         // the budget would stall the scan:
+         {
+            unique_lock<mutex> lock(queueMutex);
+            budgetChanged.wait(lock,[this,file]() {
+               return stopRequested == true || queue.empty() == true || bufferedBytes + file->bytes <= memoryBudget;
+            });
+            if (stopRequested == true) {
+               release(file);
+               return;
+            }
+            bufferedBytes += file->bytes;
+         }
+
+         for (size_t i=0; i<requests.size(); ++i) {
+            ArrayData& array = file->arrays[i];
+            if (array.found == false) continue;
+            array.data.resize(array.arraySize*array.vectorSize*array.dataSize);
+            if (file->reader->readArray(requests[i].tagName,requests[i].attribs,0,array.arraySize,array.data.data()) == false) {
+               cerr << "vlsv::PrefetchReader ERROR: Failed to read array '" << requests[i].tagName;
+               cerr << "' from file '" << fileNames[f] << "'" << endl;
+               array.found = false;
+               vector<char>().swap(array.data);
+            }
+         }
+
+         {
+            lock_guard<mutex> lock(queueMutex);
+            queue.push_back(file);
+         }
+         queueChanged.notify_all();
+      }
+   }
+
+   /** Close the given file and deallocate its data.
+    * @param file Prefetched file, set to NULL here.*/
+   void PrefetchReader::release(PrefetchedFile*& file) {
+      if (file == NULL) return;
+      if (file->reader != NULL) {
+         file->reader->close();
+         delete file->reader;
+      }
+      delete file;
+      file = NULL;
+   }
+
+   /** Start prefetching the given files in a background thread. Arrays given with 
+    * addArray are read from each file. Files are read ahead of the caller as long 
+    * as the array data of files waiting in queue fits into memoryBudget, but the next 
+    * file is always prefetched. Files are passed to the caller by calling next.
+    * @param fileNames Names of the files, in the order they are processed.
+    * @param memoryBudget Maximum number of bytes of array data in files read ahead.
+    * @return If true, prefetching was started successfully.*/
+   bool PrefetchReader::start(const std::vector<std::string>& fileNames,const uint64_t& memoryBudget) {
+      if (worker.joinable() == true) {
+         cerr << "vlsv::PrefetchReader ERROR: Prefetching has already been started" << endl;
+         return false;
+      }
+      close();
+      this->fileNames = fileNames;
+      this->memoryBudget = memoryBudget;
+      worker = thread(&PrefetchReader::prefetch,this);
+      return true;
+   }
+
+} // namespace vlsv
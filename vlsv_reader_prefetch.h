@@ -0,0 +1,134 @@
+/** This file is part of VLSV file format.
+ * 
+ *  Copyright 2011-2016 Finnish Meteorological Institute
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VLSV_READER_PREFETCH_H
+#define VLSV_READER_PREFETCH_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "vlsv_reader.h"
+
+namespace vlsv {
+
+   /** Reader for sequential scans over several VLSV files, e.g., time series. The files 
+    * and arrays touched by the scan are given in advance, and a background thread opens 
+    * the next files and reads the given arrays into memory while the caller processes 
+    * the current file. Files are prefetched as long as their arrays fit into the 
+    * given memory budget. Arrays that were not given in advance are read from the 
+    * current file when requested.*/
+   class PrefetchReader {
+    public:
+      PrefetchReader();
+      ~PrefetchReader();
+
+      bool addArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs);
+      bool close();
+      bool getArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                    const char*& data,uint64_t& arraySize,uint64_t& vectorSize,datatype::type& dataType,uint64_t& dataSize) const;
+      Reader* getReader();
+      bool next(std::string& fileName);
+      bool start(const std::vector<std::string>& fileNames,const uint64_t& memoryBudget);
+
+      template<typename T>
+      bool read(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                const uint64_t& begin,const uint64_t& amount,T*& buffer,bool allocateMemory=true);
+
+    private:
+      /** Array that is read from every file.*/
+      struct ArrayRequest {
+         std::string tagName;                                  /**< XML tag name of the array.*/
+         std::list<std::pair<std::string,std::string> > attribs; /**< Attributes that determine the array.*/
+      };
+
+      /** Array data read from a file.*/
+      struct ArrayData {
+         bool found;                  /**< If true, the array exists in the file and was read successfully.*/
+         uint64_t arraySize;          /**< Size of the array.*/
+         uint64_t vectorSize;         /**< Size of array elements.*/
+         datatype::type dataType;     /**< Datatype of array elements.*/
+         uint64_t dataSize;           /**< Byte size of each element's component.*/
+         std::vector<char> data;      /**< Array contents in native byte order.*/
+      };
+
+      /** File that has been opened and whose arrays have been read by the background thread.*/
+      struct PrefetchedFile {
+         std::string fileName;        /**< Name of the file.*/
+         Reader* reader;              /**< Reader that has opened the file, or NULL if opening failed.*/
+         std::vector<ArrayData> arrays; /**< Contents of requested arrays, in the order given to addArray.*/
+         uint64_t bytes;              /**< Total size of array contents in bytes.*/
+      };
+
+      std::condition_variable budgetChanged; /**< Signaled when prefetched data is released.*/
+      uint64_t bufferedBytes;         /**< Bytes of array data in prefetched files waiting in queue.*/
+      PrefetchedFile* current;        /**< File that is processed by the caller.*/
+      std::vector<std::string> fileNames; /**< Names of the scanned files, in scan order.*/
+      uint64_t memoryBudget;          /**< Maximum bytes of array data in prefetched files waiting in queue.*/
+      size_t nextFile;                /**< Index of the file that is passed to caller in next call to next.*/
+      std::deque<PrefetchedFile*> queue; /**< Prefetched files that have not been passed to caller yet.*/
+      std::condition_variable queueChanged; /**< Signaled when a file is added to queue.*/
+      std::mutex queueMutex;          /**< Mutex that protects queue, bufferedBytes, and stopRequested.*/
+      std::vector<ArrayRequest> requests; /**< Arrays read from every file.*/
+      bool stopRequested;             /**< If true, background thread exits as soon as possible.*/
+      std::thread worker;             /**< Background thread that prefetches files.*/
+
+      int findRequest(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs) const;
+      void prefetch();
+      void release(PrefetchedFile*& file);
+   };
+
+   /** Read the given part of an array in the current file. If the array was prefetched 
+    * its data is copied from memory, otherwise it is read from the file.
+    * @param tagName Name of the XML tag.
+    * @param attribs List of attributes that uniquely determine the array.
+    * @param begin Index of the first read array element.
+    * @param amount How many array elements are read.
+    * @param outBuffer Buffer in which data is copied.
+    * @param allocateMemory If true, outBuffer is allocated here and must be deallocated by the caller.
+    * @return If true, requested part of the array was copied to outBuffer.*/
+   template<typename T> inline
+   bool PrefetchReader::read(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                             const uint64_t& begin,const uint64_t& amount,T*& outBuffer,bool allocateMemory) {
+      const char* data;
+      uint64_t arraySize,vectorSize,dataSize;
+      datatype::type dataType;
+      if (getArray(tagName,attribs,data,arraySize,vectorSize,dataType,dataSize) == false) {
+         if (current == NULL || current->reader == NULL) return false;
+         return current->reader->read(tagName,attribs,begin,amount,outBuffer,allocateMemory);
+      }
+
+      if (allocateMemory == true) outBuffer = NULL;
+      if (amount == 0) return true;
+      if (begin + amount > arraySize) {
+         std::cerr << "vlsv::PrefetchReader ERROR: Requested read exceeds array size" << std::endl;
+         return false;
+      }
+      if (allocateMemory == true) outBuffer = new T[amount*vectorSize];
+      if (convertArray<T>(outBuffer,data+begin*vectorSize*dataSize,amount*vectorSize,dataType,dataSize,false) == false) {
+         std::cerr << "vlsv::PrefetchReader ERROR: Unsupported datatype in read" << std::endl;
+         if (allocateMemory == true) {delete [] outBuffer; outBuffer = NULL;}
+         return false;
+      }
+      return true;
+   }
+
+} // namespace vlsv
+
+#endif
@@ -20,30 +20,64 @@
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <cstring>
+#include <algorithm>
 
 #include "mpiconversion.h"
 #include "vlsv_common_mpi.h"
+#include "vlsv_footer.h"
 #include "vlsv_writer.h"
 
 using namespace std;
 
+static const uint64_t DEFAULT_CHUNK_BYTES = 4194304;
+
 namespace vlsv {
 
+   /** Get the subfile a process writes to. Processes are divided into subfiles in rank order.
+    * @param rank Rank of the process.
+    * @param processes Number of processes.
+    * @param subfiles Number of subfiles.
+    * @return Index of the subfile.*/
+   static int getSubfile(const int& rank,const int& processes,const int& subfiles) {
+      return (static_cast<int64_t>(rank)*subfiles) / processes;
+   }
+
    /** Constructor for Writer.*/
    Writer::Writer() {
+      aggregationSegment = NULL;
+      aggregationWindow = MPI_WIN_NULL;
+      aggregationWindowBytes = 0;
+      aggregatorComm = MPI_COMM_NULL;
+      aggregatorPlacement = aggregation::SPREAD;
+      aggregatorsPerNode = 0;
+      batchStarted = false;
+      binaryFooter = false;
       blockLengths = NULL;
       bytesPerProcess = NULL;
+      chunkSize = 0;
+      codec = NULL;
+      shuffleChunks = false;
+      deferWrites = false;
       displacements = NULL;
       dryRunning = false;
       endMultiwriteCounter = 0;
       fileOpen = false;
+      groupComm = MPI_COMM_NULL;
       initialized = false;
       multiwriteFinalized = false;
       multiwriteInitialized = false;
       multiwriteOffsetPointer = NULL;
+      N_aggregators = 0;
       N_multiwriteUnits = 0;
+      N_subfiles = 1;
+      nextRequestID = 0;
       offset = 0;
       offsets = NULL;
+      stagingBytes = 0;
+      stagingLimit = 0;
+      subfileComm = MPI_COMM_NULL;
+      subfileOffset = 0;
       types = NULL;
       xmlWriter = NULL;
       comm = MPI_COMM_NULL;
@@ -62,6 +96,77 @@ namespace vlsv {
       delete xmlWriter; xmlWriter = NULL;
    }
 
+   /** Insert an entry for an array to the XML footer kept in memory. Only master process should call this function.
+    * @param tagName Name of the XML tag.
+    * @param attribs Attributes given to the new footer entry.
+    * @param arrayOffset Offset of the array relative to file start.
+    * @param arraySize Total number of elements in the array.
+    * @return Pointer to the inserted XML node.*/
+   muxml::XMLNode* Writer::addFooterEntry(const std::string& tagName,const std::map<std::string,std::string>& attribs,
+                                          const uint64_t& arrayOffset,const uint64_t& arraySize) {
+      muxml::XMLNode* root = xmlWriter->getRoot();
+      muxml::XMLNode* xmlnode = xmlWriter->find("VLSV",root);
+      muxml::XMLNode* node = xmlWriter->addNode(xmlnode,tagName,arrayOffset);
+      for (map<string,string>::const_iterator it=attribs.begin(); it!=attribs.end(); ++it) {
+         xmlWriter->addAttribute(node,it->first,it->second);
+      }
+      xmlWriter->addAttribute(node,"vectorsize",vectorSize);
+      xmlWriter->addAttribute(node,"arraysize",arraySize);
+      xmlWriter->addAttribute(node,"datatype",dataType);
+      xmlWriter->addAttribute(node,"datasize",dataSize);
+      return node;
+   }
+
+   /** Add an array to the current batch. The array is written to the output file 
+    * in commitBatch. This function does not call any MPI functions. All processes 
+    * must add the same arrays in the same order.
+    * @param arrayName Name of the array. Only significant on master process.
+    * @param attribs XML attributes for the array. Only significant on master process.
+    * @param dataType String representation of the datatype. Only significant on master process.
+    * @param arraySize Number of array elements written by this process.
+    * @param vectorSize Size of the data vector stored in each array element. Must have the same value on all processes.
+    * @param dataSize Byte size of vector element. Must have the same value on all processes.
+    * @param array Pointer to data. Must remain valid until commitBatch returns.
+    * @return If true, the array was added to the batch.
+    * @see beginBatch.*/
+   bool Writer::addArray(const std::string& arrayName,const std::map<std::string,std::string>& attribs,const std::string& dataType,
+                         const uint64_t& arraySize,const uint64_t& vectorSize,const uint64_t& dataSize,const char* array) {
+      if (batchStarted == false) {
+         cerr << "(VLSV) ERROR: vlsv::Writer::addArray called before beginBatch" << endl;
+         return false;
+      }
+      BatchArray batchArray;
+      batchArray.tagName    = arrayName;
+      batchArray.attribs    = attribs;
+      batchArray.dataType   = dataType;
+      batchArray.arraySize  = arraySize;
+      batchArray.vectorSize = vectorSize;
+      batchArray.dataSize   = dataSize;
+      batchArray.array      = array;
+      batchArrays.push_back(batchArray);
+      return true;
+   }
+
+   /** Add attributes describing the location of an array in subfiles to a footer entry.
+    * @param node Footer entry of the array.
+    * @param subfileOffsets Offset of the array in each subfile.
+    * @param subfileElements Number of array elements in each subfile.*/
+   void Writer::addSubfileAttributes(muxml::XMLNode* node,const std::vector<uint64_t>& subfileOffsets,
+                                     const std::vector<uint64_t>& subfileElements) {
+      stringstream offsetList,elementList;
+      for (size_t i=0; i<subfileOffsets.size(); ++i) {
+         if (i > 0) {
+            offsetList << ',';
+            elementList << ',';
+         }
+         offsetList << subfileOffsets[i];
+         elementList << subfileElements[i];
+      }
+      xmlWriter->addAttribute(node,"subfiles",subfileOffsets.size());
+      xmlWriter->addAttribute(node,"subfile_offsets",offsetList.str());
+      xmlWriter->addAttribute(node,"subfile_elements",elementList.str());
+   }
+
    /** Add a multi-write unit. Function startMultiwrite must have been called 
     * by all processes prior to calling addMultiwriteUnit. The process must 
     * call endMultiwrite after it has added all multi-write units.
@@ -109,6 +214,85 @@ namespace vlsv {
       return true;
    }
 
+   /** Redistribute array data so that chunk boundaries are at global array indices 
+    * that are multiples of elementsPerChunk. Each chunk is moved to the process that 
+    * has the first element of the chunk, thus typically only a partial chunk at 
+    * the end of each process' data is sent to the next process. No data is moved 
+    * if all processes already start at a chunk boundary.
+    * @param data Pointer to this process' data. On exit points to the redistributed data.
+    * @param aligned Buffer in which redistributed data is stored, if data was moved.
+    * @param myElements Number of array elements on this process. On exit the number of 
+    * redistributed array elements on this process.
+    * @param elementBytes Byte size of an array element.
+    * @param elementsPerChunk Number of array elements in each chunk.
+    * @return If true, data was redistributed successfully. The return value is the same on all processes.*/
+   bool Writer::alignChunks(const char*& data,std::vector<char>& aligned,uint64_t& myElements,
+                            const uint64_t& elementBytes,const uint64_t& elementsPerChunk) {
+      // Calculate current and chunk-aligned array index ranges of all processes:
+      vector<uint64_t> elements(N_processes);
+      MPI_Allgather(&myElements,1,MPI_Type<uint64_t>(),elements.data(),1,MPI_Type<uint64_t>(),comm);
+      vector<uint64_t> oldBegin(N_processes+1,0);
+      for (int p=0; p<N_processes; ++p) oldBegin[p+1] = oldBegin[p] + elements[p];
+      vector<uint64_t> newBegin(N_processes+1);
+      bool chunksAligned = true;
+      for (int p=0; p<=N_processes; ++p) {
+         newBegin[p] = min(oldBegin[N_processes],(oldBegin[p]+elementsPerChunk-1)/elementsPerChunk*elementsPerChunk);
+         if (newBegin[p] != oldBegin[p]) chunksAligned = false;
+      }
+      if (chunksAligned == true) return true;
+
+      // Calculate how many elements are sent to, and received from, each process:
+      bool success = true;
+      if (newBegin[myrank+1]-newBegin[myrank] > (uint64_t)numeric_limits<int>::max()) success = false;
+      if (oldBegin[myrank+1]-oldBegin[myrank] > (uint64_t)numeric_limits<int>::max()) success = false;
+      if (success == false) {
+         cerr << "(VLSV) ERROR: Too many array elements on process " << myrank << " to align chunks in vlsv::Writer" << endl;
+      }
+      if (checkSuccess(success,comm) == false) return false;
+
+      vector<int> sendCounts(N_processes,0),sendDispls(N_processes,0);
+      vector<int> recvCounts(N_processes,0),recvDispls(N_processes,0);
+      for (int p=0; p<N_processes; ++p) {
+         const uint64_t sendBegin = max(oldBegin[myrank],newBegin[p]);
+         const uint64_t sendEnd   = min(oldBegin[myrank+1],newBegin[p+1]);
+         const uint64_t recvBegin = max(newBegin[myrank],oldBegin[p]);
+         const uint64_t recvEnd   = min(newBegin[myrank+1],oldBegin[p+1]);
+         if (sendEnd > sendBegin) {
+            sendCounts[p] = sendEnd - sendBegin;
+            sendDispls[p] = sendBegin - oldBegin[myrank];
+         }
+         if (recvEnd > recvBegin) {
+            recvCounts[p] = recvEnd - recvBegin;
+            recvDispls[p] = recvBegin - newBegin[myrank];
+         }
+      }
+
+      MPI_Datatype elementType;
+      MPI_Type_contiguous(elementBytes,MPI_BYTE,&elementType);
+      MPI_Type_commit(&elementType);
+      myElements = newBegin[myrank+1] - newBegin[myrank];
+      aligned.resize(myElements*elementBytes);
+      if (MPI_Alltoallv(const_cast<char*>(data),sendCounts.data(),sendDispls.data(),elementType,
+                        aligned.data(),recvCounts.data(),recvDispls.data(),elementType,comm) != MPI_SUCCESS) success = false;
+      MPI_Type_free(&elementType);
+      data = aligned.data();
+      return checkSuccess(success,comm);
+   }
+
+   /** Start a batch of array writes. Arrays are added to the batch with addArray 
+    * and written to the output file with commitBatch. Compared to calling writeArray 
+    * for each array, the file offsets of all arrays in a batch are calculated with 
+    * a single metadata collective, and the data is written with a single collective 
+    * call through a combined file view. This function does not call any MPI functions.
+    * @return If true, a new batch was started.
+    * @see addArray
+    * @see commitBatch.*/
+   bool Writer::beginBatch() {
+      batchArrays.clear();
+      batchStarted = true;
+      return true;
+   }
+
    /** Close a file that has been previously opened by calling Writer::open.
     * After the file has been closed the MPI master process appends an XML footer 
     * to the end of the file, and writes an offset to the footer to the start of 
@@ -119,13 +303,20 @@ namespace vlsv {
       // If a file was never opened, exit immediately:
       if (fileOpen == false) return false;
 
+      // Complete all non-blocking writes that are still in progress:
+      waitAll();
+
+      // Aggregators and subfile writers close their file handles so that 
+      // all data has been written before the footer is appended:
+      closeAggregation();
+      closeSubfiles();
+
       // Wait until all processes have finished writing data to file.
-      // This is important to ensure that MPI_File_seek below will 
+      // This is important to ensure that MPI_File_get_size below will 
       // read the correct file size.
       MPI_Barrier(comm);
       
-      MPI_Offset viewOffset;
-      MPI_Offset endOffset;
+      MPI_Offset endOffset = 0;
 
       // Write the footer using collective MPI file operations. Only the master process 
       // actually writes something. Using collective MPI here practically eliminated 
@@ -136,10 +327,28 @@ namespace vlsv {
             MPI_File_write_at_all(fileptr,0,NULL,0,MPI_BYTE,MPI_STATUSES_IGNORE);
          }
       } else {
-         if (dryRunning == false) {
-            MPI_File_seek(fileptr,0,MPI_SEEK_END);
-            MPI_File_get_position(fileptr,&viewOffset);
-            MPI_File_get_byte_offset(fileptr,viewOffset,&endOffset);
+         // Footer is appended to the end of file. File size is queried directly 
+         // because some MPI implementations return a wrong position from 
+         // MPI_File_seek(MPI_SEEK_END) for files larger than a few megabytes:
+         if (dryRunning == false) MPI_File_get_size(fileptr,&endOffset);
+
+         // Deferred arrays are written just before the footer:
+         for (size_t i=0; i<deferredArrays.size(); ++i) {
+            const DeferredArray& deferred = deferredArrays[i];
+            vectorSize = deferred.vectorSize;
+            dataSize   = deferred.dataSize;
+            dataType   = deferred.dataType;
+            addFooterEntry(deferred.tagName,deferred.attribs,endOffset+deferred.bufferOffset,deferred.arraySize);
+         }
+         bytesWritten += deferredData.size();
+
+         // Binary footer index is written just before the XML footer:
+         if (binaryFooter == true) {
+            const size_t dataBytes = deferredData.size();
+            if (encodeFooterIndex(*xmlWriter,deferredData) == false) {
+               cerr << "(VLSV) WARNING: Failed to create binary footer index in vlsv::Writer::close" << endl;
+            }
+            bytesWritten += deferredData.size() - dataBytes;
          }
 
          // Print the footer to a stringstream first and then grab a 
@@ -147,14 +356,18 @@ namespace vlsv {
          stringstream footerStream;
          xmlWriter->print(footerStream);
          string footerString = footerStream.str();
+         deferredData.insert(deferredData.end(),footerString.begin(),footerString.end());
          
          double t_start = MPI_Wtime();
          if (dryRunning == false) {
-            MPI_File_write_at_all(fileptr,endOffset,(char*)footerString.c_str(),footerString.size(),MPI_BYTE,MPI_STATUSES_IGNORE);
+            MPI_File_write_at_all(fileptr,endOffset,deferredData.data(),deferredData.size(),MPI_BYTE,MPI_STATUSES_IGNORE);
          }
          writeTime += (MPI_Wtime() - t_start);
-         bytesWritten += footerStream.str().size();
+         bytesWritten += footerString.size();
+         endOffset += deferredData.size() - footerString.size();
       }
+      deferredArrays.clear();
+      deferredData.clear();
 
       // Close MPI file:
       MPI_Barrier(comm);
@@ -196,6 +409,17 @@ namespace vlsv {
     * @return Total number of bytes written to output files by all processes.*/
    uint64_t Writer::getBytesWritten() const {return bytesWritten;}
 
+   /** Get the total number of aggregator processes that write array data to 
+    * the output file, see setAggregation.
+    * @return Number of aggregators, or zero if aggregation is not in use.*/
+   int Writer::getAggregatorCount() const {return N_aggregators;}
+
+   /** Get the ranks of aggregator processes that write array data to 
+    * the output file, see setAggregation. Same value on all processes.
+    * @return Ranks of aggregators in the communicator given to open, sorted in 
+    * ascending order. Empty if aggregation is not in use.*/
+   const std::vector<int>& Writer::getAggregatorRanks() const {return aggregatorRanks;}
+
    /** Get the time (in seconds) spent in writing the data to the output file.
     * Approximate data rate can be obtained by getBytesWritter() / getWrite().
     * @return Time spent in file I/O in seconds.*/
@@ -212,8 +436,14 @@ namespace vlsv {
     * @param mpiInfo MPI info, passed on to MPI_File_open. Must have the same value on all processes.
     * @param append If true, then data should be appended to existing vlsv file instead of rewriting it.
     * Only significant on master process.
+    * @param subfiles Number of physical subfiles array data is written to. If larger than one, processes 
+    * are divided into groups of consecutive ranks and each group writes arrays to its own subfile 
+    * named fname.0, fname.1, etc. The file fname contains the header, footer, and arrays written 
+    * by master process only or with compression. Subfiles must be kept in the same directory as 
+    * fname. Appending is not supported with subfiles. Must have the same value on all processes.
     * @return If true, a file was opened successfully.*/
-   bool Writer::open(const std::string& fname,MPI_Comm comm,const int& masterProcessID,MPI_Info mpiInfo,bool append) {
+   bool Writer::open(const std::string& fname,MPI_Comm comm,const int& masterProcessID,MPI_Info mpiInfo,bool append,
+                     int subfiles) {
       bool success = true;
    
       // If a file with the same name has already been opened, return immediately.
@@ -230,6 +460,7 @@ namespace vlsv {
       MPI_Comm_size(this->comm,&N_processes);
       bytesWritten = 0;
       writeTime = 0;
+      N_subfiles = max(1,min(subfiles,N_processes));
 
       // Broadcast output file name to all processes:
       if (broadcast(fname,fileName,this->comm,masterRank) == false) return false;
@@ -294,6 +525,10 @@ namespace vlsv {
       // Master writes 2 64bit integers to the start of file. 
       // Second value will be overwritten in close() function to tell 
       // the position of footer:
+      if (myrank == masterRank && append == true && N_subfiles > 1) {
+         cerr << "(VLSV) ERROR: Appending to a file is not supported with subfiles in vlsv::Writer::open" << endl;
+         success = false;
+      }
       if (myrank == masterRank) {
          if (append == false) {
             // Write file endianness to the first byte:
@@ -326,6 +561,31 @@ namespace vlsv {
          delete xmlWriter; xmlWriter = NULL;
       }
 
+      // Open subfiles:
+      if (success == true && N_subfiles > 1) {
+         if (openSubfiles(mpiInfo) == false) {
+            closeSubfiles();
+            if (dryRunning == false) MPI_File_close(&fileptr);
+            delete [] offsets; offsets = NULL;
+            delete [] bytesPerProcess; bytesPerProcess = NULL;
+            delete xmlWriter; xmlWriter = NULL;
+            success = false;
+         }
+      }
+
+      // Set up node-local write aggregation. If this fails, 
+      // arrays are written without aggregation:
+      bool aggregate = (aggregatorsPerNode > 0);
+      if (aggregatorPlacement == aggregation::RANKS) aggregate = (aggregatorList.size() > 0);
+      if (success == true && aggregate == true && N_subfiles > 1) {
+         if (myrank == masterRank) cerr << "(VLSV) WARNING: Write aggregation is not supported with subfiles, writing without aggregation" << endl;
+      } else if (success == true && aggregate == true) {
+         if (openAggregation(mpiInfo) == false) {
+            if (myrank == masterRank) cerr << "(VLSV) WARNING: Failed to set up write aggregation, writing without aggregation" << endl;
+            closeAggregation();
+         }
+      }
+
       initialized = true;
       fileOpen    = success;
       return fileOpen;
@@ -389,10 +649,32 @@ namespace vlsv {
       N_multiwriteUnits = 0;
       endMultiwriteCounter = 0;
 
-      // Gather the number of bytes written by every process to MPI master process:
+      // Compressed arrays calculate file offsets in endMultiwrite after the data has been compressed:
       myBytes = arraySize * vectorSize * dataSize;
+      if (codec != NULL) {
+         multiwriteInitialized = true;
+         return multiwriteInitialized;
+      }
+
+      // Gather the number of bytes written by every process to MPI master process:
       MPI_Gather(&myBytes,1,MPI_Type<uint64_t>(),bytesPerProcess,1,MPI_Type<uint64_t>(),masterRank,comm);
 
+      // With subfiles each process writes to the end of its subfile. 
+      // Processes writing to the same subfile have consecutive ranks:
+      if (subfileComm != MPI_COMM_NULL) {
+         if (myrank == masterRank) {
+            vector<uint64_t> ends = subfileEnds;
+            for (int i=0; i<N_processes; ++i) {
+               const int subfile = getSubfile(i,N_processes,N_subfiles);
+               offsets[i] = ends[subfile];
+               ends[subfile] += bytesPerProcess[i];
+            }
+         }
+         MPI_Scatter(offsets,1,MPI_Type<uint64_t>(),&subfileOffset,1,MPI_Type<uint64_t>(),masterRank,comm);
+         multiwriteInitialized = true;
+         return multiwriteInitialized;
+      }
+
       // MPI master process calculates an offset to the output file for all processes:
       if (myrank == masterRank) {
          offsets[0] = offset;
@@ -411,6 +693,331 @@ namespace vlsv {
     * @param attribs Attributes for the XML tag. Only significant on master process.
     * @return If true, array was successfully written to file. The return value is the same on all processes.*/
    bool Writer::endMultiwrite(const std::string& tagName,const std::map<std::string,std::string>& attribs) {
+      return multiwriteWrite(tagName,attribs,NULL);
+   }
+
+   /** Write all arrays added to the current batch to the output file. File offsets 
+    * of all arrays are calculated from a single MPI_Allgather of array sizes. Each 
+    * process then writes all of its data with one collective call through a file 
+    * view containing its regions in all arrays. More calls are made only if the 
+    * data exceeds the maximum size of a single MPI write. Compressed arrays, 
+    * aggregated writes, and master-only writes do not support batching, and the 
+    * arrays are then written one by one with writeArray.
+    * @return If true, all arrays were written successfully. The return value is the same on all processes.
+    * @see beginBatch.*/
+   bool Writer::commitBatch() {
+      bool success = true;
+      if (batchStarted == false) {
+         cerr << "(VLSV) ERROR: vlsv::Writer::commitBatch called before beginBatch" << endl;
+         success = false;
+      }
+      batchStarted = false;
+      vector<BatchArray> arrays;
+      arrays.swap(batchArrays);
+
+      if (writeUsingMasterOnly == true || codec != NULL || groupComm != MPI_COMM_NULL) {
+         if (checkSuccess(success,comm) == false) return false;
+         for (size_t a=0; a<arrays.size(); ++a) {
+            const BatchArray& b = arrays[a];
+            if (writeArray(b.tagName,b.attribs,b.dataType,b.arraySize,b.vectorSize,b.dataSize,b.array) == false) success = false;
+         }
+         return success;
+      }
+      if (initialized == false) success = false;
+      if (fileOpen == false) success = false;
+
+      // File views can not be changed while non-blocking writes are in progress:
+      if (waitAll() == false) success = false;
+
+      // Split this process' data into blocks that fit into a single MPI call, and 
+      // group consecutive blocks into collective calls:
+      const uint64_t maxBytes = getMaxBytesPerWrite();
+      vector<uint64_t> mySizes(arrays.size());
+      vector<pair<const char*,uint64_t> > blocks;
+      vector<size_t> callBlocks(1,0);
+      uint64_t callBytes = 0;
+      for (size_t a=0; a<arrays.size(); ++a) {
+         mySizes[a] = arrays[a].arraySize;
+         const uint64_t bytes = arrays[a].arraySize*arrays[a].vectorSize*arrays[a].dataSize;
+         for (uint64_t b=0; b<bytes; b+=maxBytes) {
+            const uint64_t blockBytes = min(maxBytes,bytes-b);
+            if (callBytes + blockBytes > maxBytes) {
+               callBlocks.push_back(blocks.size());
+               callBytes = 0;
+            }
+            blocks.push_back(make_pair(arrays[a].array+b,blockBytes));
+            callBytes += blockBytes;
+         }
+      }
+      callBlocks.push_back(blocks.size());
+      const size_t myCalls = callBlocks.size()-1;
+
+      // Single reduction of the error status, number of arrays, number of collective 
+      // calls, and current file (or subfile) sizes known by master process:
+      vector<int64_t> values(4+N_subfiles,0);
+      if (success == false) values[0] = 1;
+      values[1] = arrays.size();
+      values[2] = -static_cast<int64_t>(arrays.size());
+      values[3] = myCalls;
+      if (myrank == masterRank) {
+         for (int s=0; s<N_subfiles; ++s) {
+            if (subfileComm == MPI_COMM_NULL) values[4+s] = offset;
+            else values[4+s] = subfileEnds[s];
+         }
+      }
+      vector<int64_t> maxValues(values.size());
+      MPI_Allreduce(values.data(),maxValues.data(),values.size(),MPI_Type<int64_t>(),MPI_MAX,comm);
+      if (maxValues[0] != 0) return false;
+      if (maxValues[1] != -maxValues[2]) {
+         if (myrank == masterRank) cerr << "(VLSV) ERROR: Processes added different number of arrays to batch in vlsv::Writer" << endl;
+         return false;
+      }
+      if (arrays.size() == 0) return true;
+
+      // Gather array sizes and calculate file offsets of all arrays:
+      const size_t N_arrays = arrays.size();
+      vector<uint64_t> sizes(N_arrays*N_processes);
+      MPI_Allgather(mySizes.data(),N_arrays,MPI_Type<uint64_t>(),sizes.data(),N_arrays,MPI_Type<uint64_t>(),comm);
+
+      vector<uint64_t> ends(maxValues.begin()+4,maxValues.end());
+      vector<MPI_Aint> myOffsets(N_arrays);
+      for (size_t a=0; a<N_arrays; ++a) {
+         const uint64_t elementBytes = arrays[a].vectorSize*arrays[a].dataSize;
+         vector<uint64_t> arrayOffsets = ends;
+         vector<uint64_t> arrayElements(N_subfiles,0);
+         for (int p=0; p<N_processes; ++p) {
+            const int s = (subfileComm == MPI_COMM_NULL) ? 0 : getSubfile(p,N_processes,N_subfiles);
+            if (p == myrank) myOffsets[a] = ends[s];
+            ends[s] += sizes[p*N_arrays+a]*elementBytes;
+            arrayElements[s] += sizes[p*N_arrays+a];
+         }
+
+         // Master process inserts the footer entry:
+         if (myrank == masterRank) {
+            vectorSize = arrays[a].vectorSize;
+            dataSize   = arrays[a].dataSize;
+            dataType   = arrays[a].dataType;
+            uint64_t totalElements = 0;
+            for (int s=0; s<N_subfiles; ++s) totalElements += arrayElements[s];
+            if (subfileComm == MPI_COMM_NULL) {
+               addFooterEntry(arrays[a].tagName,arrays[a].attribs,arrayOffsets[0],totalElements);
+            } else {
+               muxml::XMLNode* node = addFooterEntry(arrays[a].tagName,arrays[a].attribs,0,totalElements);
+               addSubfileAttributes(node,arrayOffsets,arrayElements);
+            }
+            bytesWritten += totalElements*elementBytes;
+         }
+      }
+      if (myrank == masterRank) {
+         if (subfileComm == MPI_COMM_NULL) offset = ends[0];
+         else subfileEnds = ends;
+      }
+
+      if (dryRunning == true) return true;
+
+      // Create a file view containing this process' regions in all arrays:
+      MPI_File file = (subfileComm == MPI_COMM_NULL) ? fileptr : subfilePtr;
+      vector<uint64_t> lengths;
+      vector<MPI_Aint> displacements;
+      for (size_t a=0; a<N_arrays; ++a) {
+         const uint64_t bytes = arrays[a].arraySize*arrays[a].vectorSize*arrays[a].dataSize;
+         for (uint64_t b=0; b<bytes; b+=maxBytes) {
+            lengths.push_back(min(maxBytes,bytes-b));
+            displacements.push_back(myOffsets[a]+b);
+         }
+      }
+      MPI_Datatype fileType = MPI_BYTE;
+      if (blocks.size() > 0) {
+         typeCreateHindexed(lengths.size(),lengths.data(),displacements.data(),MPI_BYTE,&fileType);
+         MPI_Type_commit(&fileType);
+      }
+      if (MPI_File_set_view(file,0,MPI_BYTE,fileType,const_cast<char*>("native"),MPI_INFO_NULL) != MPI_SUCCESS) success = false;
+
+      // Write data, each call writes several arrays from their original memory locations:
+      const double t_start = MPI_Wtime();
+      MPI_Offset viewOffset = 0;
+      for (int64_t c=0; c<maxValues[3]; ++c) {
+         if (static_cast<size_t>(c) >= myCalls) {
+            if (MPI_File_write_at_all(file,viewOffset,NULL,0,MPI_BYTE,MPI_STATUS_IGNORE) != MPI_SUCCESS) success = false;
+            continue;
+         }
+         const size_t N_blocks = callBlocks[c+1]-callBlocks[c];
+         vector<uint64_t> memLengths(N_blocks);
+         vector<MPI_Aint> memAddresses(N_blocks);
+         uint64_t bytes = 0;
+         for (size_t i=0; i<N_blocks; ++i) {
+            memLengths[i] = blocks[callBlocks[c]+i].second;
+            MPI_Get_address(const_cast<char*>(blocks[callBlocks[c]+i].first),&(memAddresses[i]));
+            bytes += memLengths[i];
+         }
+         MPI_Datatype memType;
+         typeCreateHindexed(N_blocks,memLengths.data(),memAddresses.data(),MPI_BYTE,&memType);
+         MPI_Type_commit(&memType);
+         if (MPI_File_write_at_all(file,viewOffset,MPI_BOTTOM,1,memType,MPI_STATUS_IGNORE) != MPI_SUCCESS) success = false;
+         MPI_Type_free(&memType);
+         viewOffset += bytes;
+      }
+      writeTime += (MPI_Wtime() - t_start);
+
+      // Restore the default file view:
+      MPI_File_set_view(file,0,MPI_BYTE,MPI_BYTE,const_cast<char*>("native"),MPI_INFO_NULL);
+      if (blocks.size() > 0) MPI_Type_free(&fileType);
+      return checkSuccess(success,comm);
+   }
+
+   /** Close the file handle of aggregator processes, and free the shared memory window 
+    * and aggregation communicators. Does nothing if aggregation is not in use.*/
+   void Writer::closeAggregation() {
+      if (groupComm == MPI_COMM_NULL) return;
+      if (aggregatorComm != MPI_COMM_NULL) {
+         if (dryRunning == false) MPI_File_close(&aggregatorFilePtr);
+         MPI_Comm_free(&aggregatorComm);
+      }
+      if (aggregationWindow != MPI_WIN_NULL) MPI_Win_free(&aggregationWindow);
+      aggregationSegment = NULL;
+      aggregationWindowBytes = 0;
+      MPI_Comm_free(&groupComm);
+      aggregatorRanks.clear();
+      N_aggregators = 0;
+   }
+
+   /** Close subfiles and free the subfile communicator. Does nothing if subfiling is not in use.*/
+   void Writer::closeSubfiles() {
+      if (subfileComm == MPI_COMM_NULL) return;
+      if (dryRunning == false) MPI_File_close(&subfilePtr);
+      MPI_Comm_free(&subfileComm);
+   }
+
+   /** Complete the given non-blocking write and release its staging buffer.
+    * @param it Iterator to the pending write, removed from pendingWrites on exit.
+    * @return If true, all MPI requests of the write completed successfully.*/
+   bool Writer::completeWrite(std::list<PendingWrite>::iterator& it) {
+      bool success = true;
+      if (it->requests.size() > 0) {
+         const double t_start = MPI_Wtime();
+         if (MPI_Waitall(it->requests.size(),it->requests.data(),MPI_STATUSES_IGNORE) != MPI_SUCCESS) success = false;
+         writeTime += (MPI_Wtime() - t_start);
+      }
+      stagingBytes -= it->staging.size();
+      it = pendingWrites.erase(it);
+      return success;
+   }
+
+   /** Get the maximum number of bytes used for staging copies of non-blocking writes.
+    * @return Maximum size of staging buffers in bytes.
+    * @see setStagingBufferSize.*/
+   uint64_t Writer::getStagingBufferSize() const {return stagingLimit;}
+
+   /** Non-blocking version of endMultiwrite. File offsets and the footer entry 
+    * are calculated before this function returns, but the data is written to 
+    * the file in the background. The write must be completed by calling wait, 
+    * waitAll, or close, or by polling test until it returns completed=true. 
+    * Non-blocking writes are completed in the same order they were started.
+    * 
+    * If staging buffers have been enabled with setStagingBufferSize, the data in 
+    * multiwrite units is copied to a staging buffer and the caller may modify 
+    * or deallocate its arrays immediately after this function returns. If the 
+    * staging copy does not fit into the staging buffer, older writes are completed 
+    * first to release memory. If the data still does not fit, this process waits 
+    * for the write to finish before returning. If staging is disabled, the arrays 
+    * passed to addMultiwriteUnit must not be modified until the write has completed.
+    * @param tagName Name of the XML tag for this array. Only significant on master process.
+    * @param attribs Attributes for the XML tag. Only significant on master process.
+    * @param requestID Variable in which the ID of the started write is written.
+    * @return If true, the array write was started successfully. The return value is the same on all processes.
+    * @see wait
+    * @see test.*/
+   bool Writer::iendMultiwrite(const std::string& tagName,const std::map<std::string,std::string>& attribs,int& requestID) {
+      bool waitNow = false;
+      std::list<PendingWrite>::iterator pending = pendingWrites.insert(pendingWrites.end(),PendingWrite());
+      pending->requestID = nextRequestID;
+      requestID = nextRequestID;
+      ++nextRequestID;
+
+      // Compressed and aggregated arrays are written with blocking collectives:
+      if (stagingLimit > 0 && multiwriteInitialized == true && dryRunning == false && codec == NULL && groupComm == MPI_COMM_NULL) {
+         uint64_t unitBytes = 0;
+         for (list<Multi_IO_Unit>::const_iterator it=multiwriteUnits[0].begin(); it!=multiwriteUnits[0].end(); ++it) {
+            unitBytes += it->amount*dataSize;
+         }
+
+         // Complete older writes until the staging copy fits into staging buffer:
+         list<PendingWrite>::iterator it = pendingWrites.begin();
+         while (stagingBytes + unitBytes > stagingLimit && it != pending) completeWrite(it);
+
+         if (stagingBytes + unitBytes <= stagingLimit) {
+            // Copy multiwrite units into the staging buffer and replace the units 
+            // with ones that point to the staging copy:
+            pending->staging.resize(unitBytes);
+            stagingBytes += unitBytes;
+            list<Multi_IO_Unit> stagedUnits;
+            char* ptr = pending->staging.data();
+            for (list<Multi_IO_Unit>::const_iterator it=multiwriteUnits[0].begin(); it!=multiwriteUnits[0].end(); ++it) {
+               memcpy(ptr,it->array,it->amount*dataSize);
+               stagedUnits.push_back(Multi_IO_Unit(ptr,it->mpiType,it->amount));
+               ptr += it->amount*dataSize;
+            }
+            multiwriteUnits[0].swap(stagedUnits);
+         } else {
+            waitNow = true;
+         }
+      }
+
+      const bool success = multiwriteWrite(tagName,attribs,&(pending->requests));
+      if (waitNow == true || success == false) {
+         if (completeWrite(pending) == false) return false;
+      }
+      return success;
+   }
+
+   /** Query if this process is an aggregator, see setAggregation.
+    * @return If true, this process writes array data on behalf of other processes on the same node.*/
+   bool Writer::isAggregator() const {return aggregatorComm != MPI_COMM_NULL;}
+
+   /** Non-blocking version of writeArray. The data is written to file in the 
+    * background, see iendMultiwrite for details.
+    * @param arrayName Name of the array. Only significant on master process.
+    * @param attribs XML attributes for the array. Only significant on master process.
+    * @param dataType String representation of the datatype. Only significant on master process.
+    * @param arraySize Number of array elements written by this process.
+    * @param vectorSize Size of the data vector stored in each array element. Only significant on master process.
+    * @param dataSize Byte size of vector element. Only significant on master process.
+    * @param array Pointer to data.
+    * @param requestID Variable in which the ID of the started write is written.
+    * @return If true, the array write was started successfully. Same value is returned on every process.
+    * @see iendMultiwrite.*/
+   bool Writer::iwriteArray(const std::string& arrayName,const std::map<std::string,std::string>& attribs,const std::string& dataType,
+                            const uint64_t& arraySize,const uint64_t& vectorSize,const uint64_t& dataSize,const char* array,int& requestID) {
+      // Master-only writes are always blocking:
+      if (writeUsingMasterOnly == true) {
+         requestID = -1;
+         return writeArrayMaster(arrayName,attribs,dataType,arraySize,vectorSize,dataSize,array);
+      }
+
+      bool success = true;
+      if (initialized == false) success = false;
+      if (fileOpen == false) success = false;
+      if (checkSuccess(success,comm) == false) return false;
+
+      if (startMultiwrite(dataType,arraySize,vectorSize,dataSize) == false) return false;
+
+      char* arrayPtr = const_cast<char*>(array);
+      if (addMultiwriteUnit(arrayPtr,arraySize) == false) success = false;
+      if (checkSuccess(success,comm) == false) return false;
+
+      return iendMultiwrite(arrayName,attribs,requestID);
+   }
+
+   /** Write multiwrite units to file.
+    * @param tagName Name of the XML tag for this array. Only significant on master process.
+    * @param attribs Attributes for the XML tag. Only significant on master process.
+    * @param requests If not NULL, the data is written with non-blocking collectives 
+    * and the MPI requests are appended to this vector.
+    * @return If true, array was successfully written (or the write was started) to file. 
+    * The return value is the same on all processes.*/
+   bool Writer::multiwriteWrite(const std::string& tagName,const std::map<std::string,std::string>& attribs,std::vector<MPI_Request>* requests) {
+      if (codec != NULL) return multiwriteCompressed(tagName,attribs);
+
       // Check that multiwrite mode has started successfully on all processes:
       bool success = true;
       if (initialized == false) success = false;
@@ -427,6 +1034,14 @@ namespace vlsv {
          return false;
       }
 
+      // Aggregated arrays are written with blocking collectives by aggregator processes:
+      if (groupComm != MPI_COMM_NULL) {
+         if (multiwriteAggregated() == false) success = false;
+         if (multiwriteFooter(outputArrayName,attribs) == false) success = false;
+         multiwriteInitialized = false;
+         return checkSuccess(success,comm);
+      }
+
       // Calculate how many collective MPI calls are needed to 
       // write all the data to output file:
       uint64_t outputBytesize    = 0;
@@ -449,8 +1064,7 @@ namespace vlsv {
       }
       multiwriteList.push_back(make_pair(first,last));
 
-      uint64_t N_collectiveCalls;
-      MPI_Allreduce(&myCollectiveCalls,&N_collectiveCalls,1,MPI_Type<uint64_t>(),MPI_MAX,comm);
+      const uint64_t N_collectiveCalls = getCollectiveCalls(myCollectiveCalls,comm);
 
       if (N_collectiveCalls > multiwriteList.size()) {
          const uint64_t N_dummyCalls = N_collectiveCalls-multiwriteList.size();
@@ -461,7 +1075,12 @@ namespace vlsv {
 
       MPI_Offset unitOffset = 0;
       for (size_t i=0; i<multiwriteList.size(); ++i) {
-         if (multiwriteFlush(i,unitOffset,multiwriteList[i].first,multiwriteList[i].second) == false) success = false;
+         MPI_Request* request = NULL;
+         if (requests != NULL) {
+            requests->push_back(MPI_REQUEST_NULL);
+            request = &(requests->back());
+         }
+         if (multiwriteFlush(i,unitOffset,multiwriteList[i].first,multiwriteList[i].second,request) == false) success = false;
          for (std::list<Multi_IO_Unit>::iterator it=multiwriteList[i].first; it!=multiwriteList[i].second; ++it) {
             unitOffset += it->amount*dataSize;
          }
@@ -472,14 +1091,280 @@ namespace vlsv {
       return checkSuccess(success,comm);
    }
 
+   /** Write multiwrite units to file via node-local aggregators. Each process copies 
+    * its multiwrite units to its segment of an MPI shared memory window that is shared 
+    * by the processes of its aggregation group. Aggregators then write the data of their 
+    * group directly from the shared window with collective MPI calls over aggregatorComm.
+    * The window is kept until closeAggregation and reused for all arrays, it is only 
+    * reallocated if the data of a group process does not fit into its segment.
+    * @return If true, this process' data was written successfully.*/
+   bool Writer::multiwriteAggregated() {
+      bool success = true;
+
+      // Gather file offsets and byte sizes of group processes, and whether their 
+      // segments need to grow. The aggregator is not necessarily rank zero in 
+      // groupComm, so all processes receive the values:
+      int groupSize;
+      MPI_Comm_size(groupComm,&groupSize);
+      uint64_t myValues[3] = {static_cast<uint64_t>(offset),myBytes,0};
+      if (aggregationWindow == MPI_WIN_NULL || myBytes > aggregationWindowBytes) myValues[2] = 1;
+      vector<uint64_t> groupValues(3*groupSize);
+      MPI_Allgather(myValues,3,MPI_Type<uint64_t>(),groupValues.data(),3,MPI_Type<uint64_t>(),groupComm);
+
+      // Reallocate the shared window if any segment is too small. Other 
+      // processes keep their current segment size:
+      bool grow = false;
+      for (int i=0; i<groupSize; ++i) if (groupValues[3*i+2] != 0) grow = true;
+      if (grow == true) {
+         if (aggregationWindow != MPI_WIN_NULL) MPI_Win_free(&aggregationWindow);
+         aggregationWindowBytes = max(aggregationWindowBytes,myBytes);
+         if (MPI_Win_allocate_shared(aggregationWindowBytes,1,MPI_INFO_NULL,groupComm,&aggregationSegment,&aggregationWindow) != MPI_SUCCESS) {
+            cerr << "(VLSV) ERROR: Failed to allocate shared memory window in vlsv::Writer" << endl;
+            aggregationWindow = MPI_WIN_NULL;
+            aggregationWindowBytes = 0;
+            return false;
+         }
+      }
+
+      // Copy multiwrite units to this process' segment of the shared window:
+      char* ptr = aggregationSegment;
+      for (list<Multi_IO_Unit>::const_iterator it=multiwriteUnits[0].begin(); it!=multiwriteUnits[0].end(); ++it) {
+         memcpy(ptr,it->array,it->amount*dataSize);
+         ptr += it->amount*dataSize;
+      }
+      MPI_Win_fence(0,aggregationWindow);
+
+      if (aggregatorComm != MPI_COMM_NULL && dryRunning == false) {
+         // Segments of the shared window are contiguous in group rank order, 
+         // but segments may be larger than the data written by their owners:
+         vector<char*> groupData(groupSize);
+         for (int i=0; i<groupSize; ++i) {
+            MPI_Aint segmentBytes;
+            int displacementUnit;
+            MPI_Win_shared_query(aggregationWindow,i,&segmentBytes,&displacementUnit,&(groupData[i]));
+         }
+
+         // Create a file view that contains the file regions of group processes. 
+         // Regions are split so that each block fits into a single collective call:
+         vector<uint64_t> lengths;
+         vector<MPI_Aint> displacements;
+         vector<MPI_Aint> addresses;
+         for (int i=0; i<groupSize; ++i) {
+            for (uint64_t b=0; b<groupValues[3*i+1]; b+=getMaxBytesPerWrite()) {
+               MPI_Aint address;
+               MPI_Get_address(groupData[i]+b,&address);
+               lengths.push_back(min(getMaxBytesPerWrite(),groupValues[3*i+1]-b));
+               displacements.push_back(groupValues[3*i]+b);
+               addresses.push_back(address);
+            }
+         }
+         MPI_Datatype fileType = MPI_BYTE;
+         if (lengths.size() > 0) {
+            typeCreateHindexed(lengths.size(),lengths.data(),displacements.data(),MPI_BYTE,&fileType);
+            MPI_Type_commit(&fileType);
+         }
+         if (MPI_File_set_view(aggregatorFilePtr,0,MPI_BYTE,fileType,const_cast<char*>("native"),MPI_INFO_NULL) != MPI_SUCCESS) success = false;
+
+         // Divide the blocks between collective calls so that each call writes at most 
+         // getMaxBytesPerWrite() bytes, and calculate how many calls all aggregators make:
+         vector<size_t> callBlocks(1,0);
+         uint64_t callBytes = 0;
+         for (size_t i=0; i<lengths.size(); ++i) {
+            if (callBytes + lengths[i] > getMaxBytesPerWrite()) {
+               callBlocks.push_back(i);
+               callBytes = 0;
+            }
+            callBytes += lengths[i];
+         }
+         callBlocks.push_back(lengths.size());
+         const uint64_t myCalls = callBlocks.size()-1;
+         const uint64_t N_calls = getCollectiveCalls(myCalls,aggregatorComm);
+
+         // Write data, each call gathers data from several segments of the shared window:
+         const double t_start = MPI_Wtime();
+         MPI_Offset viewOffset = 0;
+         for (uint64_t c=0; c<N_calls; ++c) {
+            if (c >= myCalls || lengths.size() == 0) {
+               if (fileWriteAtAll(aggregatorFilePtr,viewOffset,NULL,0,MPI_BYTE,MPI_STATUS_IGNORE) != MPI_SUCCESS) success = false;
+               continue;
+            }
+            const size_t N_blocks = callBlocks[c+1]-callBlocks[c];
+            uint64_t bytes = 0;
+            for (size_t i=0; i<N_blocks; ++i) bytes += lengths[callBlocks[c]+i];
+            MPI_Datatype memType;
+            typeCreateHindexed(N_blocks,&(lengths[callBlocks[c]]),&(addresses[callBlocks[c]]),MPI_BYTE,&memType);
+            MPI_Type_commit(&memType);
+            if (fileWriteAtAll(aggregatorFilePtr,viewOffset,MPI_BOTTOM,1,memType,MPI_STATUS_IGNORE) != MPI_SUCCESS) success = false;
+            MPI_Type_free(&memType);
+            viewOffset += bytes;
+         }
+         writeTime += (MPI_Wtime() - t_start);
+         if (lengths.size() > 0) MPI_Type_free(&fileType);
+      }
+
+      // Group processes must not overwrite their segments with the next 
+      // array until the aggregator has written the data:
+      MPI_Win_fence(0,aggregationWindow);
+      return success;
+   }
+
+   /** Compress multiwrite units and write them to file. Each process splits its data 
+    * into chunks of chunkSize array elements and compresses them independently. File 
+    * offsets are calculated with an exclusive scan over the compressed byte sizes. 
+    * Master process gathers the chunk table and writes it after the compressed data.
+    * @param tagName Name of the XML tag for this array. Only significant on master process.
+    * @param attribs Attributes for the XML tag. Only significant on master process.
+    * @return If true, array was successfully written to file. The return value is the same on all processes.*/
+   bool Writer::multiwriteCompressed(const std::string& tagName,const std::map<std::string,std::string>& attribs) {
+      bool success = true;
+      if (initialized == false) success = false;
+      if (multiwriteInitialized == false) success = false;
+      if (checkSuccess(success,comm) == false) {
+         multiwriteInitialized = false;
+         return false;
+      }
+
+      // Copy multiwrite units into a contiguous buffer, unless there is only one unit:
+      uint64_t unitBytes = 0;
+      for (list<Multi_IO_Unit>::const_iterator it=multiwriteUnits[0].begin(); it!=multiwriteUnits[0].end(); ++it) {
+         unitBytes += it->amount*dataSize;
+      }
+      vector<char> packed;
+      const char* data = NULL;
+      if (multiwriteUnits[0].size() == 1) {
+         data = multiwriteUnits[0].front().array;
+      } else if (multiwriteUnits[0].size() > 1) {
+         packed.resize(unitBytes);
+         char* ptr = packed.data();
+         for (list<Multi_IO_Unit>::const_iterator it=multiwriteUnits[0].begin(); it!=multiwriteUnits[0].end(); ++it) {
+            memcpy(ptr,it->array,it->amount*dataSize);
+            ptr += it->amount*dataSize;
+         }
+         data = packed.data();
+      }
+
+      uint64_t elementBytes = vectorSize*dataSize;
+      if (elementBytes == 0) elementBytes = 1;
+      uint64_t elementsPerChunk = chunkSize;
+      if (elementsPerChunk == 0) elementsPerChunk = max<uint64_t>(1,DEFAULT_CHUNK_BYTES/elementBytes);
+
+      // Move data between processes so that every chunk starts at a multiple of 
+      // elementsPerChunk, readers then find chunks without searching the chunk table:
+      uint64_t myElements = unitBytes / elementBytes;
+      vector<char> aligned;
+      if (alignChunks(data,aligned,myElements,elementBytes,elementsPerChunk) == false) {
+         multiwriteInitialized = false;
+         return false;
+      }
+
+      // Compress chunks, possibly with several threads. Chunk table entries contain 
+      // offsets relative to the start of this process' data until the file offset is known:
+      const int64_t N_chunks = (myElements + elementsPerChunk - 1) / elementsPerChunk;
+      vector<vector<char> > chunkBuffers(N_chunks);
+      int64_t failedChunks = 0;
+      #ifdef _OPENMP
+      #pragma omp parallel for schedule(dynamic) reduction(+:failedChunks)
+      #endif
+      for (int64_t c=0; c<N_chunks; ++c) {
+         const uint64_t elements = min(elementsPerChunk,myElements-c*elementsPerChunk);
+         const char* chunk = data + c*elementsPerChunk*elementBytes;
+         vector<char> shuffled;
+         if (shuffleChunks == true) {
+            shuffled.resize(elements*elementBytes);
+            shuffle(chunk,shuffled.data(),elements*vectorSize,dataSize);
+            chunk = shuffled.data();
+         }
+         if (codec->compress(chunk,elements*elementBytes,chunkBuffers[c]) == false) ++failedChunks;
+      }
+      if (failedChunks > 0) {
+         cerr << "(VLSV) ERROR: Codec '" << codec->getName() << "' failed to compress array '" << tagName << "'" << endl;
+         success = false;
+      }
+      if (checkSuccess(success,comm) == false) {
+         multiwriteInitialized = false;
+         return false;
+      }
+
+      vector<uint64_t> myChunks;
+      vector<char> compressed;
+      for (int64_t c=0; c<N_chunks; ++c) {
+         myChunks.push_back(compressed.size());
+         myChunks.push_back(chunkBuffers[c].size());
+         myChunks.push_back(min(elementsPerChunk,myElements-c*elementsPerChunk));
+         compressed.insert(compressed.end(),chunkBuffers[c].begin(),chunkBuffers[c].end());
+         vector<char>().swap(chunkBuffers[c]);
+      }
+
+      // Calculate file offsets with an exclusive scan over compressed byte sizes:
+      uint64_t myCompressedBytes = compressed.size();
+      uint64_t myOffset = 0;
+      MPI_Exscan(&myCompressedBytes,&myOffset,1,MPI_Type<uint64_t>(),MPI_SUM,comm);
+      if (myrank == 0) myOffset = 0;
+      uint64_t arrayOffset = offset;
+      MPI_Bcast(&arrayOffset,1,MPI_Type<uint64_t>(),masterRank,comm);
+      for (size_t i=0; i<myChunks.size(); i+=chunktable::SIZE) {
+         myChunks[i+chunktable::OFFSET] += arrayOffset + myOffset;
+      }
+
+      if (writeCollective(arrayOffset+myOffset,compressed.data(),compressed.size()) == false) success = false;
+
+      // Gather the chunk table to master process:
+      int myValues = myChunks.size();
+      vector<int> valueCounts(N_processes);
+      vector<int> valueOffsets(N_processes);
+      MPI_Gather(&myValues,1,MPI_Type<int>(),valueCounts.data(),1,MPI_Type<int>(),masterRank,comm);
+      vector<uint64_t> table;
+      if (myrank == masterRank) {
+         valueOffsets[0] = 0;
+         for (int p=1; p<N_processes; ++p) valueOffsets[p] = valueOffsets[p-1] + valueCounts[p-1];
+         table.resize(valueOffsets[N_processes-1] + valueCounts[N_processes-1]);
+      }
+      MPI_Gatherv(myChunks.data(),myValues,MPI_Type<uint64_t>(),table.data(),valueCounts.data(),valueOffsets.data(),
+                  MPI_Type<uint64_t>(),masterRank,comm);
+
+      // Master process writes the chunk table after the compressed data and inserts the footer entry:
+      if (myrank == masterRank) {
+         uint64_t totalBytes = 0;
+         uint64_t totalElements = 0;
+         for (size_t i=0; i<table.size(); i+=chunktable::SIZE) {
+            totalBytes    += table[i+chunktable::BYTES];
+            totalElements += table[i+chunktable::ELEMENTS];
+         }
+         const uint64_t tableOffset = arrayOffset + totalBytes;
+         const uint64_t tableBytes  = table.size()*sizeof(uint64_t);
+
+         if (dryRunning == false && table.size() > 0) {
+            const double t_start = MPI_Wtime();
+            if (MPI_File_write_at(fileptr,tableOffset,table.data(),table.size(),MPI_Type<uint64_t>(),MPI_STATUS_IGNORE) != MPI_SUCCESS) success = false;
+            writeTime += (MPI_Wtime() - t_start);
+         }
+
+         muxml::XMLNode* node = addFooterEntry(tagName,attribs,arrayOffset,totalElements);
+         xmlWriter->addAttribute(node,"codec",codec->getName());
+         xmlWriter->addAttribute(node,"chunks",table.size()/chunktable::SIZE);
+         xmlWriter->addAttribute(node,"chunktable",tableOffset);
+         xmlWriter->addAttribute(node,"chunksize",elementsPerChunk);
+         if (shuffleChunks == true) xmlWriter->addAttribute(node,"filter","shuffle");
+
+         offset += totalBytes + tableBytes;
+         bytesWritten += totalBytes + tableBytes;
+      }
+
+      multiwriteInitialized = false;
+      return checkSuccess(success,comm);
+   }
+
    /** Flush multi-write units to output file. This function does the actual file I/O.
     * @param counter Number of multi-write unit we are writing.
     * @param unitOffset Output file offset relative to the starting position for this process.
     * @param start Iterator pointing to the first written multi-write unit.
     * @param stop Iterator pointing past the last written multi-write unit.
+    * @param request If not NULL, data is written with a non-blocking collective and 
+    * the MPI request is written here.
     * @return If true, this process succeeded in writing out the data.*/
    bool Writer::multiwriteFlush(const size_t& counter,const MPI_Offset& unitOffset,
-                                std::list<Multi_IO_Unit>::iterator& start,std::list<Multi_IO_Unit>::iterator& stop) {
+                                std::list<Multi_IO_Unit>::iterator& start,std::list<Multi_IO_Unit>::iterator& stop,
+                                MPI_Request* request) {
       bool success = true;
 
       // Count the total number of multiwrite units:
@@ -490,7 +1375,7 @@ namespace vlsv {
 
       // Allocate memory for an MPI_Struct that is used to 
       // write all multiwrite units with a single collective call:
-      blockLengths  = new int[N_multiwriteUnits];
+      blockLengths  = new uint64_t[N_multiwriteUnits];
       displacements = new MPI_Aint[N_multiwriteUnits];
       types         = new MPI_Datatype[N_multiwriteUnits];
 
@@ -514,23 +1399,38 @@ namespace vlsv {
          ++i;
       }
 
-      // Write data to file:
+      // Write data to file, or to the subfile of this process:
+      MPI_File file = fileptr;
+      MPI_Offset fileOffset = offset;
+      if (subfileComm != MPI_COMM_NULL) {
+         file = subfilePtr;
+         fileOffset = subfileOffset;
+      }
       if (dryRunning == false) {
          if (N_multiwriteUnits > 0) {
             // Create an MPI struct containing the multiwrite units:
             MPI_Datatype outputType;
-            MPI_Type_create_struct(N_multiwriteUnits,blockLengths,displacements,types,&outputType);
+            typeCreateStruct(N_multiwriteUnits,blockLengths,displacements,types,&outputType);
             MPI_Type_commit(&outputType);
 
-            // Write data to output file with a single collective call:
+            // Write data to output file with a single collective call. The datatype 
+            // may be freed while a non-blocking write is still using it:
             const double t_start = MPI_Wtime();
-            MPI_File_write_at_all(fileptr,offset+unitOffset,multiwriteOffsetPointer,1,outputType,MPI_STATUS_IGNORE);
+            if (request == NULL) {
+               if (MPI_File_write_at_all(file,fileOffset+unitOffset,multiwriteOffsetPointer,1,outputType,MPI_STATUS_IGNORE) != MPI_SUCCESS) success = false;
+            } else {
+               if (MPI_File_iwrite_at_all(file,fileOffset+unitOffset,multiwriteOffsetPointer,1,outputType,request) != MPI_SUCCESS) success = false;
+            }
             writeTime += (MPI_Wtime() - t_start);
             MPI_Type_free(&outputType);
          } else {
             // Process has no data to write but needs to participate in the collective call to prevent deadlock:
             const double t_start = MPI_Wtime();
-            MPI_File_write_at_all(fileptr,offset+unitOffset,NULL,0,MPI_BYTE,MPI_STATUS_IGNORE);
+            if (request == NULL) {
+               if (MPI_File_write_at_all(file,fileOffset+unitOffset,NULL,0,MPI_BYTE,MPI_STATUS_IGNORE) != MPI_SUCCESS) success = false;
+            } else {
+               if (MPI_File_iwrite_at_all(file,fileOffset+unitOffset,NULL,0,MPI_BYTE,request) != MPI_SUCCESS) success = false;
+            }
             writeTime += (MPI_Wtime() - t_start);
          }
       }
@@ -556,16 +1456,19 @@ namespace vlsv {
       uint64_t totalBytes = 0;
       for (int i=0; i<N_processes; ++i) totalBytes += bytesPerProcess[i];
 
-      muxml::XMLNode* root = xmlWriter->getRoot();
-      muxml::XMLNode* xmlnode = xmlWriter->find("VLSV",root);
-      muxml::XMLNode* node = xmlWriter->addNode(xmlnode,tagName,offset);
-      for (map<string,string>::const_iterator it=attribs.begin(); it!=attribs.end(); ++it) {
-         xmlWriter->addAttribute(node,it->first,it->second);
+      // Array written to subfiles. Footer entry records the offset and number 
+      // of array elements in each subfile, and the subfile sizes are updated:
+      if (subfileComm != MPI_COMM_NULL) {
+         vector<uint64_t> subfileElements(N_subfiles,0);
+         for (int i=0; i<N_processes; ++i) subfileElements[getSubfile(i,N_processes,N_subfiles)] += bytesPerProcess[i]/dataSize/vectorSize;
+         muxml::XMLNode* node = addFooterEntry(tagName,attribs,0,totalBytes/dataSize/vectorSize);
+         addSubfileAttributes(node,subfileEnds,subfileElements);
+         for (int i=0; i<N_subfiles; ++i) subfileEnds[i] += subfileElements[i]*dataSize*vectorSize;
+         bytesWritten += totalBytes;
+         return success;
       }
-      xmlWriter->addAttribute(node,"vectorsize",vectorSize);
-      xmlWriter->addAttribute(node,"arraysize",totalBytes/dataSize/vectorSize);
-      xmlWriter->addAttribute(node,"datatype",dataType);
-      xmlWriter->addAttribute(node,"datasize",dataSize);
+
+      addFooterEntry(tagName,attribs,offset,totalBytes/dataSize/vectorSize);
 
       // Update global file offset:
       offset += totalBytes;
@@ -574,6 +1477,221 @@ namespace vlsv {
       return success;
    }
 
+   /** Open the output file for node-local write aggregation. Processes on each shared 
+    * memory node are divided into aggregation groups according to aggregatorPlacement, 
+    * see setAggregation. The aggregator of each group writes the data of its group. 
+    * Aggregators open the output file with a separate communicator.
+    * @param mpiInfo MPI info, passed on to MPI_File_open.
+    * @return If true, aggregation was set up successfully. The return value is the same on all processes.*/
+   bool Writer::openAggregation(MPI_Info mpiInfo) {
+      bool success = true;
+      MPI_Comm nodeComm;
+      if (MPI_Comm_split_type(comm,MPI_COMM_TYPE_SHARED,myrank,MPI_INFO_NULL,&nodeComm) != MPI_SUCCESS) return false;
+      int nodeRank,nodeSize;
+      MPI_Comm_rank(nodeComm,&nodeRank);
+      MPI_Comm_size(nodeComm,&nodeSize);
+
+      // Calculate the aggregation group of this process. Processes keep their node-local 
+      // order in groupComm, so that shared window segments are in file offset order:
+      int group = 0;
+      int aggregator = 0;
+      if (aggregatorPlacement == aggregation::RANKS) {
+         for (size_t i=0; i<aggregatorList.size(); ++i) {
+            if (aggregatorList[i] < 0 || aggregatorList[i] >= N_processes) success = false;
+         }
+         int listed = 0;
+         if (find(aggregatorList.begin(),aggregatorList.end(),myrank) != aggregatorList.end()) listed = 1;
+         vector<int> nodeListed(nodeSize);
+         MPI_Allgather(&listed,1,MPI_Type<int>(),nodeListed.data(),1,MPI_Type<int>(),nodeComm);
+
+         // Each process joins the closest aggregator at or below its node-local 
+         // rank, or the first aggregator on the node if there is none below:
+         group = -1;
+         for (int r=0; r<nodeSize; ++r) {
+            if (nodeListed[r] == 0) continue;
+            if (group < 0 || r <= nodeRank) group = r;
+         }
+         if (group < 0) success = false;
+         aggregator = listed;
+         if (success == false && myrank == masterRank) {
+            cerr << "(VLSV) ERROR: Aggregator ranks given to vlsv::Writer are invalid or do not cover all shared memory nodes" << endl;
+         }
+      } else {
+         // The first process in each group is the aggregator:
+         const int64_t groups = min(aggregatorsPerNode,nodeSize);
+         if (aggregatorPlacement == aggregation::PACKED) {
+            group = nodeRank % groups;
+            if (nodeRank < groups) aggregator = 1;
+         } else {
+            group = (static_cast<int64_t>(nodeRank)*groups) / nodeSize;
+            if (nodeRank == 0 || group != (static_cast<int64_t>(nodeRank-1)*groups) / nodeSize) aggregator = 1;
+         }
+      }
+      if (checkSuccess(success,comm) == false) {
+         MPI_Comm_free(&nodeComm);
+         return false;
+      }
+      MPI_Comm_split(nodeComm,group,nodeRank,&groupComm);
+      MPI_Comm_free(&nodeComm);
+      MPI_Comm_split(comm,(aggregator == 1) ? 0 : MPI_UNDEFINED,myrank,&aggregatorComm);
+
+      // All processes know which processes are aggregators:
+      vector<int> aggregators(N_processes);
+      MPI_Allgather(&aggregator,1,MPI_Type<int>(),aggregators.data(),1,MPI_Type<int>(),comm);
+      aggregatorRanks.clear();
+      for (int p=0; p<N_processes; ++p) if (aggregators[p] == 1) aggregatorRanks.push_back(p);
+      N_aggregators = aggregatorRanks.size();
+
+      if (aggregatorComm != MPI_COMM_NULL && dryRunning == false) {
+         if (MPI_File_open(aggregatorComm,const_cast<char*>(fileName.c_str()),MPI_MODE_WRONLY,mpiInfo,&aggregatorFilePtr) != MPI_SUCCESS) {
+            MPI_Comm_free(&aggregatorComm);
+            success = false;
+         }
+      }
+      return checkSuccess(success,comm);
+   }
+
+   /** Open the subfile of this process. Processes are divided into N_subfiles groups 
+    * of consecutive ranks, each group opens its subfile with a split communicator. 
+    * Existing subfiles are deleted.
+    * @param mpiInfo MPI info, passed on to MPI_File_open.
+    * @return If true, subfiles were opened successfully. The return value is the same on all processes.*/
+   bool Writer::openSubfiles(MPI_Info mpiInfo) {
+      bool success = true;
+      const int subfile = getSubfile(myrank,N_processes,N_subfiles);
+      MPI_Comm_split(comm,subfile,myrank,&subfileComm);
+      if (myrank == masterRank) subfileEnds.assign(N_subfiles,0);
+
+      stringstream ss;
+      ss << fileName << '.' << subfile;
+      const string subfileName = ss.str();
+      if (dryRunning == false) {
+         int subfileRank;
+         MPI_Comm_rank(subfileComm,&subfileRank);
+         if (subfileRank == 0) MPI_File_delete(const_cast<char*>(subfileName.c_str()),mpiInfo);
+         MPI_Barrier(subfileComm);
+         if (MPI_File_open(subfileComm,const_cast<char*>(subfileName.c_str()),MPI_MODE_WRONLY|MPI_MODE_CREATE,mpiInfo,&subfilePtr) != MPI_SUCCESS) {
+            cerr << "(VLSV) ERROR: Failed to open subfile '" << subfileName << "'" << endl;
+            MPI_Comm_free(&subfileComm);
+            success = false;
+         } else {
+            MPI_File_set_view(subfilePtr,0,MPI_BYTE,MPI_BYTE,const_cast<char*>("native"),mpiInfo);
+         }
+      }
+      return checkSuccess(success,comm);
+   }
+
+   /** Enable node-local two-level write aggregation for arrays written in files opened 
+    * after this call. Processes on the same shared memory node copy their data to an 
+    * MPI shared memory window, and only aggregatorsPerNode processes per node write to 
+    * the output file. This reduces the number of processes taking part in collective 
+    * file I/O, which is beneficial on large process counts. Aggregation is not used 
+    * for compressed arrays or if data is written on master process only, and arrays 
+    * are always written with blocking collectives. Use getAggregatorCount, getAggregatorRanks 
+    * and isAggregator to query the aggregators. Must have the same values on all processes.
+    * @param aggregatorsPerNode Number of aggregators on each node. If zero, aggregation is disabled.
+    * @param placement Placement of the aggregators on each node. With aggregation::SPREAD 
+    * aggregators are spread evenly over node-local ranks, with aggregation::PACKED the first 
+    * node-local ranks are aggregators. Use the other overload to give the aggregators explicitly.
+    * @return If true, aggregation setting was changed successfully.*/
+   bool Writer::setAggregation(const int& aggregatorsPerNode,aggregation::placement placement) {
+      if (aggregatorsPerNode < 0) return false;
+      if (placement != aggregation::SPREAD && placement != aggregation::PACKED) return false;
+      this->aggregatorsPerNode = aggregatorsPerNode;
+      aggregatorPlacement = placement;
+      aggregatorList.clear();
+      return true;
+   }
+
+   /** Enable node-local two-level write aggregation with explicitly given aggregator 
+    * processes, see the other overload of setAggregation. Each process is assigned to 
+    * the closest aggregator on its shared memory node whose node-local rank is not 
+    * larger than its own, or to the first aggregator on the node if there is none. 
+    * Every shared memory node must have at least one aggregator, otherwise files 
+    * are written without aggregation. Must have the same value on all processes.
+    * @param aggregatorRanks Ranks of aggregator processes in the communicator given to open. 
+    * If empty, aggregation is disabled.
+    * @return If true, aggregation setting was changed successfully.*/
+   bool Writer::setAggregation(const std::vector<int>& aggregatorRanks) {
+      for (size_t i=0; i<aggregatorRanks.size(); ++i) if (aggregatorRanks[i] < 0) return false;
+      aggregatorsPerNode = 0;
+      aggregatorPlacement = aggregation::RANKS;
+      aggregatorList = aggregatorRanks;
+      return true;
+   }
+
+   /** Set the codec used to compress arrays written after this call. Arrays are split 
+    * into chunks of chunkSize elements that are compressed independently and written 
+    * to the file together with a chunk table. Chunks start at array indices that are 
+    * multiples of chunkSize, which allows readers to locate chunks directly. Codec "none" 
+    * writes arrays in chunked layout without compression. Compressed arrays are always 
+    * written with blocking collectives, and compression is not used if data is written 
+    * on master process only. Must have the same values on all processes.
+    * @param codecName Name of the codec, see vlsv::getCodec. If empty, compression is disabled.
+    * @param chunkSize Number of array elements in each compressed chunk. If zero, 
+    * chunks of approximately four megabytes are used.
+    * @return If true, the codec was found.*/
+   bool Writer::setCodec(const std::string& codecName,const uint64_t& chunkSize) {
+      this->chunkSize = chunkSize;
+      if (codecName.size() == 0) {
+         codec = NULL;
+         return true;
+      }
+      codec = getCodec(codecName);
+      if (codec == NULL) {
+         cerr << "(VLSV) ERROR: Unknown codec '" << codecName << "' in vlsv::Writer::setCodec" << endl;
+         return false;
+      }
+      return true;
+   }
+
+   /** Enable or disable writing of a binary footer index, see vlsv::encodeFooterIndex. 
+    * The index is written immediately before the XML footer in close, and it allows 
+    * vlsv::Reader to open the file without parsing the XML footer. The XML footer 
+    * is written as before, so files remain readable by tools that do not know about 
+    * the index. Only significant on master process.
+    * @param binaryFooter If true, the index is written.
+    * @return If true, the setting was changed successfully.*/
+   bool Writer::setBinaryFooter(const bool& binaryFooter) {
+      this->binaryFooter = binaryFooter;
+      return true;
+   }
+
+   /** Enable or disable deferred writes of parameters and other small arrays 
+    * written by master process. If enabled, writeParameter and writeWithReduction 
+    * do not make any collective calls to write data. Instead, the arrays are buffered 
+    * at master process and written to the output file with a single contiguous 
+    * write, together with the footer, in close. Must have the same value on all processes.
+    * @param deferWrites If true, deferred writes are enabled.
+    * @return If true, the setting was changed successfully.
+    * @see writeArrayDeferred.*/
+   bool Writer::setDeferredWrites(const bool& deferWrites) {
+      this->deferWrites = deferWrites;
+      return true;
+   }
+
+   /** Enable or disable byte shuffling of compressed arrays written after this call. 
+    * Bytes of each chunk are regrouped by significance before compression, which 
+    * usually improves compression of floating point data and cell IDs considerably. 
+    * Shuffling has no effect if compression is disabled. Must have the same value on all processes.
+    * @param shuffleChunks If true, chunks are shuffled before compression.
+    * @return If true, the setting was changed successfully.*/
+   bool Writer::setShuffle(const bool& shuffleChunks) {
+      this->shuffleChunks = shuffleChunks;
+      return true;
+   }
+
+   /** Set the maximum amount of memory used for staging copies of non-blocking writes.
+    * Must have the same value on all processes.
+    * @param maxBytes Maximum size of staging buffers in bytes. If zero, non-blocking 
+    * writes are done directly from user buffers.
+    * @return If true, staging buffer size was set successfully.
+    * @see iendMultiwrite.*/
+   bool Writer::setStagingBufferSize(const uint64_t& maxBytes) {
+      stagingLimit = maxBytes;
+      return true;
+   }
+
    /** Set if file i/o is done on master process only.
     *  @param writeUsingMasterOnly If true, only master writes data to file. Otherwise data
     *  is written using collective MPI.
@@ -583,6 +1701,79 @@ namespace vlsv {
       return this->writeUsingMasterOnly;
    }
    
+   /** Test if the given non-blocking write has completed. If it has, the 
+    * resources associated with it are released and the request ID becomes invalid. 
+    * This function is not collective.
+    * @param requestID ID of the write, as returned by iendMultiwrite or iwriteArray.
+    * @param completed Variable in which the status of the write is written.
+    * @return If false, the request ID was invalid or the write failed.*/
+   bool Writer::test(const int& requestID,bool& completed) {
+      completed = false;
+      for (list<PendingWrite>::iterator it=pendingWrites.begin(); it!=pendingWrites.end(); ++it) {
+         if (it->requestID != requestID) continue;
+         int flag = 1;
+         if (it->requests.size() > 0) {
+            if (MPI_Testall(it->requests.size(),it->requests.data(),&flag,MPI_STATUSES_IGNORE) != MPI_SUCCESS) return false;
+         }
+         if (flag == 0) return true;
+         completed = true;
+         return completeWrite(it);
+      }
+
+      // Writes that have already been completed are no longer found:
+      if (requestID < nextRequestID) completed = true;
+      return completed;
+   }
+
+   /** Wait until the given non-blocking write has completed. This function is not collective.
+    * @param requestID ID of the write, as returned by iendMultiwrite or iwriteArray.
+    * @return If true, the write completed successfully.*/
+   bool Writer::wait(const int& requestID) {
+      for (list<PendingWrite>::iterator it=pendingWrites.begin(); it!=pendingWrites.end(); ++it) {
+         if (it->requestID == requestID) return completeWrite(it);
+      }
+      return requestID < nextRequestID;
+   }
+
+   /** Wait until all non-blocking writes have completed. This function is not collective.
+    * @return If true, all writes completed successfully.*/
+   bool Writer::waitAll() {
+      bool success = true;
+      list<PendingWrite>::iterator it = pendingWrites.begin();
+      while (it != pendingWrites.end()) {
+         if (completeWrite(it) == false) success = false;
+      }
+      return success;
+   }
+
+   /** Write a contiguous buffer to output file using collective MPI calls. If the 
+    * buffer is larger than what can be written with a single collective call, 
+    * all processes make the same number of collective calls.
+    * @param fileOffset Offset into output file where this process writes its data.
+    * @param buffer Pointer to the data.
+    * @param bytes Number of bytes written by this process.
+    * @return If true, this process wrote its data successfully.*/
+   bool Writer::writeCollective(const MPI_Offset& fileOffset,const char* buffer,const uint64_t& bytes) {
+      bool success = true;
+      const uint64_t maxBytes = getMaxBytesPerWrite();
+      uint64_t myCollectiveCalls = bytes / maxBytes + 1;
+      const uint64_t N_collectiveCalls = getCollectiveCalls(myCollectiveCalls,comm);
+      if (dryRunning == true) return success;
+
+      const double t_start = MPI_Wtime();
+      for (uint64_t counter=0; counter<N_collectiveCalls; ++counter) {
+         char* pos = NULL;
+         uint64_t writeSize = 0;
+         if (counter < myCollectiveCalls) {
+            pos = const_cast<char*>(buffer) + counter*maxBytes;
+            writeSize = min(maxBytes,bytes-counter*maxBytes);
+         }
+         if (fileWriteAtAll(fileptr,fileOffset+counter*maxBytes,pos,writeSize,MPI_BYTE,MPI_STATUS_IGNORE) != MPI_SUCCESS) success = false;
+      }
+      writeTime += (MPI_Wtime() - t_start);
+      return success;
+   }
+
    /** Write an array to output file.
     * @param arrayName Name of the array. Only significant on master process.
     * @param attribs XML attributes for the array. Only significant on master process.
@@ -618,6 +1809,39 @@ namespace vlsv {
       return success;
    }
    
+   /** Buffer an array at master process. The array is written to the output 
+    * file in close, just before the footer. This function does not call any MPI 
+    * functions and it should only be called by master process. Data in the given 
+    * array is copied, and the array can be reused immediately.
+    * @param arrayName Name of the array.
+    * @param attribs XML attributes for the array.
+    * @param dataType String representation of the datatype.
+    * @param arraySize Number of array elements.
+    * @param vectorSize Size of the data vector stored in each array element.
+    * @param dataSize Byte size of vector element.
+    * @param array Pointer to data.
+    * @return If true, the array was buffered successfully.*/
+   bool Writer::writeArrayDeferred(const std::string& arrayName,const std::map<std::string,std::string>& attribs,const std::string& dataType,
+                                   const uint64_t& arraySize,const uint64_t& vectorSize,const uint64_t& dataSize,const char* array) {
+      if (fileOpen == false) return false;
+      if (myrank != masterRank) {
+         cerr << "(VLSV) ERROR: vlsv::Writer::writeArrayDeferred called on a process other than master" << endl;
+         return false;
+      }
+
+      DeferredArray deferred;
+      deferred.tagName      = arrayName;
+      deferred.attribs      = attribs;
+      deferred.dataType     = dataType;
+      deferred.arraySize    = arraySize;
+      deferred.vectorSize   = vectorSize;
+      deferred.dataSize     = dataSize;
+      deferred.bufferOffset = deferredData.size();
+      deferredArrays.push_back(deferred);
+      deferredData.insert(deferredData.end(),array,array+arraySize*vectorSize*dataSize);
+      return true;
+   }
+
    /** Write an array to file so that file I/O is done on master only. Before writing to file all data is gathered to master.
     * @param arrayName Name of the array. Only significant on master process.
     * @param attribs XML attributes for the array. Only significant on master process.
@@ -672,10 +1896,12 @@ namespace vlsv {
          const double t_start = MPI_Wtime();
          MPI_File_write_at(fileptr, offset, buffer.data(), totalBytes, MPI_Type<char>(), &status);
          writeTime += (MPI_Wtime() - t_start);
-      }
 
-      // Add footer entry
-      if (multiwriteFooter(arrayName, attribs) == false) success = false;
+         // Add footer entry. Array is always in the main file, also when subfiles are in use:
+         addFooterEntry(arrayName,attribs,offset,totalBytes/dataSize/vectorSize);
+         offset += totalBytes;
+         bytesWritten += totalBytes;
+      }
 
       return checkSuccess(success,comm);
    }
@@ -26,6 +26,7 @@
 
 #include "muxml.h"
 #include "mpiconversion.h"
+#include "vlsv_codec.h"
 #include "vlsv_common.h"
 #include "multi_io_unit.h"
 
@@ -52,38 +53,86 @@
 
 namespace vlsv {
 
+   /** Placement of write aggregator processes on shared memory nodes, see Writer::setAggregation.
+    * @brief Aggregator placement.*/
+   namespace aggregation {
+      enum placement {
+         SPREAD,                                             /**< @brief Node-local processes are divided into groups of consecutive 
+                                                              * ranks, the first process in each group is the aggregator.*/
+         PACKED,                                             /**< @brief Node-local ranks 0,1,...,aggregatorsPerNode-1 are the aggregators, 
+                                                              * other processes are assigned to them round-robin.*/
+         RANKS                                               /**< @brief Aggregators are given as a list of ranks.*/
+      };
+   }
+
    class Writer {
     public:
       Writer();
       ~Writer();
 
+      bool addArray(const std::string& arrayName,const std::map<std::string,std::string>& attribs,const std::string& dataType,
+                    const uint64_t& arraySize,const uint64_t& vectorSize,const uint64_t& dataSize,const char* array);
       bool addMultiwriteUnit(char* array,const uint64_t& arrayElements);
+      bool beginBatch();
       bool close();
+      bool commitBatch();
       uint64_t getBytesWritten() const;
       double getWriteTime() const;
       void endDryRunning();
       bool endMultiwrite(const std::string& tagName,const std::map<std::string,std::string>& attribs);
-      bool open(const std::string& fname,MPI_Comm comm,const int& masterProcessID,MPI_Info mpiInfo=MPI_INFO_NULL,bool append=false);
+      int getAggregatorCount() const;
+      const std::vector<int>& getAggregatorRanks() const;
+      uint64_t getStagingBufferSize() const;
+      bool iendMultiwrite(const std::string& tagName,const std::map<std::string,std::string>& attribs,int& requestID);
+      bool isAggregator() const;
+      bool iwriteArray(const std::string& arrayName,const std::map<std::string,std::string>& attribs,const std::string& dataType,
+                       const uint64_t& arraySize,const uint64_t& vectorSize,const uint64_t& dataSize,const char* array,int& requestID);
+      bool open(const std::string& fname,MPI_Comm comm,const int& masterProcessID,MPI_Info mpiInfo=MPI_INFO_NULL,bool append=false,
+                int subfiles=1);
+      bool setAggregation(const int& aggregatorsPerNode,aggregation::placement placement=aggregation::SPREAD);
+      bool setAggregation(const std::vector<int>& aggregatorRanks);
+      bool setBinaryFooter(const bool& binaryFooter);
+      bool setCodec(const std::string& codecName,const uint64_t& chunkSize=0);
+      bool setDeferredWrites(const bool& deferWrites);
+      bool setShuffle(const bool& shuffleChunks);
       bool setSize(MPI_Offset newSize);
+      bool setStagingBufferSize(const uint64_t& maxBytes);
       bool setWriteOnMasterOnly(const bool& writeUsingMasterOnly);
       void startDryRun();
       bool startMultiwrite(const std::string& datatype,const uint64_t& arraySize,const uint64_t& vectorSize,const uint64_t& dataSize);      
+      bool test(const int& requestID,bool& completed);
+      bool wait(const int& requestID);
+      bool waitAll();
       bool writeArray(const std::string& arrayName,const std::map<std::string,std::string>& attribs,const std::string& dataType,
                       const uint64_t& arraySize,const uint64_t& vectorSize,const uint64_t& dataSize,const char* array);
+      bool writeArrayDeferred(const std::string& arrayName,const std::map<std::string,std::string>& attribs,const std::string& dataType,
+                              const uint64_t& arraySize,const uint64_t& vectorSize,const uint64_t& dataSize,const char* array);
       bool writeArrayMaster(const std::string& arrayName,const std::map<std::string,std::string>& attribs,const std::string& dataType,
                             const uint64_t& arraySize,const uint64_t& vectorSize,const uint64_t& dataSize,const char* array);
    
       // ***** TEMPLATE WRAPPER FUNCTIONS ***** //
 
+      template<typename T>
+      bool addArray(const std::string& arrayName,const std::map<std::string,std::string>& attribs,
+                    const uint64_t& arraySize,const uint64_t& vectorSize,const T* array);
+
       template<typename T> 
       bool addMultiwriteUnit(const T* array,const uint64_t& arrayElements);
       
       template<typename T>
       bool startMultiwrite(const uint64_t& arraySize,const uint64_t& vectorSize);
       
+      template<typename T>
+      bool iwriteArray(const std::string& arrayName,const std::map<std::string,std::string>& attribs,
+                       const uint64_t& arraySize,const uint64_t& vectorSize,const T* array,int& requestID);
+
       template<typename T> 
       bool writeArray(const std::string& arrayName,const std::map<std::string,std::string>& attribs,
 		      const uint64_t& arraySize,const uint64_t& vectorSize,const T* array);
+
+      template<typename T>
+      bool writeArrayDeferred(const std::string& arrayName,const std::map<std::string,std::string>& attribs,
+                              const uint64_t& arraySize,const uint64_t& vectorSize,const T* array);
       
       template<typename T>
       bool writeParameter(const std::string& parameterName,const T* const array);
@@ -94,16 +143,72 @@ namespace vlsv {
    
     private:
 
+      /** An array that has been added to a batch with addArray, but not yet written.*/
+      struct BatchArray {
+         std::string tagName;                          /**< Name of the XML tag.*/
+         std::map<std::string,std::string> attribs;    /**< Attributes of the XML tag.*/
+         std::string dataType;                         /**< String representation of the datatype.*/
+         uint64_t arraySize;                           /**< Number of array elements written by this process.*/
+         uint64_t vectorSize;                          /**< Size of the data vector in each array element.*/
+         uint64_t dataSize;                            /**< Byte size of vector element.*/
+         const char* array;                            /**< Pointer to data.*/
+      };
+
+      /** A master-only array that has been buffered with writeArrayDeferred, 
+       * but not yet written to the output file.*/
+      struct DeferredArray {
+         std::string tagName;                          /**< Name of the XML tag.*/
+         std::map<std::string,std::string> attribs;    /**< Attributes of the XML tag.*/
+         std::string dataType;                         /**< String representation of the datatype.*/
+         uint64_t arraySize;                           /**< Number of array elements.*/
+         uint64_t vectorSize;                          /**< Size of the data vector in each array element.*/
+         uint64_t dataSize;                            /**< Byte size of vector element.*/
+         uint64_t bufferOffset;                        /**< Offset of array data in deferredData.*/
+      };
+
+      /** Book-keeping of a non-blocking array write that has been started with 
+       * iendMultiwrite but not yet completed. A single array write may consist 
+       * of several MPI requests if the data had to be split into multiple collectives.*/
+      struct PendingWrite {
+         int requestID;                       /**< Request ID returned to the caller.*/
+         std::vector<MPI_Request> requests;   /**< MPI requests of the collective writes.*/
+         std::vector<char> staging;           /**< Staging copy of the written data, may be empty.*/
+      };
+
+      char* aggregationSegment;               /**< This process' segment of aggregationWindow.*/
+      MPI_Win aggregationWindow;              /**< Shared memory window of the aggregation group, reused for all 
+                                               * aggregated arrays. MPI_WIN_NULL if not allocated.*/
+      uint64_t aggregationWindowBytes;        /**< Byte size of this process' segment of aggregationWindow.*/
+      MPI_Comm aggregatorComm;                /**< Communicator containing aggregator processes, MPI_COMM_NULL 
+                                               * on other processes or if aggregation is disabled.*/
+      MPI_File aggregatorFilePtr;             /**< MPI file pointer to the output file opened with aggregatorComm.*/
+      std::vector<int> aggregatorList;        /**< Ranks of aggregator processes given to setAggregation, used with 
+                                               * placement aggregation::RANKS.*/
+      aggregation::placement aggregatorPlacement; /**< Placement of aggregator processes on shared memory nodes.*/
+      std::vector<int> aggregatorRanks;       /**< Ranks of aggregator processes in communicator comm, 
+                                               * empty if aggregation is not in use.*/
+      int aggregatorsPerNode;                 /**< Number of aggregator processes per shared memory node, 
+                                               * if zero aggregation is disabled.*/
       uint64_t arraySize;                     /**< Number of array elements this process will write.*/
-      int* blockLengths;                      /**< Used in creation of an MPI_Struct in endMultiwrite.*/
+      std::vector<BatchArray> batchArrays;    /**< Arrays added to the current batch.*/
+      bool batchStarted;                      /**< If true, beginBatch has been called and arrays can be added to the batch.*/
+      bool binaryFooter;                      /**< If true, a binary footer index is written before the XML footer.*/
+      uint64_t* blockLengths;                 /**< Used in creation of an MPI_Struct in endMultiwrite.*/
       uint64_t* bytesPerProcess;              /**< Array with N_processes elements. Used to gather myBytes.*/
       uint64_t bytesWritten;                  /**< Total amount of bytes written to output file,
                                                * significant at master process only.*/
+      uint64_t chunkSize;                     /**< Number of array elements in each compressed chunk, 
+                                               * if zero a default value is used.*/
+      const Codec* codec;                     /**< Codec used to compress arrays, if NULL arrays are not compressed.*/
       MPI_Comm comm;                          /**< MPI communicator used in I/O.*/
       uint64_t dataSize;                      /**< Byte size of each element in data vector, must have
                                                * the same value on all participating processes.*/
       std::string dataType;                   /**< String description of the datatype that is written to file,
                                                * obtained by calling arrayDataType() template function.*/
+      std::vector<DeferredArray> deferredArrays; /**< Deferred arrays, significant at master process only.*/
+      std::vector<char> deferredData;         /**< Data of deferred arrays, significant at master process only.*/
+      bool deferWrites;                       /**< If true, parameters and reduced arrays are buffered at master 
+                                               * process and written to the output file in close.*/
       MPI_Aint* displacements;                /**< Used in creation of an MPI_Struct in endMultiwrite.*/
       bool dryRunning;                        /**< If true, then dry run mode is enabled and all file I/O is skipped.*/
       unsigned int endMultiwriteCounter;      /**< A counter used in endMultiwrite to synchronize threads.*/
@@ -111,6 +216,9 @@ namespace vlsv {
       bool fileOpen;                          /**< If true, a file has been successfully opened for writing.*/
       MPI_File fileptr;                       /**< MPI file pointer to the output file.*/
       bool initialized;                       /**< If true, VLSV Writer initialization is complete, does not tell if it was successful.*/
+      MPI_Comm groupComm;                     /**< Communicator containing the processes whose data is written by 
+                                               * the same aggregator, in node-local rank order. MPI_COMM_NULL 
+                                               * if aggregation is disabled.*/
       int masterRank;                         /**< Rank of master process in communicator comm.*/
       bool multiwriteFinalized;               /**< If true, multiwrite array writing mode has finalized correctly. 
                                                * This variable is used to synchronize threads in endMultiwrite function..*/
@@ -130,9 +238,22 @@ namespace vlsv {
       int myrank;                             /**< Rank of this process in communicator comm.*/
       unsigned int N_multiwriteUnits;         /**< Total number of multiwrite units this process has. In multithreaded mode 
                                                * this is equal to the sum of multiwrite units over all threads.*/
+      int N_aggregators;                      /**< Total number of aggregator processes in communicator comm.*/
       int N_processes;                        /**< Number of processes in communicator comm.*/
+      int N_subfiles;                         /**< Number of subfiles array data is written to, one if subfiling is disabled.*/
+      int nextRequestID;                      /**< Request ID given to the next non-blocking write.*/
       MPI_Offset offset;                      /**< MPI offset into output file for this process.*/
       MPI_Offset* offsets;                    /**< Array with N_processes elements. Used to scatter file offsets.*/
+      std::list<PendingWrite> pendingWrites;  /**< Non-blocking writes that have not completed yet, oldest first.*/
+      bool shuffleChunks;                     /**< If true, bytes of compressed chunks are shuffled by significance before compression.*/
+      std::vector<uint64_t> subfileEnds;      /**< Current size of each subfile in bytes, significant at master process only.*/
+      MPI_Comm subfileComm;                   /**< Communicator containing the processes writing to the same subfile, 
+                                               * MPI_COMM_NULL if subfiling is disabled.*/
+      MPI_Offset subfileOffset;               /**< Offset into subfile for this process in the current array.*/
+      MPI_File subfilePtr;                    /**< MPI file pointer to the subfile of this process.*/
+      uint64_t stagingBytes;                  /**< Number of bytes currently held in staging buffers of pending writes.*/
+      uint64_t stagingLimit;                  /**< Maximum number of bytes held in staging buffers. If zero, non-blocking 
+                                               * writes are done directly from user buffers.*/
       MPI_Datatype* types;                    /**< Used in creation of an MPI_Struct in endMultiwrite.*/
       uint64_t vectorSize;                    /**< Number of elements in each data vector per array element,
                                                * must have the same value on all participating processes.*/
@@ -141,8 +262,24 @@ namespace vlsv {
                                                * The timer on master process includes the time to write the header and footer.*/
       muxml::MuXML* xmlWriter;                /**< Pointer to XML writer, used for writing a footer to the VLSV file.*/
 
-      bool multiwriteFlush(const size_t& counter,const MPI_Offset& currentOffset,std::list<Multi_IO_Unit>::iterator& start,std::list<Multi_IO_Unit>::iterator& end);
+      muxml::XMLNode* addFooterEntry(const std::string& tagName,const std::map<std::string,std::string>& attribs,
+                                     const uint64_t& arrayOffset,const uint64_t& arraySize);
+      void addSubfileAttributes(muxml::XMLNode* node,const std::vector<uint64_t>& subfileOffsets,
+                                const std::vector<uint64_t>& subfileElements);
+      bool alignChunks(const char*& data,std::vector<char>& aligned,uint64_t& myElements,
+                       const uint64_t& elementBytes,const uint64_t& elementsPerChunk);
+      void closeAggregation();
+      void closeSubfiles();
+      bool completeWrite(std::list<PendingWrite>::iterator& it);
+      bool multiwriteAggregated();
+      bool multiwriteCompressed(const std::string& tagName,const std::map<std::string,std::string>& attribs);
+      bool multiwriteFlush(const size_t& counter,const MPI_Offset& currentOffset,std::list<Multi_IO_Unit>::iterator& start,
+                           std::list<Multi_IO_Unit>::iterator& end,MPI_Request* request=NULL);
       bool multiwriteFooter(const std::string& tagName,const std::map<std::string,std::string>& attribs);
+      bool multiwriteWrite(const std::string& tagName,const std::map<std::string,std::string>& attribs,std::vector<MPI_Request>* requests);
+      bool openAggregation(MPI_Info mpiInfo);
+      bool openSubfiles(MPI_Info mpiInfo);
+      bool writeCollective(const MPI_Offset& fileOffset,const char* buffer,const uint64_t& bytes);
    };
 
    template<typename T> inline
@@ -159,6 +296,19 @@ namespace vlsv {
       return true;
    }
 
+   /** Add an array to the current batch, see vlsv::Writer::addArray.
+    * @param tagName Name of the array, same as the XML tag name in output file. Only significant at master process.
+    * @param attribs Other attributes for the output XML tag. Only significant at master process.
+    * @param arraySize Number of elements in array on this process.
+    * @param vectorSize Number of elements in vectors that comprise the array elements. Must have the same value on all processes.
+    * @param array Pointer to the output array. Must remain valid until commitBatch returns.
+    * @return If true, the array was added to the batch.*/
+   template<typename T> inline
+   bool Writer::addArray(const std::string& tagName,const std::map<std::string,std::string>& attribs,
+                         const uint64_t& arraySize,const uint64_t& vectorSize,const T* array) {
+      return addArray(tagName,attribs,getStringDatatype<T>(),arraySize,vectorSize,sizeof(T),reinterpret_cast<const char*>(array));
+   }
+
    /** Start an array writing process.
     * @param arraySize  Number of elements this MPI process will write to the output array. 
     * @param vectorSize Number of elements in each data vector, this value must have the 
@@ -186,7 +336,39 @@ namespace vlsv {
       return writeArray(tagName,attribs,getStringDatatype<T>(),arraySize,vectorSize,sizeof(T),reinterpret_cast<char*>(arrayPtr));
    }
 
-   /** Write the value of a parameter to output file.
+   /** Start a non-blocking write of an array. This function is a wrapper to 
+    * vlsv::Writer::iwriteArray, see its documentation for details.
+    * @param tagName Name of the array, same as the XML tag name in output file. Only significant at master process.
+    * @param attribs Other attributes for the output XML tag, given in [tag name,tag value] pairs. Only significant at master process.
+    * @param arraySize Number of elements in array on this process.
+    * @param vectorSize Number of elements in vectors that comprise the array elements. Only significant at master process.
+    * @param array Pointer to the output array.
+    * @param requestID Variable in which the ID of the started write is written.
+    * @return If true, the write was started successfully.*/
+   template<typename T> inline
+   bool Writer::iwriteArray(const std::string& tagName,const std::map<std::string,std::string>& attribs,
+                            const uint64_t& arraySize,const uint64_t& vectorSize,const T* array,int& requestID) {
+      T* arrayPtr = const_cast<T*>(array);
+      return iwriteArray(tagName,attribs,getStringDatatype<T>(),arraySize,vectorSize,sizeof(T),reinterpret_cast<char*>(arrayPtr),requestID);
+   }
+
+   /** Buffer an array at master process, it is written to the output file in close. 
+    * This function is a wrapper to vlsv::Writer::writeArrayDeferred, see its documentation for details.
+    * @param tagName Name of the array, same as the XML tag name in output file.
+    * @param attribs Other attributes for the output XML tag, given in [tag name,tag value] pairs.
+    * @param arraySize Number of elements in array.
+    * @param vectorSize Number of elements in vectors that comprise the array elements.
+    * @param array Pointer to the output array.
+    * @return If true, the array was buffered successfully.*/
+   template<typename T> inline
+   bool Writer::writeArrayDeferred(const std::string& tagName,const std::map<std::string,std::string>& attribs,
+                                   const uint64_t& arraySize,const uint64_t& vectorSize,const T* array) {
+      return writeArrayDeferred(tagName,attribs,getStringDatatype<T>(),arraySize,vectorSize,sizeof(T),reinterpret_cast<const char*>(array));
+   }
+
+   /** Write the value of a parameter to output file. If deferred writes have 
+    * been enabled with setDeferredWrites, the value is buffered at master process 
+    * and no MPI calls are made.
     * @param parameterName Name of the parameter. Only significant at master process.
     * @param array Pointer to array containing the parameter value. Only significant at master process.
     * @return If true, parameter was written successfully.*/
@@ -194,6 +376,11 @@ namespace vlsv {
    bool Writer::writeParameter(const std::string& parameterName,const T* const array) {
       std::map<std::string,std::string> attributes;
       attributes["name"] = parameterName;
+
+      if (deferWrites == true) {
+         if (myrank != masterRank) return true;
+         return writeArrayDeferred("PARAMETER",attributes,1,1,array);
+      }
    
       if (myrank == masterRank)
         return writeArray("PARAMETER",attributes,1,1,array);
@@ -215,7 +402,9 @@ namespace vlsv {
 
       // Write result to file. Only master process has a non-zero array length, 
       // all other processes write a zero-length array:
-      if (myrank == masterRank) {
+      if (deferWrites == true) {
+         if (myrank == masterRank) writeArrayDeferred(arrayName,attribs,1,arraySize,recvBuffer);
+      } else if (myrank == masterRank) {
          writeArray(arrayName,attribs,1,arraySize,recvBuffer);
       } else {
          writeArray(arrayName,attribs,0,0,recvBuffer);